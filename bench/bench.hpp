@@ -0,0 +1,37 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+
+namespace FtBench {
+
+using Clock = std::chrono::steady_clock;
+
+// loopback ports used by the benchmarks, away from the demo ones
+static constexpr unsigned short int BENCH_PORT{10400};
+
+inline double SecondsSince(Clock::time_point start)
+{
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+inline double MicrosecondsSince(Clock::time_point start)
+{
+  return std::chrono::duration<double, std::micro>(Clock::now() - start)
+    .count();
+}
+
+int RunTls(int argc, char* argv[]);
+int RunPool(int argc, char* argv[]);
+int RunLatency(int argc, char* argv[]);
+int RunSessions(int argc, char* argv[]);
+int RunFraming(int argc, char* argv[]);
+int RunCompression(int argc, char* argv[]);
+int RunWriter(int argc, char* argv[]);
+int RunLocal(int argc, char* argv[]);
+int RunTransport(int argc, char* argv[]);
+int RunBuffers(int argc, char* argv[]);
+int RunBatch(int argc, char* argv[]);
+int RunAccess(int argc, char* argv[]);
+
+} // namespace FtBench
@@ -0,0 +1,150 @@
+#include "bench.hpp"
+
+#include "ft-socket/ft_socket_server.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <random>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace FtTCP;
+
+namespace FtBench {
+
+static constexpr size_t LOOKUPS{1000000};
+static constexpr size_t CHECKED_LOOKUPS{20000};
+static constexpr unsigned short int MAX_PER_ADDRESS{4};
+static constexpr size_t FLOOD_CONNECTIONS{16};
+
+struct Rule {
+  Cidr cidr;
+  bool allow;
+};
+
+// what CidrTable answers, by looking at every rule
+static bool LinearIsAllowed(const std::vector<Rule>& rules, uint32_t ip)
+{
+  int longest = -1;
+  bool allowed = true;
+  for (const Rule& rule : rules) {
+    uint32_t mask = rule.cidr.length ? ~uint32_t(0) << (32 - rule.cidr.length)
+                                     : 0;
+    if ((ip & mask) != rule.cidr.prefix || rule.cidr.length < longest)
+      continue;
+    allowed = (rule.cidr.length == longest) ? allowed || rule.allow
+                                             : rule.allow;
+    longest = rule.cidr.length;
+  }
+  return allowed;
+}
+
+// rules of 8 to 32 bits, addresses mostly inside the ruled ranges
+static void Lookups(size_t ruleCount)
+{
+  std::mt19937 random(static_cast<uint32_t>(ruleCount));
+  std::vector<Rule> rules;
+  CidrTable table;
+  for (size_t i = 0; i < ruleCount; i++) {
+    uint8_t length = static_cast<uint8_t>(8 + random() % 25);
+    uint32_t mask = ~uint32_t(0) << (32 - length);
+    // a few /8 blocks, so the prefixes nest
+    uint32_t prefix = ((10 + random() % 4) << 24 | (random() & 0xffffff)) &
+                      mask;
+    Rule rule{Cidr{prefix, length}, 0 == random() % 3};
+    rules.push_back(rule);
+    table.Add(rule.cidr, rule.allow);
+  }
+  table.Build();
+  std::vector<uint32_t> addresses(LOOKUPS);
+  for (auto& address : addresses)
+    address = (10 + random() % 4) << 24 | (random() & 0xffffff);
+
+  size_t mismatches = 0;
+  for (size_t i = 0; i < CHECKED_LOOKUPS; i++) {
+    if (table.IsAllowed(addresses[i]) !=
+        LinearIsAllowed(rules, addresses[i]))
+      mismatches++;
+  }
+  size_t allowed = 0;
+  auto start = Clock::now();
+  for (uint32_t address : addresses)
+    allowed += table.IsAllowed(address);
+  double tableNs = MicrosecondsSince(start) * 1000 / addresses.size();
+  // the scan is slow, a sample is enough
+  size_t scanned = std::min(addresses.size(), 1000000 / ruleCount + 100);
+  start = Clock::now();
+  for (size_t i = 0; i < scanned; i++)
+    allowed += LinearIsAllowed(rules, addresses[i]);
+  double linearNs = MicrosecondsSince(start) * 1000 / scanned;
+  printf("%7zu rules: %7.1f ns per lookup, linear scan %10.1f ns, "
+         "%zu mismatches in %zu%s\n",
+         ruleCount, tableNs, linearNs, mismatches, CHECKED_LOOKUPS,
+         allowed ? "" : " ");
+}
+
+// connections from a loopback source address, counted once accepted
+static std::vector<int> ConnectFrom(const char* source, size_t count)
+{
+  std::vector<int> sockets;
+  for (size_t i = 0; i < count; i++) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in local{};
+    local.sin_family = AF_INET;
+    inet_pton(AF_INET, source, &local.sin_addr);
+    sockaddr_in server{};
+    server.sin_family = AF_INET;
+    server.sin_port = htons(BENCH_PORT);
+    inet_pton(AF_INET, "127.0.0.1", &server.sin_addr);
+    if (0 != bind(fd, reinterpret_cast<sockaddr*>(&local), sizeof(local)) ||
+        0 != connect(fd, reinterpret_cast<sockaddr*>(&server),
+                     sizeof(server))) {
+      close(fd);
+      continue;
+    }
+    sockets.push_back(fd);
+  }
+  return sockets;
+}
+
+static void Caps()
+{
+  ServerParameters parameters{BENCH_PORT, 64, std::chrono::seconds(60)};
+  parameters.protocol = ProtocolVarintFrames;
+  parameters.access.maxPerAddress = MAX_PER_ADDRESS;
+  parameters.access.deny = {"127.0.0.3/32"};
+  auto server = std::make_shared<Server>(parameters);
+  server->Start();
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  std::vector<int> flood = ConnectFrom("127.0.0.2", FLOOD_CONNECTIONS);
+  std::vector<int> other = ConnectFrom("127.0.0.1", 1);
+  std::vector<int> denied = ConnectFrom("127.0.0.3", 1);
+  // the refused ones wait for the listener's throttle in between
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  ServerStats stats = server->GetStats();
+  printf("%zu connections from one address, %u allowed per address: "
+         "%zu connected, %llu refused; a denied address: %llu refused\n",
+         flood.size(), MAX_PER_ADDRESS, stats.clients,
+         static_cast<unsigned long long>(stats.addressLimited),
+         static_cast<unsigned long long>(stats.accessDenied));
+  for (int fd : flood)
+    close(fd);
+  for (int fd : other)
+    close(fd);
+  for (int fd : denied)
+    close(fd);
+  server->Stop();
+}
+
+int RunAccess(int argc, char* argv[])
+{
+  for (size_t rules : {size_t(1000), size_t(10000), size_t(100000)})
+    Lookups(rules);
+  Caps();
+  return 0;
+}
+
+} // namespace FtBench
@@ -0,0 +1,143 @@
+#include "bench.hpp"
+
+#include "ft-socket/ft_socket_server.hpp"
+
+#include <atomic>
+#include <climits>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace FtTCP;
+
+namespace FtBench {
+
+static constexpr size_t CLIENTS{16};
+static constexpr size_t COMMANDS_PER_CLIENT{20000};
+static constexpr size_t COMMAND_SIZE{64};
+static constexpr std::chrono::milliseconds REPLY_TIMEOUT{10000};
+
+// appends every command to a file, the way a command log would
+struct Store {
+  int fd{-1};
+  std::atomic<size_t> commands{0};
+  std::atomic<size_t> writes{0};
+
+  void OnReceive(Server&, ClientHandle, const void* data, size_t size)
+  {
+    if (write(fd, data, size) > 0)
+      writes++;
+    commands++;
+  }
+  void OnBatch(Server&, ReceiveBatch batch)
+  {
+    std::vector<iovec> vectors;
+    vectors.reserve(batch.size());
+    for (const ReceiveRecord& record : batch) {
+      vectors.push_back(iovec{const_cast<char*>(record.data.data()),
+                              record.data.size()});
+    }
+    for (size_t offset = 0; offset < vectors.size(); offset += IOV_MAX) {
+      int count = static_cast<int>(
+        std::min<size_t>(IOV_MAX, vectors.size() - offset));
+      if (writev(fd, vectors.data() + offset, count) > 0)
+        writes++;
+    }
+    commands += batch.size();
+  }
+};
+
+static SocketPtr Connect()
+{
+  auto start = Clock::now();
+  while (SecondsSince(start) < 1.0) {
+    SocketPtr client = Socket::CreateSocket(
+      Address::CreateClientAddress("127.0.0.1", BENCH_PORT));
+    if (client->Connect() && client->IsReadyForWrite(REPLY_TIMEOUT) &&
+        client->FinishConnect())
+      return client;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return nullptr;
+}
+
+// commands/s until the store has them all, and commands per write
+static void Persist(const char* name, bool batch)
+{
+  char path[] = "/tmp/ft-bench-batch-XXXXXX";
+  Store store;
+  store.fd = mkstemp(path);
+  if (store.fd < 0) {
+    printf("%-22s no temporary file\n", name);
+    return;
+  }
+  unlink(path);
+
+  ServerParameters parameters{BENCH_PORT, CLIENTS + 4,
+                              std::chrono::seconds(60)};
+  parameters.protocol = ProtocolVarintFrames;
+  parameters.batch.enabled = batch;
+  auto server = std::make_shared<Server>(parameters);
+  if (batch)
+    server->SetOnReceiveBatchCallback(&store, &Store::OnBatch);
+  else
+    server->SetOnReceiveDataCallback(&store, &Store::OnReceive);
+  server->Start();
+
+  // each client sends its commands one frame at a time, as typed
+  std::byte header[FrameReader::MAX_HEADER];
+  size_t headerSize = FrameReader::EncodeHeader(FrameVarint, COMMAND_SIZE,
+                                                header);
+  std::vector<std::byte> command(header, header + headerSize);
+  command.resize(headerSize + COMMAND_SIZE, std::byte('c'));
+  std::vector<SocketPtr> clients;
+  for (size_t i = 0; i < CLIENTS; i++) {
+    if (SocketPtr client = Connect())
+      clients.push_back(client);
+  }
+  auto start = Clock::now();
+  std::vector<std::thread> senders;
+  for (auto& client : clients) {
+    senders.emplace_back([client, &command]() {
+      for (size_t i = 0; i < COMMANDS_PER_CLIENT; i++) {
+        size_t sent = 0;
+        if (!client->IsReadyForWrite(REPLY_TIMEOUT) ||
+            !client->Send(command.data(), command.size(), MSG_NOSIGNAL,
+                          &sent))
+          return;
+      }
+    });
+  }
+  for (auto& sender : senders)
+    sender.join();
+  size_t expected = clients.size() * COMMANDS_PER_CLIENT;
+  while (store.commands.load() < expected &&
+         SecondsSince(start) < REPLY_TIMEOUT.count() / 1000.0)
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  double seconds = SecondsSince(start);
+  clients.clear();
+  server->Stop();
+  close(store.fd);
+  if (store.commands.load() != expected || 0 == store.writes.load()) {
+    printf("%-22s failed\n", name);
+    return;
+  }
+  printf("%-22s %9.0f commands/s  %7.1f commands per write\n", name,
+         expected / seconds,
+         static_cast<double>(expected) / store.writes.load());
+}
+
+int RunBatch(int argc, char* argv[])
+{
+  printf("%zu clients x %zu commands of %zu B, appended to a file\n",
+         CLIENTS, COMMANDS_PER_CLIENT, COMMAND_SIZE);
+  Persist("per receive callback", false);
+  Persist("batch callback", true);
+  return 0;
+}
+
+} // namespace FtBench
@@ -0,0 +1,245 @@
+#include "bench.hpp"
+
+#include "ft-socket/ft_socket_server.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <vector>
+
+using namespace FtTCP;
+
+namespace FtBench {
+
+static constexpr size_t BULK_BYTES{64 * 1024 * 1024};
+static constexpr size_t SEND_CHUNK{64 * 1024};
+static constexpr size_t REPLY_WRITE{16 * 1024};
+static constexpr size_t IDLE_CLIENTS{100};
+static constexpr std::chrono::milliseconds SHRINK_AFTER{200};
+static constexpr std::chrono::milliseconds REPLY_TIMEOUT{10000};
+
+static constexpr char READY[] = "ready\n";
+static constexpr char START_REPLY[] = "go\n";
+
+struct BulkHandler {
+  std::atomic<size_t> received{0};
+  std::atomic<size_t> callbacks{0};
+
+  // tells the client its password went through
+  void OnConnect(Server& server, ClientHandle client)
+  {
+    server.SendToClient(client, READY);
+  }
+  bool OnPassword(Server&, ClientHandle, const void*, size_t) { return true; }
+  void OnReceive(Server& server, ClientHandle client, const void* data,
+                 size_t size)
+  {
+    received.fetch_add(size, std::memory_order_relaxed);
+    callbacks.fetch_add(1, std::memory_order_relaxed);
+    if (size != sizeof(START_REPLY) - 1 ||
+        0 != std::memcmp(data, START_REPLY, size))
+      return;
+    std::string write(REPLY_WRITE, 'x');
+    for (size_t sent = 0; sent < BULK_BYTES; sent += write.size())
+      server.SendToClient(client, write);
+  }
+};
+
+// the 256 B receive buffer and send chunks of telnet clients, 64 KB reads
+// for framed ones
+static BufferSizing FixedSizing(Protocol protocol)
+{
+  BufferSizing sizing;
+  size_t receive = (ProtocolTelnet == protocol) ? 256 : 64 * 1024;
+  sizing.minReceive = sizing.maxReceive = receive;
+  sizing.minSendChunk = sizing.maxSendChunk = 256;
+  return sizing;
+}
+
+static std::shared_ptr<Server> StartServer(Protocol protocol,
+                                           const BufferSizing& sizing,
+                                           BulkHandler& handler)
+{
+  ServerParameters parameters{BENCH_PORT, IDLE_CLIENTS + 10,
+                              std::chrono::seconds(60)};
+  parameters.protocol = protocol;
+  parameters.buffers = sizing;
+  parameters.lowLatency = true;
+  auto server = std::make_shared<Server>(parameters);
+  server->SetOnPasswordEntered(&handler, &BulkHandler::OnPassword);
+  server->SetOnClientConnectCallback(&handler, &BulkHandler::OnConnect);
+  server->SetOnReceiveDataCallback(&handler, &BulkHandler::OnReceive);
+  server->Start();
+  return server;
+}
+
+static SocketPtr Connect()
+{
+  auto start = Clock::now();
+  while (SecondsSince(start) < 1.0) {
+    SocketPtr client = Socket::CreateSocket(
+      Address::CreateClientAddress("127.0.0.1", BENCH_PORT));
+    if (client->Connect() && client->IsReadyForWrite(REPLY_TIMEOUT) &&
+        client->FinishConnect())
+      return client;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return nullptr;
+}
+
+static bool SendAll(SocketPtr client, const char* data, size_t size)
+{
+  for (size_t offset = 0; offset < size;) {
+    size_t sent = 0;
+    if (!client->IsReadyForWrite(REPLY_TIMEOUT) ||
+        !client->Send(const_cast<char*>(data + offset),
+                      std::min(SEND_CHUNK, size - offset), MSG_NOSIGNAL,
+                      &sent))
+      return false;
+    offset += sent;
+  }
+  return true;
+}
+
+// reads and throws away size bytes, false on timeout or close
+static bool Drain(SocketPtr client, size_t size)
+{
+  std::vector<char> buffer(SEND_CHUNK);
+  for (size_t got = 0; got < size;) {
+    if (!client->IsReadyForRead(REPLY_TIMEOUT))
+      return false;
+    size_t bytes = client->Receive(buffer.data(), buffer.size(), 0);
+    if (0 == bytes)
+      return false;
+    got += bytes;
+  }
+  return true;
+}
+
+// a logged in telnet client, the prompt and greeting read; sending before
+// the greeting could end up in the password
+static SocketPtr Login()
+{
+  SocketPtr client = Connect();
+  static const char password[] = "x\n";
+  if (!client || !SendAll(client, password, sizeof(password) - 1) ||
+      !Drain(client, sizeof("password: ") - 1 + sizeof(READY) - 1))
+    return nullptr;
+  return client;
+}
+
+// MB/s into the server and bytes per receive callback
+static void Inbound(const char* name, const BufferSizing& sizing)
+{
+  BulkHandler handler;
+  auto server = StartServer(ProtocolTelnet, sizing, handler);
+  SocketPtr client = Login();
+  std::string bulk(BULK_BYTES, 'x');
+  double seconds = 0;
+  if (client) {
+    auto start = Clock::now();
+    if (SendAll(client, bulk.data(), bulk.size())) {
+      while (handler.received.load() < bulk.size() &&
+             SecondsSince(start) < REPLY_TIMEOUT.count() / 1000.0)
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+      if (handler.received.load() == bulk.size())
+        seconds = SecondsSince(start);
+    }
+  }
+  client.reset();
+  server->Stop();
+  if (0 == seconds) {
+    printf("%-26s failed\n", name);
+    return;
+  }
+  printf("%-26s %7.1f MB/s  %7.0f B per read\n", name,
+         BULK_BYTES / seconds / 1e6,
+         static_cast<double>(BULK_BYTES) / handler.callbacks.load());
+}
+
+// MB/s of 16 KB SendToClient() writes reaching the client
+static void Outbound(const char* name, const BufferSizing& sizing)
+{
+  BulkHandler handler;
+  auto server = StartServer(ProtocolTelnet, sizing, handler);
+  SocketPtr client = Login();
+  double seconds = 0;
+  if (client) {
+    auto start = Clock::now();
+    if (SendAll(client, START_REPLY, sizeof(START_REPLY) - 1) &&
+        Drain(client, BULK_BYTES))
+      seconds = SecondsSince(start);
+  }
+  client.reset();
+  server->Stop();
+  if (0 == seconds) {
+    printf("%-26s failed\n", name);
+    return;
+  }
+  printf("%-26s %7.1f MB/s\n", name, BULK_BYTES / seconds / 1e6);
+}
+
+// buffer bytes per framed client: connected idle, right after a burst
+// from each and once they went quiet
+static void Idle(const char* name, const BufferSizing& sizing)
+{
+  BulkHandler handler;
+  auto server = StartServer(ProtocolVarintFrames, sizing, handler);
+  std::vector<SocketPtr> clients;
+  for (size_t i = 0; i < IDLE_CLIENTS; i++) {
+    if (SocketPtr client = Connect())
+      clients.push_back(client);
+  }
+  auto perClient = [&]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ServerStats stats = server->GetStats();
+    return stats.clients ? stats.bufferBytes / stats.clients : 0;
+  };
+  uint64_t idle = perClient();
+  // 1 KB frames, 1 MB from every client
+  std::byte header[FrameReader::MAX_HEADER];
+  size_t headerSize = FrameReader::EncodeHeader(FrameVarint, 1024, header);
+  std::string frame =
+    std::string(reinterpret_cast<const char*>(header), headerSize) +
+    std::string(1024, 'x');
+  std::string burst;
+  while (burst.size() < 1024 * 1024)
+    burst += frame;
+  for (auto& client : clients)
+    SendAll(client, burst.data(), burst.size());
+  auto start = Clock::now();
+  while (handler.callbacks.load() < clients.size() * (burst.size() /
+                                                      frame.size()) &&
+         SecondsSince(start) < REPLY_TIMEOUT.count() / 1000.0)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  uint64_t busy = perClient();
+  std::this_thread::sleep_for(SHRINK_AFTER * 12);
+  uint64_t quiet = perClient();
+  clients.clear();
+  server->Stop();
+  printf("%-26s %7llu B idle  %7llu B after a burst  %7llu B quiet\n", name,
+         static_cast<unsigned long long>(idle),
+         static_cast<unsigned long long>(busy),
+         static_cast<unsigned long long>(quiet));
+}
+
+int RunBuffers(int argc, char* argv[])
+{
+  BufferSizing adaptive;
+  adaptive.shrinkAfter = SHRINK_AFTER;
+  printf("%zu MB over loopback TCP, low latency server loop\n",
+         BULK_BYTES >> 20);
+  Inbound("inbound, fixed 256 B", FixedSizing(ProtocolTelnet));
+  Inbound("inbound, adaptive", adaptive);
+  Outbound("outbound, fixed 256 B", FixedSizing(ProtocolTelnet));
+  Outbound("outbound, adaptive", adaptive);
+  printf("%zu framed clients, buffer bytes per client\n", IDLE_CLIENTS);
+  Idle("fixed 64 KB reads", FixedSizing(ProtocolVarintFrames));
+  Idle("adaptive", adaptive);
+  return 0;
+}
+
+} // namespace FtBench
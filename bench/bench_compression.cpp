@@ -0,0 +1,101 @@
+#include "bench.hpp"
+
+#include "ft-socket/ft_compression.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace FtTCP;
+
+namespace FtBench {
+
+// uncompressed output per run
+static constexpr size_t STREAM_BYTES{32 * 1024 * 1024};
+
+// console output the way the server sends it: one message, one flush
+static std::vector<std::string> StatusTable()
+{
+  std::vector<std::string> messages;
+  for (int table = 0; table < 64; table++) {
+    std::string message = "client  queue      sent       received  state\n";
+    for (int row = 0; row < 40; row++) {
+      char line[96];
+      std::snprintf(line, sizeof(line), "%6d %6d %10d %10d  %s\n",
+                    table * 40 + row, (row * 37) % 512, row * 1234567,
+                    row * 7654321, (row % 3) ? "idle" : "busy");
+      message += line;
+    }
+    message += "user@system:$ ";
+    messages.push_back(message);
+  }
+  return messages;
+}
+
+static std::vector<std::string> LogLines()
+{
+  std::vector<std::string> messages;
+  for (int i = 0; i < 512; i++) {
+    char line[160];
+    std::snprintf(line, sizeof(line),
+                  "[I][TELNET] 2026-10-19 12:%02d:%02d.%03d client %d "
+                  "received %d bytes, %d queued\n",
+                  (i / 60) % 60, i % 60, (i * 7) % 1000, i % 97, i * 13 % 4096,
+                  i % 17);
+    messages.push_back(line);
+  }
+  return messages;
+}
+
+static std::vector<std::string> TestOut()
+{
+  std::string message;
+  for (int i = 0; i < 60; i++)
+    message += "Big text\n";
+  return {message + "user@system:$ "};
+}
+
+static void Measure(const char* name, const std::vector<std::string>& messages,
+                    const CompressionParameters& params)
+{
+  Deflater deflater(params);
+  if (!deflater.IsValid()) {
+    printf("%-8s failed\n", name);
+    return;
+  }
+  size_t count = 0;
+  auto start = Clock::now();
+  while (deflater.BytesIn() < STREAM_BYTES) {
+    const std::string& message = messages[count++ % messages.size()];
+    deflater.Compress(message.data(), message.size(), true);
+  }
+  double seconds = SecondsSince(start);
+  printf("%-8s ratio %5.1f:1  %7.1f MB/s  %6.2f us/message\n", name,
+         double(deflater.BytesIn()) / deflater.BytesOut(),
+         deflater.BytesIn() / seconds / (1024 * 1024), seconds * 1e6 / count);
+}
+
+int RunCompression(int argc, char* argv[])
+{
+  if (!Deflater::IsAvailable()) {
+    printf("built without compression support\n");
+    return 0;
+  }
+  const struct {
+    const char* name;
+    CompressionParameters params;
+  } configs[] = {
+    {"zlib defaults", {true, 6, 15, 8}},
+    {"server defaults", {}},
+    {"small and fast", {true, 1, 10, 3}},
+  };
+  for (const auto& config : configs) {
+    printf("-- %s: %zu bytes of state per client\n", config.name,
+           Deflater::MemoryFor(config.params));
+    Measure("table", StatusTable(), config.params);
+    Measure("log", LogLines(), config.params);
+    Measure("testout", TestOut(), config.params);
+  }
+  return 0;
+}
+
+} // namespace FtBench
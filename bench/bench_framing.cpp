@@ -0,0 +1,149 @@
+#include "bench.hpp"
+
+#include "ft-socket/ft_socket_server.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <sys/socket.h>
+#include <thread>
+#include <vector>
+
+using namespace FtTCP;
+
+namespace FtBench {
+
+// per run, split into frames of the measured size
+static constexpr size_t STREAM_BYTES{64 * 1024 * 1024};
+static constexpr size_t SEND_CHUNK{1024 * 1024};
+static constexpr std::chrono::milliseconds REPLY_TIMEOUT{10000};
+
+static constexpr char DONE[] = "done";
+
+// counts the frames, answers the last one with a frame of its own
+struct FrameCounter {
+  std::atomic<size_t> frames{0};
+  std::atomic<size_t> bytes{0};
+  size_t expected{0};
+
+  void OnReceive(Server& server, ClientHandle client, const void*,
+                 size_t size)
+  {
+    bytes += size;
+    if (++frames == expected)
+      server.SendFrame(client, DONE);
+  }
+};
+
+// the server binds from its own thread, retry until it listens
+static SocketPtr Connect()
+{
+  auto start = Clock::now();
+  while (SecondsSince(start) < 1.0) {
+    SocketPtr client = Socket::CreateSocket(
+      Address::CreateClientAddress("127.0.0.1", BENCH_PORT));
+    if (client->Connect() && client->IsReadyForWrite(REPLY_TIMEOUT) &&
+        client->FinishConnect())
+      return client;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return nullptr;
+}
+
+static bool SendAll(SocketPtr client, std::vector<std::byte>& data)
+{
+  for (size_t offset = 0; offset < data.size();) {
+    size_t sent = 0;
+    size_t bytes = std::min(SEND_CHUNK, data.size() - offset);
+    if (!client->IsReadyForWrite(REPLY_TIMEOUT) ||
+        !client->Send(&data[offset], bytes, MSG_NOSIGNAL, &sent))
+      return false;
+    offset += sent;
+  }
+  return true;
+}
+
+static bool ReceiveDone(SocketPtr client, FrameFormat format)
+{
+  std::byte expected[FrameReader::MAX_HEADER + sizeof(DONE)];
+  size_t size = FrameReader::EncodeHeader(format, sizeof(DONE) - 1, expected);
+  std::memcpy(expected + size, DONE, sizeof(DONE) - 1);
+  size += sizeof(DONE) - 1;
+  std::byte received[sizeof(expected)];
+  size_t got = 0;
+  while (got < size) {
+    if (!client->IsReadyForRead(REPLY_TIMEOUT))
+      return false;
+    size_t bytes = client->Receive(received + got, size - got, 0);
+    if (0 == bytes)
+      return false;
+    got += bytes;
+  }
+  return 0 == std::memcmp(received, expected, size);
+}
+
+// MB/s of payload from the first send to the reply frame, 0 on failure
+static double Stream(Protocol protocol, size_t frameSize, size_t* frames)
+{
+  FrameFormat format =
+    (ProtocolFixed32Frames == protocol) ? FrameFixed32 : FrameVarint;
+  *frames = STREAM_BYTES / frameSize;
+  // the whole stream is encoded up front, the client only calls send()
+  std::vector<std::byte> stream;
+  stream.reserve(*frames * (frameSize + FrameReader::MAX_HEADER));
+  std::vector<std::byte> payload(frameSize, std::byte('x'));
+  for (size_t i = 0; i < *frames; i++) {
+    std::byte header[FrameReader::MAX_HEADER];
+    size_t headerSize =
+      FrameReader::EncodeHeader(format, static_cast<uint32_t>(frameSize),
+                                header);
+    stream.insert(stream.end(), header, header + headerSize);
+    stream.insert(stream.end(), payload.begin(), payload.end());
+  }
+
+  ServerParameters parameters{BENCH_PORT, 4, std::chrono::seconds(60)};
+  parameters.protocol = protocol;
+  // without the 5 ms loop throttle, as a bulk producer would run it
+  parameters.lowLatency = true;
+  auto server = std::make_shared<Server>(parameters);
+  FrameCounter counter;
+  counter.expected = *frames;
+  server->SetOnReceiveDataCallback(&counter, &FrameCounter::OnReceive);
+  server->Start();
+
+  double seconds = 0;
+  SocketPtr client = Connect();
+  if (client) {
+    auto start = Clock::now();
+    if (SendAll(client, stream) && ReceiveDone(client, format))
+      seconds = SecondsSince(start);
+  }
+  client.reset();
+  server->Stop();
+  if (0 == seconds || counter.bytes != *frames * frameSize)
+    return 0;
+  return counter.bytes / seconds / (1024 * 1024);
+}
+
+int RunFraming(int argc, char* argv[])
+{
+  const struct {
+    const char* name;
+    Protocol protocol;
+  } formats[] = {{"varint", ProtocolVarintFrames},
+                 {"fixed32", ProtocolFixed32Frames}};
+  for (const auto& format : formats) {
+    for (size_t frameSize : {size_t(64), size_t(1024), size_t(64 * 1024)}) {
+      size_t frames = 0;
+      double throughput = Stream(format.protocol, frameSize, &frames);
+      if (0 == throughput) {
+        printf("%-8s %6zu B frames: failed\n", format.name, frameSize);
+        continue;
+      }
+      printf("%-8s %6zu B frames: %8.1f MB/s %10.0f frames/s\n", format.name,
+             frameSize, throughput, throughput * 1024 * 1024 / frameSize);
+    }
+  }
+  return 0;
+}
+
+} // namespace FtBench
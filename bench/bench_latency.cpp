@@ -0,0 +1,123 @@
+#include "bench.hpp"
+
+#include "ft-socket/ft_socket_server.hpp"
+
+#include <algorithm>
+#include <sys/socket.h>
+#include <thread>
+#include <vector>
+
+using namespace FtTCP;
+
+namespace FtBench {
+
+static constexpr int ROUND_TRIPS{2000};
+static constexpr std::chrono::milliseconds REPLY_TIMEOUT{1000};
+
+static constexpr char READY[] = "ready\n";
+
+// echoes every line back, any password is accepted
+struct EchoHandler {
+  void OnConnect(Server& server, ClientHandle client)
+  {
+    server.SendToClient(client, READY);
+  }
+  bool OnPassword(Server&, ClientHandle, const void*, size_t) { return true; }
+  void OnReceive(Server& server, ClientHandle client, const void* data,
+                 size_t size)
+  {
+    server.SendToClient(
+      client, std::string_view(static_cast<const char*>(data), size));
+  }
+};
+
+static bool ReadUntil(SocketPtr client, std::string_view expected)
+{
+  std::string received;
+  char buffer[256];
+  while (received.find(expected) == std::string::npos) {
+    if (!client->IsReadyForRead(REPLY_TIMEOUT))
+      return false;
+    size_t bytes = client->Receive(buffer, sizeof(buffer), 0);
+    if (0 == bytes)
+      return false;
+    received.append(buffer, bytes);
+  }
+  return true;
+}
+
+// the server binds from its own thread, retry until it listens
+static SocketPtr Connect()
+{
+  auto start = Clock::now();
+  while (SecondsSince(start) < 1.0) {
+    SocketPtr client = Socket::CreateSocket(
+      Address::CreateClientAddress("127.0.0.1", BENCH_PORT));
+    // Connect() may return before the handshake, refused shows up later
+    if (client->Connect() && client->IsReadyForWrite(REPLY_TIMEOUT) &&
+        client->FinishConnect())
+      return client;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return nullptr;
+}
+
+// round trip percentiles in microseconds, empty on failure
+static std::vector<double> PingPong(bool lowLatency)
+{
+  ServerParameters parameters{BENCH_PORT, 4, std::chrono::seconds(60)};
+  parameters.lowLatency = lowLatency;
+  auto server = std::make_shared<Server>(parameters);
+  EchoHandler handler;
+  server->SetOnPasswordEntered(&handler, &EchoHandler::OnPassword);
+  server->SetOnReceiveDataCallback(&handler, &EchoHandler::OnReceive);
+  server->SetOnClientConnectCallback(&handler, &EchoHandler::OnConnect);
+  server->Start();
+
+  std::vector<double> samples;
+  SocketPtr client = Connect();
+  if (client && ReadUntil(client, "password: ")) {
+    // Socket::Send takes a mutable buffer
+    char password[] = "x\n";
+    char ping[] = "ping\n";
+    size_t sent = 0;
+    // a ping in the same read as the password would count as password
+    if (!client->Send(password, sizeof(password) - 1, MSG_NOSIGNAL, &sent) ||
+        !ReadUntil(client, READY))
+      client.reset();
+    for (int i = 0; client && i < ROUND_TRIPS; i++) {
+      auto start = Clock::now();
+      if (!client->Send(ping, sizeof(ping) - 1, MSG_NOSIGNAL, &sent) ||
+          !ReadUntil(client, "ping"))
+        break;
+      samples.push_back(MicrosecondsSince(start));
+    }
+  }
+  client.reset();
+  server->Stop();
+  std::sort(samples.begin(), samples.end());
+  return samples;
+}
+
+static void Report(const char* name, const std::vector<double>& samples)
+{
+  if (samples.empty()) {
+    printf("%-12s failed\n", name);
+    return;
+  }
+  auto at = [&](double share) {
+    return samples[std::min(samples.size() - 1,
+                            static_cast<size_t>(share * samples.size()))];
+  };
+  printf("%-12s p50 %8.1f us  p99 %8.1f us  max %8.1f us (%zu round trips)\n",
+         name, at(0.5), at(0.99), samples.back(), samples.size());
+}
+
+int RunLatency(int argc, char* argv[])
+{
+  Report("default", PingPong(false));
+  Report("low latency", PingPong(true));
+  return 0;
+}
+
+} // namespace FtBench
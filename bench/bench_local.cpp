@@ -0,0 +1,184 @@
+#include "bench.hpp"
+
+#include "ft-socket/ft_socket_server.hpp"
+
+#include <algorithm>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace FtTCP;
+
+namespace FtBench {
+
+static constexpr int ROUND_TRIPS{5000};
+static constexpr std::chrono::milliseconds REPLY_TIMEOUT{1000};
+
+static constexpr char READY[] = "ready\n";
+
+struct EchoHandler {
+  void OnConnect(Server& server, ClientHandle client)
+  {
+    server.SendToClient(client, READY);
+  }
+  bool OnPassword(Server&, ClientHandle, const void*, size_t) { return true; }
+  void OnReceive(Server& server, ClientHandle client, const void* data,
+                 size_t size)
+  {
+    server.SendToClient(
+      client, std::string_view(static_cast<const char*>(data), size));
+  }
+};
+
+static bool ReadUntil(SocketPtr client, std::string_view expected)
+{
+  std::string received;
+  char buffer[256];
+  while (received.find(expected) == std::string::npos) {
+    if (!client->IsReadyForRead(REPLY_TIMEOUT))
+      return false;
+    size_t bytes = client->Receive(buffer, sizeof(buffer), 0);
+    if (0 == bytes)
+      return false;
+    received.append(buffer, bytes);
+  }
+  return true;
+}
+
+static AddressPtr ClientAddress(const std::string& unixPath)
+{
+  if (unixPath.empty())
+    return Address::CreateClientAddress("127.0.0.1", BENCH_PORT);
+  return Address::CreateUnixAddress(unixPath, false);
+}
+
+// the server binds from its own thread, retry until it listens
+static SocketPtr Connect(const std::string& unixPath)
+{
+  auto start = Clock::now();
+  while (SecondsSince(start) < 1.0) {
+    SocketPtr client = Socket::CreateSocket(ClientAddress(unixPath));
+    if (client->Connect() && client->IsReadyForWrite(REPLY_TIMEOUT) &&
+        client->FinishConnect())
+      return client;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return nullptr;
+}
+
+// round trips through the server in microseconds; the unix socket peer is
+// trusted by uid, the TCP one types a password
+static std::vector<double> PingPong(const std::string& unixPath,
+                                    bool lowLatency)
+{
+  ServerParameters parameters{BENCH_PORT, 4, std::chrono::seconds(60)};
+  parameters.lowLatency = lowLatency;
+  parameters.unixPath = unixPath;
+  parameters.trustedUids = {getuid()};
+  auto server = std::make_shared<Server>(parameters);
+  EchoHandler handler;
+  server->SetOnPasswordEntered(&handler, &EchoHandler::OnPassword);
+  server->SetOnReceiveDataCallback(&handler, &EchoHandler::OnReceive);
+  server->SetOnClientConnectCallback(&handler, &EchoHandler::OnConnect);
+  server->Start();
+
+  std::vector<double> samples;
+  SocketPtr client = Connect(unixPath);
+  char password[] = "x\n";
+  char ping[] = "ping\n";
+  size_t sent = 0;
+  if (client && unixPath.empty() &&
+      (!ReadUntil(client, "password: ") ||
+       !client->Send(password, sizeof(password) - 1, MSG_NOSIGNAL, &sent)))
+    client.reset();
+  if (client && !ReadUntil(client, READY))
+    client.reset();
+  for (int i = 0; client && i < ROUND_TRIPS; i++) {
+    auto start = Clock::now();
+    if (!client->Send(ping, sizeof(ping) - 1, MSG_NOSIGNAL, &sent) ||
+        !ReadUntil(client, "ping"))
+      break;
+    samples.push_back(MicrosecondsSince(start));
+  }
+  client.reset();
+  server->Stop();
+  std::sort(samples.begin(), samples.end());
+  return samples;
+}
+
+// the transport alone: a blocking echo thread on a bare listener
+static std::vector<double> KernelPingPong(const std::string& unixPath)
+{
+  AddressPtr address = unixPath.empty()
+                         ? Address::CreateListenerAddress(BENCH_PORT, false)
+                         : Address::CreateUnixAddress(unixPath, true);
+  SocketPtr listener = Socket::CreateSocket(address);
+  std::vector<double> samples;
+  if (!listener->Bind() || !listener->Listen())
+    return samples;
+  std::thread echo([listener]() {
+    SocketPtr peer = listener->Accept(REPLY_TIMEOUT);
+    if (!peer)
+      return;
+    peer->ApplyOptions(SocketOptions::Interactive());
+    char buffer[256];
+    size_t bytes;
+    while (0 != (bytes = peer->Receive(buffer, sizeof(buffer), 0))) {
+      size_t sent = 0;
+      if (!peer->Send(buffer, bytes, MSG_NOSIGNAL, &sent))
+        break;
+    }
+  });
+  SocketPtr client = Connect(unixPath);
+  if (client)
+    client->ApplyOptions(SocketOptions::Interactive());
+  char ping[] = "ping\n";
+  for (int i = 0; client && i < ROUND_TRIPS; i++) {
+    size_t sent = 0;
+    auto start = Clock::now();
+    if (!client->Send(ping, sizeof(ping) - 1, MSG_NOSIGNAL, &sent) ||
+        !ReadUntil(client, "ping"))
+      break;
+    samples.push_back(MicrosecondsSince(start));
+  }
+  client.reset();
+  echo.join();
+  std::sort(samples.begin(), samples.end());
+  return samples;
+}
+
+static void Report(const char* name, const std::vector<double>& samples)
+{
+  if (samples.empty()) {
+    printf("%-22s failed\n", name);
+    return;
+  }
+  auto at = [&](double share) {
+    return samples[std::min(samples.size() - 1,
+                            static_cast<size_t>(share * samples.size()))];
+  };
+  printf("%-22s p50 %7.1f us  p99 %7.1f us  max %8.1f us\n", name, at(0.5),
+         at(0.99), samples.back());
+}
+
+int RunLocal(int argc, char* argv[])
+{
+  std::string path = "/tmp/ft-socket-bench-" + std::to_string(getpid());
+  std::string abstractPath = "@" + path.substr(1);
+  printf("%d round trips of 5 bytes\n", ROUND_TRIPS);
+  Report("kernel tcp", KernelPingPong(""));
+  Report("kernel unix", KernelPingPong(path));
+  unlink(path.c_str());
+  Report("server tcp", PingPong("", false));
+  Report("server unix", PingPong(path, false));
+  unlink(path.c_str());
+  Report("low latency tcp", PingPong("", true));
+  Report("low latency unix", PingPong(path, true));
+  unlink(path.c_str());
+  Report("low latency abstract", PingPong(abstractPath, true));
+  return 0;
+}
+
+} // namespace FtBench
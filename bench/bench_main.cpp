@@ -0,0 +1,61 @@
+#include "bench.hpp"
+
+#include <cstring>
+
+struct BenchEntry {
+  const char* option;
+  const char* description;
+  int (*run)(int argc, char* argv[]);
+};
+
+static const BenchEntry benchmarks[] = {
+  {"-tls", "TLS throughput and handshake vs. resumption", FtBench::RunTls},
+  {"-pool", "allocations per message, vectors vs. pooled buffers",
+   FtBench::RunPool},
+  {"-pingpong", "round trip time, default vs. low latency mode",
+   FtBench::RunLatency},
+  {"-sessions", "coroutine sessions vs. thread per client, 1k and 10k",
+   FtBench::RunSessions},
+  {"-framing", "length-prefixed frames at 64 B, 1 KB and 64 KB",
+   FtBench::RunFraming},
+  {"-compression", "MCCP2 ratio and CPU cost per flushed message",
+   FtBench::RunCompression},
+  {"-writer", "per-fragment cost, SendToClient vs. ClientWriter",
+   FtBench::RunWriter},
+  {"-local", "round trip time, unix socket vs. loopback TCP",
+   FtBench::RunLocal},
+  {"-transport", "server pipeline over the memory transport vs. TCP",
+   FtBench::RunTransport},
+  {"-buffers", "fixed vs. adaptive buffers: bulk MB/s, bytes per client",
+   FtBench::RunBuffers},
+  {"-batch", "command log writes, per receive vs. batch callback",
+   FtBench::RunBatch},
+  {"-access", "CIDR rule lookups at 1k to 100k rules, per address caps",
+   FtBench::RunAccess},
+};
+
+static int RunBench(const BenchEntry& bench, int argc, char* argv[])
+{
+  printf("== %s: %s\n", bench.option, bench.description);
+  return bench.run(argc, argv);
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2 || 0 == strcmp(argv[1], "-all")) {
+    for (const auto& bench : benchmarks) {
+      if (int result = RunBench(bench, argc, argv))
+        return result;
+    }
+    return 0;
+  }
+  for (const auto& bench : benchmarks) {
+    if (0 == strcmp(argv[1], bench.option))
+      return RunBench(bench, argc, argv);
+  }
+  printf("usage: %s [-all", argv[0]);
+  for (const auto& bench : benchmarks)
+    printf(" | %s", bench.option);
+  printf("]\n");
+  return 1;
+}
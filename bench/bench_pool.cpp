@@ -0,0 +1,136 @@
+#include "bench.hpp"
+
+#include "ft-socket/ft_socket_queues.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <deque>
+#include <new>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// every operator new in the benchmark binary is counted while armed
+static std::atomic_bool countAllocations{false};
+static std::atomic<uint64_t> allocations{0};
+
+void* operator new(std::size_t size)
+{
+  if (countAllocations.load(std::memory_order_relaxed))
+    allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* pointer = std::malloc(size ? size : 1))
+    return pointer;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept
+{
+  std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+  std::free(pointer);
+}
+
+using namespace FtTCP;
+
+namespace FtBench {
+
+static constexpr int MESSAGES{100000};
+static constexpr int MESSAGES_PER_SESSION{100};
+static constexpr size_t LEGACY_CHUNK{256};
+static constexpr size_t RECEIVE_BUFFER_SIZE{256};
+
+static void Drain(int fd)
+{
+  static char sink[64 * 1024];
+  while (recv(fd, sink, sizeof(sink), MSG_DONTWAIT) > 0) {
+  }
+}
+
+// the send path as it was: a vector per chunk, copied again on every send
+static void LegacyRound(std::deque<std::vector<std::byte>>& queue, int fd,
+                        const std::string_view* parts, size_t count)
+{
+  for (size_t i = 0; i < count; i++) {
+    auto* pointer = reinterpret_cast<const std::byte*>(parts[i].data());
+    size_t remainder = parts[i].size();
+    while (remainder) {
+      size_t bytes = std::min(remainder, LEGACY_CHUNK);
+      queue.emplace_back(pointer, pointer + bytes);
+      pointer += bytes;
+      remainder -= bytes;
+    }
+  }
+  while (!queue.empty()) {
+    std::vector<std::byte> buffer = queue.front();
+    send(fd, buffer.data(), buffer.size(), MSG_NOSIGNAL);
+    queue.pop_front();
+  }
+}
+
+int RunPool(int argc, char* argv[])
+{
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) {
+    printf("socketpair failed\n");
+    return 1;
+  }
+  const std::string body(540, 'x');
+  const std::string_view parts[] = {"Ok\n", body, "user@system:$ "};
+  const size_t partCount = sizeof(parts) / sizeof(parts[0]);
+
+  std::deque<std::vector<std::byte>> legacyQueue;
+  allocations = 0;
+  countAllocations = true;
+  auto start = Clock::now();
+  for (int i = 0; i < MESSAGES; i++) {
+    if (0 == i % MESSAGES_PER_SESSION) {
+      std::vector<std::byte> receiveBuffer(RECEIVE_BUFFER_SIZE);
+    }
+    LegacyRound(legacyQueue, fds[0], parts, partCount);
+    Drain(fds[1]);
+  }
+  countAllocations = false;
+  double legacySeconds = SecondsSince(start);
+  uint64_t legacyAllocations = allocations;
+
+  // the socket takes ownership of its descriptor
+  SocketPtr socket = Socket::CreateSocket(
+    Address::CreateClientAddress("127.0.0.1", BENCH_PORT), fds[0]);
+  BufferPoolStats before = BufferPool::Instance().GetStats();
+  allocations = 0;
+  countAllocations = true;
+  start = Clock::now();
+  {
+    SocketSendQueue queue;
+    for (int i = 0; i < MESSAGES; i++) {
+      if (0 == i % MESSAGES_PER_SESSION) {
+        Buffer receiveBuffer(RECEIVE_BUFFER_SIZE);
+      }
+      for (const auto& part : parts)
+        queue.Push(part.data(), part.size());
+      while (!queue.IsEmpty())
+        queue.Send(socket);
+      Drain(fds[1]);
+    }
+  }
+  countAllocations = false;
+  double pooledSeconds = SecondsSince(start);
+  uint64_t pooledAllocations = allocations;
+  BufferPoolStats after = BufferPool::Instance().GetStats();
+
+  printf("legacy vectors: %6.2f allocations/message %8.0f messages/s\n",
+         double(legacyAllocations) / MESSAGES, MESSAGES / legacySeconds);
+  printf("pooled buffers: %6.2f allocations/message %8.0f messages/s\n",
+         double(pooledAllocations) / MESSAGES, MESSAGES / pooledSeconds);
+  printf("pool blocks from the system during the run: %llu\n",
+         static_cast<unsigned long long>(after.systemAllocations -
+                                         before.systemAllocations));
+  printf("%s\n", after.ToString().c_str());
+  close(fds[1]);
+  return 0;
+}
+
+} // namespace FtBench
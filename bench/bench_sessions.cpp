@@ -0,0 +1,194 @@
+#include "bench.hpp"
+
+#include "ft-socket/ft_load_generator.hpp"
+#include "ft-socket/ft_session_server.hpp"
+#include "ft-socket/ft_socket_server.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace FtTCP;
+
+namespace FtBench {
+
+static constexpr unsigned short int SESSIONS_PORT{BENCH_PORT + 1};
+static constexpr unsigned int SCALES[] = {1000, 10000};
+static constexpr unsigned int CONNECT_RATE{2000};
+static constexpr std::chrono::seconds MEASURE_TIME{3};
+static constexpr std::chrono::milliseconds SAMPLE_PERIOD{100};
+static constexpr std::string_view PASSWORD = "123";
+static constexpr std::string_view PASSWORD_PROMPT = "password: ";
+static constexpr std::string_view REPLY = "Ok\n$ ";
+
+// the thread-per-client server answering like the coroutine session below
+struct ThreadedHandler {
+  bool OnPassword(Server&, ClientHandle, const void* data, size_t size)
+  {
+    std::string_view line(static_cast<const char*>(data), size);
+    return 0 == line.rfind(PASSWORD, 0);
+  }
+  void OnConnect(Server& server, ClientHandle client)
+  {
+    server.SendToClient(client, "$ ");
+  }
+  void OnReceive(Server& server, ClientHandle client, const void*, size_t)
+  {
+    server.SendToClient(client, REPLY);
+  }
+};
+
+static Task<void> BenchSession(Connection& connection)
+{
+  co_await connection.Write(PASSWORD_PROMPT);
+  auto password = co_await connection.ReadLine();
+  if (!password || *password != PASSWORD)
+    co_return;
+  co_await connection.Write("$ ");
+  while (co_await connection.ReadLine()) {
+    if (!co_await connection.Write(REPLY))
+      break;
+  }
+}
+
+static void RaiseDescriptorLimit()
+{
+  rlimit limit;
+  if (0 == getrlimit(RLIMIT_NOFILE, &limit)) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+}
+
+// VmRSS in MB and the thread count of a process
+static void ProcessUsage(pid_t pid, double* rssMb, int* threads)
+{
+  std::ifstream status("/proc/" + std::to_string(pid) + "/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (0 == line.rfind("VmRSS:", 0))
+      *rssMb = std::stod(line.substr(6)) / 1024;
+    else if (0 == line.rfind("Threads:", 0))
+      *threads = std::stoi(line.substr(8));
+  }
+}
+
+// the server runs in a child, each side needs a descriptor per session
+static pid_t ForkServer(bool coroutines, unsigned int sessions)
+{
+  int ready[2];
+  if (pipe(ready))
+    return -1;
+  pid_t pid = fork();
+  if (0 != pid) {
+    close(ready[1]);
+    char byte = 0;
+    // EOF means the child failed to start
+    bool started = 1 == read(ready[0], &byte, 1);
+    close(ready[0]);
+    return started ? pid : -1;
+  }
+  close(ready[0]);
+  RaiseDescriptorLimit();
+  unsigned short int maxConnections =
+    static_cast<unsigned short int>(std::min(sessions + 100, 65535u));
+  if (coroutines) {
+    SessionParameters parameters{SESSIONS_PORT, maxConnections,
+                                 std::chrono::seconds(60), 4096};
+    SessionServer server(parameters, BenchSession);
+    // runs until the SIGTERM at the end of the measurement
+    if (server.Start() && 1 == write(ready[1], "1", 1))
+      pause();
+  }
+  else {
+    ServerParameters parameters{SESSIONS_PORT, maxConnections,
+                                std::chrono::seconds(60)};
+    parameters.backlog = 4096;
+    Server server(parameters);
+    ThreadedHandler handler;
+    server.SetOnPasswordEntered(&handler, &ThreadedHandler::OnPassword);
+    server.SetOnClientConnectCallback(&handler, &ThreadedHandler::OnConnect);
+    server.SetOnReceiveDataCallback(&handler, &ThreadedHandler::OnReceive);
+    server.Start();
+    // Start() binds from the listener thread
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    if (1 == write(ready[1], "1", 1))
+      pause();
+  }
+  _exit(0);
+}
+
+static void RunScale(bool coroutines, unsigned int sessions)
+{
+  const char* name = coroutines ? "coroutines" : "threads";
+  pid_t pid = ForkServer(coroutines, sessions);
+  if (pid < 0) {
+    printf("%-10s %6u: server failed to start\n", name, sessions);
+    return;
+  }
+  LoadParameters load;
+  load.host = "127.0.0.1";
+  load.port = SESSIONS_PORT;
+  load.sessions = sessions;
+  load.connectRate = CONNECT_RATE;
+  load.duration =
+    std::chrono::seconds(sessions / CONNECT_RATE + 1) + MEASURE_TIME;
+  load.password = std::string(PASSWORD);
+  load.commandsPerSession = 1000000;
+  load.script = {{"status", 1}};
+  load.passwordPrompt = std::string(PASSWORD_PROMPT);
+  // the generator closes its sessions before Run() returns, the server
+  // is sampled while they are open
+  std::atomic_bool running{true};
+  double rssMb = 0;
+  int threads = 0;
+  std::thread sampler([&]() {
+    while (running) {
+      double sampleRss = 0;
+      int sampleThreads = 0;
+      ProcessUsage(pid, &sampleRss, &sampleThreads);
+      rssMb = std::max(rssMb, sampleRss);
+      threads = std::max(threads, sampleThreads);
+      std::this_thread::sleep_for(SAMPLE_PERIOD);
+    }
+  });
+  LoadReport report = LoadGenerator::CreateLoadGenerator(load)->Run();
+  running = false;
+  sampler.join();
+
+  int status = 0;
+  bool crashed = pid == waitpid(pid, &status, WNOHANG);
+  if (!crashed) {
+    kill(pid, SIGTERM);
+    waitpid(pid, &status, 0);
+  }
+
+  printf("%-10s %6u: logins=%-6llu commands/s=%-8.0f p50=%lldus "
+         "p99=%lldus peak rss=%.1fMB threads=%d\n",
+         name, sessions, static_cast<unsigned long long>(report.logins),
+         report.commandsPerSecond,
+         static_cast<long long>(report.latencyP50.count()),
+         static_cast<long long>(report.latencyP99.count()), rssMb, threads);
+  if (crashed)
+    printf("%-10s %6u: server died during the run, status %d\n", name,
+           sessions, status);
+}
+
+int RunSessions(int argc, char* argv[])
+{
+  RaiseDescriptorLimit();
+  for (unsigned int sessions : SCALES) {
+    RunScale(false, sessions);
+    RunScale(true, sessions);
+  }
+  return 0;
+}
+
+} // namespace FtBench
@@ -0,0 +1,146 @@
+#include "bench.hpp"
+
+#include "ft-socket/ft_socket.hpp"
+
+#include <sys/socket.h>
+#include <thread>
+#include <vector>
+
+using namespace FtTCP;
+
+namespace FtBench {
+
+static constexpr size_t THROUGHPUT_BYTES{64 * 1024 * 1024};
+static constexpr size_t CHUNK_BYTES{16 * 1024};
+static constexpr int HANDSHAKES{200};
+static constexpr std::chrono::milliseconds ACCEPT_TIMEOUT{2000};
+
+static SocketPtr CreateListener(unsigned short int port)
+{
+  SocketPtr listener =
+    Socket::CreateSocket(Address::CreateListenerAddress(port, false));
+  if (!listener->Bind() || !listener->Listen())
+    return nullptr;
+  return listener;
+}
+
+static SocketPtr ConnectClient(unsigned short int port, TlsContextPtr tls)
+{
+  SocketPtr client =
+    Socket::CreateSocket(Address::CreateClientAddress("127.0.0.1", port));
+  if (!client->Connect())
+    return nullptr;
+  if (tls && !client->StartTls(tls))
+    return nullptr;
+  return client;
+}
+
+static double Throughput(SocketPtr listener, TlsContextPtr serverTls,
+                         TlsContextPtr clientTls, bool* kernelTls)
+{
+  double seconds = 0;
+  std::thread receiver([&]() {
+    SocketPtr peer = listener->Accept(ACCEPT_TIMEOUT);
+    if (!peer || (serverTls && !peer->StartTls(serverTls)))
+      return;
+    std::vector<char> buffer(CHUNK_BYTES);
+    size_t total = 0;
+    auto start = Clock::now();
+    while (total < THROUGHPUT_BYTES) {
+      size_t received = peer->Receive(buffer.data(), buffer.size(), 0);
+      if (0 == received)
+        break;
+      total += received;
+    }
+    seconds = SecondsSince(start);
+  });
+
+  SocketPtr client = ConnectClient(BENCH_PORT, clientTls);
+  if (client) {
+    *kernelTls = client->IsKernelTls();
+    std::vector<char> chunk(CHUNK_BYTES, 'x');
+    for (size_t sent = 0; sent < THROUGHPUT_BYTES;) {
+      size_t bytes = 0;
+      if (!client->Send(chunk.data(), chunk.size(), MSG_NOSIGNAL, &bytes))
+        break;
+      sent += bytes;
+    }
+  }
+  receiver.join();
+  return (seconds > 0) ? THROUGHPUT_BYTES / seconds / (1024 * 1024) : 0;
+}
+
+// average microseconds from connect() to a finished handshake
+static double Handshakes(SocketPtr listener, TlsContextPtr serverTls,
+                         TlsContextPtr clientTls, bool resume, int* resumed)
+{
+  std::thread acceptor([&]() {
+    for (int i = 0; i < HANDSHAKES; i++) {
+      SocketPtr peer = listener->Accept(ACCEPT_TIMEOUT);
+      if (!peer || !peer->StartTls(serverTls))
+        continue;
+      char byte = '!';
+      size_t sent = 0;
+      peer->Send(&byte, 1, MSG_NOSIGNAL, &sent);
+      // wait for the client to finish with the session tickets
+      peer->Receive(&byte, 1, 0);
+    }
+  });
+
+  double total = 0;
+  *resumed = 0;
+  clientTls->ForgetSession();
+  for (int i = 0; i < HANDSHAKES; i++) {
+    if (!resume)
+      clientTls->ForgetSession();
+    auto start = Clock::now();
+    SocketPtr client = ConnectClient(BENCH_PORT, clientTls);
+    if (!client)
+      continue;
+    total += MicrosecondsSince(start);
+    *resumed += client->IsTlsResumed() ? 1 : 0;
+    // the read also consumes the post-handshake tickets
+    char byte;
+    client->Receive(&byte, 1, 0);
+  }
+  acceptor.join();
+  return total / HANDSHAKES;
+}
+
+int RunTls(int argc, char* argv[])
+{
+  if (!TlsContext::IsAvailable()) {
+    printf("built without TLS support\n");
+    return 0;
+  }
+  TlsContextPtr serverTls =
+    TlsContext::CreateSelfSignedServerContext("localhost");
+  // the server's certificate is self-signed
+  TlsVerifyParameters verify;
+  verify.verifyPeer = false;
+  TlsContextPtr clientTls = TlsContext::CreateClientContext(verify);
+  SocketPtr listener = CreateListener(BENCH_PORT);
+  if (!serverTls || !clientTls || !listener) {
+    printf("can't set up TLS benchmark\n");
+    return 1;
+  }
+
+  bool kernelTls = false;
+  double plain = Throughput(listener, nullptr, nullptr, &kernelTls);
+  double tls = Throughput(listener, serverTls, clientTls, &kernelTls);
+  printf("throughput plaintext: %8.1f MB/s\n", plain);
+  printf("throughput TLS:       %8.1f MB/s (%s)\n", tls,
+         kernelTls ? "kernel TLS" : "userspace records, kTLS unavailable");
+
+  int resumed = 0;
+  double full = Handshakes(listener, serverTls, clientTls, false, &resumed);
+  printf("full handshake:       %8.1f us (%d/%d resumed)\n", full, resumed,
+         HANDSHAKES);
+  double resumption =
+    Handshakes(listener, serverTls, clientTls, true, &resumed);
+  printf("resumed handshake:    %8.1f us (%d/%d resumed)\n", resumption,
+         resumed, HANDSHAKES);
+  return 0;
+}
+
+} // namespace FtBench
@@ -0,0 +1,262 @@
+#include "bench.hpp"
+
+#include "ft-socket/ft_memory_transport.hpp"
+#include "ft-socket/ft_socket_server.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <vector>
+
+using namespace FtTCP;
+
+namespace FtBench {
+
+static constexpr size_t MESSAGES{2000000};
+static constexpr size_t PAYLOAD{16};
+static constexpr size_t SEND_CHUNK{64 * 1024};
+static constexpr int RUNS{3};
+static constexpr int ROUND_TRIPS{20000};
+static constexpr std::chrono::milliseconds REPLY_TIMEOUT{10000};
+
+static constexpr char READY[] = "ready\n";
+
+using Connector = std::function<SocketPtr()>;
+
+// counts frames (or bytes of telnet lines), echoes when asked to
+struct Handler {
+  std::atomic<size_t> received{0};
+  Protocol protocol{ProtocolTelnet};
+  bool echo{false};
+
+  void OnConnect(Server& server, ClientHandle client)
+  {
+    if (ProtocolTelnet == protocol)
+      server.SendToClient(client, READY);
+  }
+  bool OnPassword(Server&, ClientHandle, const void*, size_t) { return true; }
+  void OnReceive(Server& server, ClientHandle client, const void* data,
+                 size_t size)
+  {
+    received.fetch_add(
+      (ProtocolTelnet == protocol) ? size : 1,
+      std::memory_order_relaxed);
+    if (echo)
+      server.SendFrame(client, std::string_view(
+                                 static_cast<const char*>(data), size));
+  }
+};
+
+// the server listens from its own thread, retry until it does
+static SocketPtr Connect(const Connector& connector)
+{
+  auto start = Clock::now();
+  while (SecondsSince(start) < 1.0) {
+    if (SocketPtr client = connector())
+      return client;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return nullptr;
+}
+
+static SocketPtr ConnectTcp()
+{
+  SocketPtr client = Socket::CreateSocket(
+    Address::CreateClientAddress("127.0.0.1", BENCH_PORT));
+  if (client->Connect() && client->IsReadyForWrite(REPLY_TIMEOUT) &&
+      client->FinishConnect())
+    return client;
+  return nullptr;
+}
+
+static bool SendAll(SocketPtr client, const std::string& data)
+{
+  for (size_t offset = 0; offset < data.size();) {
+    size_t sent = 0;
+    size_t bytes = std::min(SEND_CHUNK, data.size() - offset);
+    if (!client->IsReadyForWrite(REPLY_TIMEOUT) ||
+        !client->Send(const_cast<char*>(&data[offset]), bytes, MSG_NOSIGNAL,
+                      &sent))
+      return false;
+    offset += sent;
+  }
+  return true;
+}
+
+static bool ReceiveAll(SocketPtr client, char* data, size_t size)
+{
+  for (size_t got = 0; got < size;) {
+    if (!client->IsReadyForRead(REPLY_TIMEOUT))
+      return false;
+    size_t bytes = client->Receive(data + got, size - got, 0);
+    if (0 == bytes)
+      return false;
+    got += bytes;
+  }
+  return true;
+}
+
+static std::string Frame()
+{
+  std::byte header[FrameReader::MAX_HEADER];
+  size_t headerSize = FrameReader::EncodeHeader(FrameVarint, PAYLOAD, header);
+  return std::string(reinterpret_cast<const char*>(header), headerSize) +
+         std::string(PAYLOAD, 'x');
+}
+
+static std::shared_ptr<Server> StartServer(Protocol protocol,
+                                           TransportPtr transport,
+                                           Handler& handler)
+{
+  ServerParameters parameters{BENCH_PORT, 4, std::chrono::seconds(60)};
+  parameters.protocol = protocol;
+  parameters.transport = transport;
+  // without the 5 ms loop throttle
+  parameters.lowLatency = true;
+  handler.protocol = protocol;
+  auto server = std::make_shared<Server>(parameters);
+  server->SetOnPasswordEntered(&handler, &Handler::OnPassword);
+  server->SetOnClientConnectCallback(&handler, &Handler::OnConnect);
+  server->SetOnReceiveDataCallback(&handler, &Handler::OnReceive);
+  server->Start();
+  return server;
+}
+
+// messages per second through password (telnet), framing and the receive
+// callback, 0 on failure
+static double Stream(Protocol protocol, TransportPtr transport,
+                     const Connector& connector)
+{
+  std::string message = (ProtocolTelnet == protocol)
+                          ? std::string(PAYLOAD - 1, 'x') + "\n"
+                          : Frame();
+  std::string stream;
+  stream.reserve(MESSAGES * message.size());
+  for (size_t i = 0; i < MESSAGES; i++)
+    stream += message;
+  size_t expected = (ProtocolTelnet == protocol) ? stream.size() : MESSAGES;
+
+  Handler handler;
+  auto server = StartServer(protocol, transport, handler);
+  double seconds = 0;
+  SocketPtr client = Connect(connector);
+  // the prompt, then the greeting once the password is accepted
+  char reply[sizeof("password: ") + sizeof(READY)];
+  if (client && ProtocolTelnet == protocol &&
+      (!SendAll(client, "x\n") ||
+       !ReceiveAll(client, reply, sizeof(reply) - 2)))
+    client.reset();
+  if (client) {
+    auto start = Clock::now();
+    if (SendAll(client, stream)) {
+      while (handler.received.load() < expected &&
+             SecondsSince(start) < REPLY_TIMEOUT.count() / 1000.0)
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+      if (handler.received.load() == expected)
+        seconds = SecondsSince(start);
+    }
+  }
+  client.reset();
+  server->Stop();
+  return seconds ? MESSAGES / seconds : 0;
+}
+
+// framed echo round trips in microseconds
+static std::vector<double> PingPong(TransportPtr transport,
+                                    const Connector& connector, int count)
+{
+  Handler handler;
+  handler.echo = true;
+  auto server = StartServer(ProtocolVarintFrames, transport, handler);
+  std::vector<double> samples;
+  SocketPtr client = Connect(connector);
+  std::string frame = Frame();
+  std::string reply(frame.size(), '\0');
+  for (int i = 0; client && i < count; i++) {
+    auto start = Clock::now();
+    if (!SendAll(client, frame) ||
+        !ReceiveAll(client, reply.data(), reply.size()))
+      break;
+    samples.push_back(MicrosecondsSince(start));
+  }
+  client.reset();
+  server->Stop();
+  std::sort(samples.begin(), samples.end());
+  return samples;
+}
+
+static void ReportStream(const char* name, Protocol protocol,
+                         std::function<TransportPtr()> transport,
+                         const Connector& connect)
+{
+  std::vector<double> runs;
+  for (int run = 0; run < RUNS; run++) {
+    // a fresh transport per run, the server listens on it once
+    TransportPtr current = transport();
+    double rate =
+      Stream(protocol, current,
+             current ? Connector([current]() { return current->Connect(); })
+                     : connect);
+    if (0 == rate) {
+      printf("%-20s failed\n", name);
+      return;
+    }
+    runs.push_back(rate / 1e6);
+  }
+  std::sort(runs.begin(), runs.end());
+  printf("%-20s %6.2f M msg/s  (runs %.2f .. %.2f, spread %4.1f%%)\n", name,
+         runs[RUNS / 2], runs.front(), runs.back(),
+         100 * (runs.back() - runs.front()) / runs[RUNS / 2]);
+}
+
+static void ReportPingPong(const char* name, TransportPtr transport,
+                           int count)
+{
+  Connector connect =
+    transport ? Connector([transport]() { return transport->Connect(); })
+              : Connector(ConnectTcp);
+  std::vector<double> samples = PingPong(transport, connect, count);
+  if (samples.empty()) {
+    printf("%-20s failed\n", name);
+    return;
+  }
+  auto at = [&](double share) {
+    return samples[std::min(samples.size() - 1,
+                            static_cast<size_t>(share * samples.size()))];
+  };
+  printf("%-20s p50 %7.1f us  p99 %7.1f us  max %8.1f us\n", name, at(0.5),
+         at(0.99), samples.back());
+}
+
+int RunTransport(int argc, char* argv[])
+{
+  auto memory = []() { return MemoryTransport::CreateMemoryTransport(); };
+  auto kernel = []() { return TransportPtr(); };
+  printf("%zu messages of %zu B, low latency server loop\n", MESSAGES,
+         PAYLOAD);
+  ReportStream("frames, memory", ProtocolVarintFrames, memory, nullptr);
+  ReportStream("frames, tcp", ProtocolVarintFrames, kernel, ConnectTcp);
+  ReportStream("telnet, memory", ProtocolTelnet, memory, nullptr);
+  ReportStream("telnet, tcp", ProtocolTelnet, kernel, ConnectTcp);
+
+  printf("%d framed echo round trips\n", ROUND_TRIPS);
+  ReportPingPong("memory", memory(), ROUND_TRIPS);
+  ReportPingPong("tcp", nullptr, ROUND_TRIPS);
+  MemoryLinkParameters link;
+  link.latency = std::chrono::microseconds(50);
+  ReportPingPong("memory, 50 us link",
+                 MemoryTransport::CreateMemoryTransport(link),
+                 ROUND_TRIPS / 10);
+  link.latency = std::chrono::microseconds(0);
+  link.bytesPerSecond = 1000 * 1000;
+  ReportPingPong("memory, 1 MB/s link",
+                 MemoryTransport::CreateMemoryTransport(link),
+                 ROUND_TRIPS / 10);
+  return 0;
+}
+
+} // namespace FtBench
@@ -0,0 +1,133 @@
+#include "bench.hpp"
+
+#include "ft-socket/ft_socket_server.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <sys/socket.h>
+#include <thread>
+
+using namespace FtTCP;
+
+namespace FtBench {
+
+static constexpr int REPLIES{100000};
+static constexpr int FRAGMENTS_PER_REPLY{8};
+static constexpr std::string_view FRAGMENT = "0123456789abcde\n";
+static constexpr std::chrono::milliseconds CONNECT_TIMEOUT{1000};
+
+struct ConnectRecorder {
+  std::atomic<ClientHandle> client{0};
+
+  void OnConnect(Server&, ClientHandle handle) { client = handle; }
+  bool OnPassword(Server&, ClientHandle, const void*, size_t) { return true; }
+};
+
+// the server binds from its own thread, retry until it listens
+static SocketPtr Connect()
+{
+  auto start = Clock::now();
+  while (SecondsSince(start) < 1.0) {
+    SocketPtr client = Socket::CreateSocket(
+      Address::CreateClientAddress("127.0.0.1", BENCH_PORT));
+    if (client->Connect() && client->IsReadyForWrite(CONNECT_TIMEOUT) &&
+        client->FinishConnect())
+      return client;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return nullptr;
+}
+
+// nanoseconds per fragment
+template<class Reply>
+static double Measure(Reply reply)
+{
+  auto start = Clock::now();
+  for (int i = 0; i < REPLIES; i++)
+    reply();
+  return MicrosecondsSince(start) * 1000 / (REPLIES * FRAGMENTS_PER_REPLY);
+}
+
+int RunWriter(int argc, char* argv[])
+{
+  ServerParameters parameters{BENCH_PORT, 4, std::chrono::seconds(60)};
+  auto server = std::make_shared<Server>(parameters);
+  ConnectRecorder recorder;
+  server->SetOnClientConnectCallback(&recorder, &ConnectRecorder::OnConnect);
+  server->SetOnPasswordEntered(&recorder, &ConnectRecorder::OnPassword);
+  server->Start();
+
+  SocketPtr client = Connect();
+  char password[] = "x\n";
+  size_t sent = 0;
+  if (!client || !client->Send(password, sizeof(password) - 1, MSG_NOSIGNAL,
+                               &sent)) {
+    printf("can't connect\n");
+    server->Stop();
+    return 1;
+  }
+  auto start = Clock::now();
+  while (0 == recorder.client && SecondsSince(start) < 1.0)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  ClientHandle handle = recorder.client;
+
+  // keeps the server's queue moving
+  std::atomic_bool draining{true};
+  std::thread drain([&]() {
+    char buffer[64 * 1024];
+    while (draining) {
+      if (client->IsReadyForRead(std::chrono::milliseconds(10)) &&
+          0 == client->Receive(buffer, sizeof(buffer), 0))
+        break;
+    }
+  });
+
+  double perSend = Measure([&]() {
+    for (int f = 0; f < FRAGMENTS_PER_REPLY; f++)
+      server->SendToClient(handle, FRAGMENT);
+  });
+  double perLookup = Measure([&]() {
+    ClientWriter writer = server->GetWriter(handle);
+    for (int f = 0; f < FRAGMENTS_PER_REPLY; f++)
+      writer << FRAGMENT;
+    writer.Commit();
+  });
+  ClientWriter writer = server->GetWriter(handle);
+  double perWriter = Measure([&]() {
+    for (int f = 0; f < FRAGMENTS_PER_REPLY; f++)
+      writer << FRAGMENT;
+    writer.Commit();
+  });
+  int replies = 0;
+  double perAppend = Measure([&]() {
+    for (int f = 0; f < FRAGMENTS_PER_REPLY; f++)
+      writer << FRAGMENT;
+    if (0 == ++replies % 64)
+      writer.Commit();
+  });
+  writer.Commit();
+  // the fragment copies alone, the floor for any of the above
+  char target[FRAGMENT.size() * FRAGMENTS_PER_REPLY];
+  double perCopy = Measure([&]() {
+    for (int f = 0; f < FRAGMENTS_PER_REPLY; f++)
+      std::memcpy(target + f * FRAGMENT.size(), FRAGMENT.data(),
+                  FRAGMENT.size());
+    asm volatile("" : : "r"(target) : "memory");
+  });
+
+  draining = false;
+  drain.join();
+  client.reset();
+  server->Stop();
+
+  printf("%d replies of %d x %zu B fragments, ns per fragment:\n", REPLIES,
+         FRAGMENTS_PER_REPLY, FRAGMENT.size());
+  printf("SendToClient per fragment: %8.1f\n", perSend);
+  printf("GetWriter per reply:       %8.1f\n", perLookup);
+  printf("one writer, Commit:        %8.1f\n", perWriter);
+  printf("Commit every 64 replies:   %8.1f\n", perAppend);
+  printf("memcpy only:               %8.1f\n", perCopy);
+  return 0;
+}
+
+} // namespace FtBench
@@ -0,0 +1,161 @@
+#include "ft-socket/ft_announcement.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+namespace FtTCP {
+
+namespace {
+
+constexpr uint8_t MAGIC[] = {'F', 'T', 'A', 'N'};
+constexpr std::size_t FORMAT_OFFSET{4};
+constexpr std::size_t HEADER_SIZE_OFFSET{5};
+constexpr std::size_t PORT_OFFSET{6};
+constexpr std::size_t CONNECTIONS_OFFSET{8};
+constexpr std::size_t MAX_CONNECTIONS_OFFSET{10};
+constexpr std::size_t LOAD_OFFSET{12};
+constexpr std::size_t VERSION_LENGTH_OFFSET{14};
+constexpr unsigned FULL_SCORE{1000};
+
+uint16_t ReadU16(const uint8_t* data)
+{
+  return static_cast<uint16_t>((data[0] << 8) | data[1]);
+}
+
+} // namespace
+
+unsigned Announcement::Score() const
+{
+  unsigned occupancy =
+    maxConnections ? connections * FULL_SCORE / maxConnections : 0;
+  return std::min(FULL_SCORE, std::max<unsigned>(occupancy, load));
+}
+
+bool Announcement::IsFull() const
+{
+  return maxConnections && connections >= maxConnections;
+}
+
+AnnouncementPacket::AnnouncementPacket(const std::string& appVersion,
+                                       uint16_t port, uint16_t maxConnections)
+{
+  std::size_t versionLength = std::min(appVersion.size(), MAX_APP_VERSION);
+  m_data.assign(HEADER_SIZE + versionLength, 0);
+  std::memcpy(m_data.data(), MAGIC, sizeof(MAGIC));
+  m_data[FORMAT_OFFSET] = FORMAT;
+  m_data[HEADER_SIZE_OFFSET] = HEADER_SIZE;
+  Patch(PORT_OFFSET, port);
+  Patch(MAX_CONNECTIONS_OFFSET, maxConnections);
+  m_data[VERSION_LENGTH_OFFSET] = static_cast<uint8_t>(versionLength);
+  std::memcpy(&m_data[HEADER_SIZE], appVersion.data(), versionLength);
+}
+
+void AnnouncementPacket::Patch(std::size_t offset, uint16_t value)
+{
+  m_data[offset] = static_cast<uint8_t>(value >> 8);
+  m_data[offset + 1] = static_cast<uint8_t>(value);
+}
+
+void AnnouncementPacket::SetConnections(uint16_t connections)
+{
+  Patch(CONNECTIONS_OFFSET, connections);
+}
+
+void AnnouncementPacket::SetLoad(uint16_t load)
+{
+  Patch(LOAD_OFFSET, load);
+}
+
+const void* AnnouncementPacket::Data() const
+{
+  return m_data.data();
+}
+
+std::size_t AnnouncementPacket::Size() const
+{
+  return m_data.size();
+}
+
+bool AnnouncementPacket::Parse(const void* data, std::size_t size,
+                               Announcement* announcement)
+{
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  if (nullptr == announcement || size < HEADER_SIZE ||
+      0 != std::memcmp(bytes, MAGIC, sizeof(MAGIC)) ||
+      bytes[FORMAT_OFFSET] < FORMAT)
+    return false;
+  std::size_t headerSize = bytes[HEADER_SIZE_OFFSET];
+  std::size_t versionLength = bytes[VERSION_LENGTH_OFFSET];
+  if (headerSize < HEADER_SIZE || headerSize + versionLength > size)
+    return false;
+  announcement->port = ReadU16(bytes + PORT_OFFSET);
+  announcement->connections = ReadU16(bytes + CONNECTIONS_OFFSET);
+  announcement->maxConnections = ReadU16(bytes + MAX_CONNECTIONS_OFFSET);
+  announcement->load = ReadU16(bytes + LOAD_OFFSET);
+  announcement->appVersion.assign(
+    reinterpret_cast<const char*>(bytes + headerSize), versionLength);
+  return true;
+}
+
+AnnouncementTable::AnnouncementTable(std::chrono::seconds maxAge)
+  : m_maxAge(maxAge)
+{
+}
+
+bool AnnouncementTable::Add(const std::string& host, const void* data,
+                            std::size_t size)
+{
+  Announcement announcement;
+  if (!AnnouncementPacket::Parse(data, size, &announcement))
+    return false;
+  announcement.host = host;
+  announcement.received = std::chrono::steady_clock::now();
+  std::string key = host + ":" + std::to_string(announcement.port);
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_servers[key] = std::move(announcement);
+  return true;
+}
+
+std::vector<Announcement> AnnouncementTable::GetServers()
+{
+  auto oldest = std::chrono::steady_clock::now() - m_maxAge;
+  std::vector<Announcement> servers;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto it = m_servers.begin(); it != m_servers.end();) {
+      if (it->second.received < oldest) {
+        it = m_servers.erase(it);
+        continue;
+      }
+      servers.push_back(it->second);
+      ++it;
+    }
+  }
+  std::sort(servers.begin(), servers.end(),
+            [](const Announcement& a, const Announcement& b) {
+              return a.Score() < b.Score();
+            });
+  return servers;
+}
+
+bool AnnouncementTable::PickLeastLoaded(Announcement* announcement)
+{
+  std::vector<Announcement> servers = GetServers();
+  servers.erase(std::remove_if(servers.begin(), servers.end(),
+                               [](const Announcement& server) {
+                                 return server.IsFull();
+                               }),
+                servers.end());
+  if (servers.empty() || nullptr == announcement)
+    return false;
+  std::size_t ties = 1;
+  while (ties < servers.size() &&
+         servers[ties].Score() == servers.front().Score())
+    ties++;
+  thread_local std::minstd_rand random{std::random_device{}()};
+  *announcement = servers[random() % ties];
+  return true;
+}
+
+} // namespace FtTCP
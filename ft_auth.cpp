@@ -0,0 +1,28 @@
+#include "ft-socket/ft_auth.hpp"
+
+#include <cstdint>
+
+namespace FtTCP {
+
+AuthResult MakeAuthResult(bool accepted)
+{
+  std::promise<bool> promise;
+  promise.set_value(accepted);
+  return promise.get_future();
+}
+
+bool ConstantTimeEquals(const void* secret, std::size_t secretSize,
+                        const void* candidate, std::size_t candidateSize)
+{
+  const auto* expected = static_cast<const uint8_t*>(secret);
+  const auto* actual = static_cast<const uint8_t*>(candidate);
+  // volatile keeps the compiler from turning the loop into an early exit
+  volatile uint8_t diff = (secretSize == candidateSize) ? 0 : 1;
+  for (std::size_t i = 0; i < candidateSize; i++) {
+    uint8_t expectedByte = (i < secretSize) ? expected[i] : 0;
+    diff = diff | (expectedByte ^ actual[i]);
+  }
+  return 0 == diff;
+}
+
+} // namespace FtTCP
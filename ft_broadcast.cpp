@@ -4,8 +4,10 @@
 
 namespace FtTCP {
 
-Broadcast::Broadcast(const std::string& app_version) 
-  : m_interfaceIP(""), m_connected(false), m_appVersion(app_version) {}
+Broadcast::Broadcast(const std::string& app_version, uint16_t servicePort,
+                     uint16_t maxConnections)
+  : m_interfaceIP(""), m_connected(false),
+    m_packet(app_version, servicePort, maxConnections) {}
 
 bool Broadcast::Start()
 {
@@ -23,7 +25,26 @@ void Broadcast::Stop()
 bool Broadcast::Renew(bool connected, std::string interface_ip)
 {
   std::lock_guard<std::mutex> lock(m_updateMutex);
-  if (connected)
+  if (connected && m_isMulticast)
+  {
+    FtTCP::AddressPtr addr = FtTCP::Address::CreateMulticastAddress(
+      m_multicast.group.c_str(), m_port);
+    if (!addr->IsValid())
+    {
+      return false;
+    }
+    SocketPtr sock = Socket::CreateSocket(addr);
+    if (!sock->SetMulticastTtl(m_multicast.ttl) ||
+        !sock->SetMulticastLoopback(m_multicast.loopback) ||
+        (!interface_ip.empty() && !sock->SetMulticastInterface(interface_ip)))
+    {
+      ESP_LOGW("Broadcast", "multicast setup failed: %s",
+               sock->ErrorsToStr().c_str());
+      return false;
+    }
+    m_socket = sock;
+  }
+  else if (connected)
   {
     FtTCP::AddressPtr addr = FtTCP::Address::CreateBroadcastAddress(interface_ip.c_str(), m_port);
     if (!addr->IsValid())
@@ -38,18 +59,42 @@ bool Broadcast::Renew(bool connected, std::string interface_ip)
   return true;
 }
 
+void Broadcast::SetMulticast(const MulticastParameters& multicast)
+{
+  std::lock_guard<std::mutex> lock(m_updateMutex);
+  m_isMulticast = true;
+  m_multicast = multicast;
+}
+
+void Broadcast::UpdateLoad(uint16_t connections, uint16_t load)
+{
+  std::lock_guard<std::mutex> lock(m_updateMutex);
+  if (connections == m_connections && load == m_load)
+    return;
+  m_connections = connections;
+  m_load = load;
+  m_packet.SetConnections(connections);
+  m_packet.SetLoad(load);
+  m_attemp = 0;
+}
+
 void Broadcast::Run()
 {
   auto start = std::chrono::steady_clock::now();
   ESP_LOGI("Broadcast", "Started");
   while (!m_shutdown) {
-    if (m_connected && m_attemp < m_maxAttempCount) {
+    if (m_connected) {
       auto end = std::chrono::steady_clock::now();
       std::chrono::seconds elapsed =
         std::chrono::duration_cast<std::chrono::seconds>(end - start);
-      if (elapsed >= m_attempTimeout) {
+      // a burst of attempts on every change, then a slower heartbeat
+      std::chrono::seconds timeout = m_attemp < m_maxAttempCount
+                                       ? m_attempTimeout
+                                       : m_heartbeatTimeout;
+      if (elapsed >= timeout) {
         if (SendBroadcastPacket()) {
-          m_attemp++;
+          if (m_attemp < m_maxAttempCount)
+            m_attemp++;
           start = end;
         }
       }
@@ -63,13 +108,15 @@ void Broadcast::Run()
 
 bool Broadcast::SendBroadcastPacket()
 {
-  return m_socket->SendDatagram(
-    static_cast<const void*>(m_appVersion.c_str()), m_appVersion.length());
+  std::lock_guard<std::mutex> lock(m_updateMutex);
+  return m_socket->SendDatagram(m_packet.Data(), m_packet.Size());
 }
 
-BroadcastPtr Broadcast::CreateBroadcast(const std::string& appVersion)
+BroadcastPtr Broadcast::CreateBroadcast(const std::string& appVersion,
+                                        uint16_t servicePort,
+                                        uint16_t maxConnections)
 {
-  return std::make_shared<Broadcast>(appVersion);
+  return std::make_shared<Broadcast>(appVersion, servicePort, maxConnections);
 }
 
 } // namespace FtTCP
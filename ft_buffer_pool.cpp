@@ -0,0 +1,241 @@
+#include "ft-socket/ft_buffer_pool.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+namespace FtTCP {
+
+std::string BufferPoolStats::ToString() const
+{
+  char buf[256];
+  std::snprintf(buf, sizeof(buf) - 1,
+                "pool: acquired=%llu released=%llu thread-cache=%llu "
+                "shared=%llu malloc=%llu free=%llu in-use=%lluB "
+                "cached=%lluB",
+                static_cast<unsigned long long>(acquired),
+                static_cast<unsigned long long>(released),
+                static_cast<unsigned long long>(threadCacheHits),
+                static_cast<unsigned long long>(sharedHits),
+                static_cast<unsigned long long>(systemAllocations),
+                static_cast<unsigned long long>(systemFrees),
+                static_cast<unsigned long long>(bytesInUse),
+                static_cast<unsigned long long>(bytesCached));
+  return std::string(buf);
+}
+
+BufferPool::ThreadCache::~ThreadCache()
+{
+  // client threads come and go, keep their blocks for the next ones
+  BufferPool& pool = BufferPool::Instance();
+  for (uint8_t sizeClass = 0; sizeClass < CLASS_COUNT; sizeClass++) {
+    for (std::byte* block : blocks[sizeClass]) {
+      pool.m_bytesCached.fetch_sub(CLASS_SIZES[sizeClass],
+                                   std::memory_order_relaxed);
+      pool.ReleaseShared(sizeClass, block);
+    }
+  }
+}
+
+BufferPool& BufferPool::Instance()
+{
+  // never destroyed, thread caches may flush into it during exit
+  static BufferPool* pool = new BufferPool();
+  return *pool;
+}
+
+BufferPool::ThreadCache& BufferPool::GetThreadCache()
+{
+  static thread_local ThreadCache cache;
+  return cache;
+}
+
+uint8_t BufferPool::SizeClass(std::size_t size)
+{
+  for (uint8_t sizeClass = 0; sizeClass < CLASS_COUNT; sizeClass++) {
+    if (size <= CLASS_SIZES[sizeClass])
+      return sizeClass;
+  }
+  return NO_CLASS;
+}
+
+std::byte* BufferPool::Acquire(std::size_t size, uint8_t* sizeClass,
+                               std::size_t* capacity)
+{
+  m_acquired.fetch_add(1, std::memory_order_relaxed);
+  *sizeClass = SizeClass(size);
+  *capacity = (NO_CLASS == *sizeClass) ? size : CLASS_SIZES[*sizeClass];
+  m_bytesInUse.fetch_add(*capacity, std::memory_order_relaxed);
+
+  if (NO_CLASS != *sizeClass) {
+    ThreadCache& cache = GetThreadCache();
+    auto& cached = cache.blocks[*sizeClass];
+    if (!cached.empty()) {
+      std::byte* block = cached.back();
+      cached.pop_back();
+      cache.bytes -= *capacity;
+      m_bytesCached.fetch_sub(*capacity, std::memory_order_relaxed);
+      m_threadCacheHits.fetch_add(1, std::memory_order_relaxed);
+      return block;
+    }
+    SharedList& shared = m_shared[*sizeClass];
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    if (!shared.blocks.empty()) {
+      std::byte* block = shared.blocks.back();
+      shared.blocks.pop_back();
+      m_bytesCached.fetch_sub(*capacity, std::memory_order_relaxed);
+      m_sharedHits.fetch_add(1, std::memory_order_relaxed);
+      return block;
+    }
+  }
+  m_systemAllocations.fetch_add(1, std::memory_order_relaxed);
+  return static_cast<std::byte*>(::operator new(*capacity));
+}
+
+void BufferPool::Release(std::byte* block, uint8_t sizeClass,
+                         std::size_t capacity)
+{
+  if (nullptr == block)
+    return;
+  m_released.fetch_add(1, std::memory_order_relaxed);
+  m_bytesInUse.fetch_sub(capacity, std::memory_order_relaxed);
+  if (NO_CLASS == sizeClass) {
+    m_systemFrees.fetch_add(1, std::memory_order_relaxed);
+    ::operator delete(block);
+    return;
+  }
+  ThreadCache& cache = GetThreadCache();
+  if (cache.bytes + capacity <= MAX_THREAD_CACHED_BYTES) {
+    cache.blocks[sizeClass].push_back(block);
+    cache.bytes += capacity;
+    m_bytesCached.fetch_add(capacity, std::memory_order_relaxed);
+    return;
+  }
+  ReleaseShared(sizeClass, block);
+}
+
+void BufferPool::ReleaseShared(uint8_t sizeClass, std::byte* block)
+{
+  {
+    SharedList& shared = m_shared[sizeClass];
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    std::size_t size = CLASS_SIZES[sizeClass];
+    if ((shared.blocks.size() + 1) * size <= MAX_SHARED_CACHED_BYTES) {
+      shared.blocks.push_back(block);
+      m_bytesCached.fetch_add(size, std::memory_order_relaxed);
+      return;
+    }
+  }
+  m_systemFrees.fetch_add(1, std::memory_order_relaxed);
+  ::operator delete(block);
+}
+
+BufferPoolStats BufferPool::GetStats() const
+{
+  BufferPoolStats stats;
+  stats.acquired = m_acquired.load(std::memory_order_relaxed);
+  stats.released = m_released.load(std::memory_order_relaxed);
+  stats.threadCacheHits = m_threadCacheHits.load(std::memory_order_relaxed);
+  stats.sharedHits = m_sharedHits.load(std::memory_order_relaxed);
+  stats.systemAllocations =
+    m_systemAllocations.load(std::memory_order_relaxed);
+  stats.systemFrees = m_systemFrees.load(std::memory_order_relaxed);
+  stats.bytesInUse = m_bytesInUse.load(std::memory_order_relaxed);
+  stats.bytesCached = m_bytesCached.load(std::memory_order_relaxed);
+  return stats;
+}
+
+PooledBuffer::PooledBuffer(std::size_t size)
+{
+  resize(size);
+}
+
+PooledBuffer::PooledBuffer(const std::byte* first, const std::byte* last)
+{
+  assign(first, last);
+}
+
+PooledBuffer::PooledBuffer(PooledBuffer&& other) noexcept
+  : m_data(other.m_data)
+  , m_size(other.m_size)
+  , m_capacity(other.m_capacity)
+  , m_sizeClass(other.m_sizeClass)
+{
+  other.m_data = nullptr;
+  other.m_size = 0;
+  other.m_capacity = 0;
+}
+
+PooledBuffer& PooledBuffer::operator=(PooledBuffer&& other) noexcept
+{
+  if (this != &other) {
+    Reset();
+    m_data = other.m_data;
+    m_size = other.m_size;
+    m_capacity = other.m_capacity;
+    m_sizeClass = other.m_sizeClass;
+    other.m_data = nullptr;
+    other.m_size = 0;
+    other.m_capacity = 0;
+  }
+  return *this;
+}
+
+PooledBuffer::~PooledBuffer()
+{
+  Reset();
+}
+
+void PooledBuffer::Reset()
+{
+  BufferPool::Instance().Release(m_data, m_sizeClass, m_capacity);
+  m_data = nullptr;
+  m_size = 0;
+  m_capacity = 0;
+}
+
+void PooledBuffer::reserve(std::size_t capacity)
+{
+  if (capacity <= m_capacity)
+    return;
+  uint8_t sizeClass;
+  std::size_t blockCapacity;
+  std::byte* block =
+    BufferPool::Instance().Acquire(capacity, &sizeClass, &blockCapacity);
+  std::size_t keep = m_size;
+  if (keep)
+    std::memcpy(block, m_data, keep);
+  Reset();
+  m_data = block;
+  m_size = keep;
+  m_capacity = blockCapacity;
+  m_sizeClass = sizeClass;
+}
+
+void PooledBuffer::resize(std::size_t size)
+{
+  reserve(size);
+  m_size = size;
+}
+
+std::size_t PooledBuffer::append(const void* source, std::size_t size)
+{
+  std::size_t taken = std::min(size, m_capacity - m_size);
+  if (taken) {
+    std::memcpy(m_data + m_size, source, taken);
+    m_size += taken;
+  }
+  return taken;
+}
+
+void PooledBuffer::assign(const std::byte* first, const std::byte* last)
+{
+  m_size = 0;
+  std::size_t size = static_cast<std::size_t>(last - first);
+  resize(size);
+  if (size)
+    std::memcpy(m_data, first, size);
+}
+
+} // namespace FtTCP
@@ -0,0 +1,81 @@
+#include "ft-socket/ft_buffer_sizing.hpp"
+
+#include <algorithm>
+
+namespace FtTCP {
+
+MemoryBudget::MemoryBudget(std::size_t limit) : m_limit(limit) {}
+
+void MemoryBudget::Add(std::size_t bytes)
+{
+  m_used.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void MemoryBudget::Remove(std::size_t bytes)
+{
+  m_used.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+bool MemoryBudget::HasRoom(std::size_t bytes) const
+{
+  return 0 == m_limit ||
+         m_used.load(std::memory_order_relaxed) + bytes <= m_limit;
+}
+
+std::size_t MemoryBudget::GetUsed() const
+{
+  return m_used.load(std::memory_order_relaxed);
+}
+
+std::size_t MemoryBudget::GetLimit() const
+{
+  return m_limit;
+}
+
+AdaptiveSize::AdaptiveSize(std::size_t min, std::size_t max,
+                           std::chrono::milliseconds shrinkAfter)
+  : m_size(std::max<std::size_t>(min, 1)), m_min(m_size),
+    m_max(std::max(max, m_size)), m_shrinkAfter(shrinkAfter),
+    m_lastBusy(Clock::now())
+{
+}
+
+std::size_t AdaptiveSize::Get() const
+{
+  return m_size;
+}
+
+void AdaptiveSize::OnRead(std::size_t bytes, std::size_t room,
+                          const MemoryBudget* budget)
+{
+  if (budget && !budget->HasRoom(0)) {
+    m_size = m_min;
+    return;
+  }
+  if (bytes >= room) {
+    // more is likely waiting in the kernel, take it with fewer syscalls
+    std::size_t grown = std::min(m_size * 2, m_max);
+    if (grown > m_size && (!budget || budget->HasRoom(grown - m_size)))
+      m_size = grown;
+    m_lastBusy = Clock::now();
+    return;
+  }
+  if (bytes * 2 >= m_size) {
+    m_lastBusy = Clock::now();
+    return;
+  }
+  OnIdle();
+}
+
+void AdaptiveSize::OnIdle()
+{
+  if (m_size == m_min)
+    return;
+  auto now = Clock::now();
+  if (now - m_lastBusy < m_shrinkAfter)
+    return;
+  m_size = std::max(m_size / 2, m_min);
+  m_lastBusy = now;
+}
+
+} // namespace FtTCP
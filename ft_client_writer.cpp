@@ -0,0 +1,62 @@
+#include "ft-socket/ft_client_writer.hpp"
+
+#include <algorithm>
+
+namespace FtTCP {
+
+ClientWriter::ClientWriter(std::shared_ptr<SocketSendQueue> queue,
+                           const std::string* prompt)
+  : m_queue(std::move(queue)), m_prompt(prompt)
+{
+}
+
+bool ClientWriter::IsValid() const
+{
+  return nullptr != m_queue;
+}
+
+ClientWriter& ClientWriter::Append(const void* data, std::size_t size)
+{
+  if (m_buffer.capacity() - m_buffer.size() < size)
+    m_buffer.reserve(std::max({INITIAL_CAPACITY, m_buffer.size() + size,
+                               m_buffer.capacity() * 2}));
+  m_buffer.append(data, size);
+  return *this;
+}
+
+ClientWriter& ClientWriter::Append(std::string_view fragment)
+{
+  return Append(fragment.data(), fragment.size());
+}
+
+ClientWriter& ClientWriter::operator<<(std::string_view fragment)
+{
+  return Append(fragment.data(), fragment.size());
+}
+
+ClientWriter& ClientWriter::AppendPrompt()
+{
+  if (m_prompt)
+    Append(m_prompt->data(), m_prompt->size());
+  return *this;
+}
+
+std::size_t ClientWriter::Size() const
+{
+  return m_buffer.size();
+}
+
+bool ClientWriter::Commit()
+{
+  if (!m_queue)
+    return false;
+  if (m_buffer.empty())
+    return true;
+  // the block moves into the queue, the next Append() takes a fresh one
+  // from the pool
+  m_queue->Push(std::move(m_buffer));
+  m_buffer = Buffer();
+  return true;
+}
+
+} // namespace FtTCP
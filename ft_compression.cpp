@@ -0,0 +1,130 @@
+#include "ft-socket/ft_compression.hpp"
+
+#include "esp_log.h"
+
+#include <algorithm>
+
+#ifdef FT_SOCKET_COMPRESSION
+#include <zlib.h>
+#endif
+
+namespace FtTCP {
+
+static constexpr char TAG[] = "DEFLATE";
+
+#ifdef FT_SOCKET_COMPRESSION
+
+static constexpr std::size_t OUTPUT_CHUNK{4096};
+
+struct Deflater::Stream {
+  z_stream zs{};
+  bool valid{false};
+
+  ~Stream()
+  {
+    if (valid)
+      deflateEnd(&zs);
+  }
+};
+
+Deflater::Deflater(const CompressionParameters& params)
+  : m_stream(std::make_unique<Stream>())
+{
+  int level = std::clamp(params.level, 0, 9);
+  int windowBits = std::clamp(params.windowBits, 9, 15);
+  int memLevel = std::clamp(params.memLevel, 1, 9);
+  // a zlib stream, as MCCP2 clients expect
+  m_stream->valid = Z_OK == deflateInit2(&m_stream->zs, level, Z_DEFLATED,
+                                         windowBits, memLevel,
+                                         Z_DEFAULT_STRATEGY);
+  if (!m_stream->valid)
+    ESP_LOGE(TAG, "deflateInit2 failed");
+}
+
+std::string_view Deflater::Compress(const void* data, std::size_t size,
+                                    bool flush)
+{
+  m_output.clear();
+  if (!m_stream->valid || (0 == size && !(flush && m_unflushed)))
+    return {};
+  z_stream& zs = m_stream->zs;
+  zs.next_in = static_cast<Bytef*>(const_cast<void*>(data));
+  zs.avail_in = static_cast<uInt>(size);
+  int mode = flush ? Z_SYNC_FLUSH : Z_NO_FLUSH;
+  // deflate fills the output, more room until it keeps some spare
+  do {
+    std::size_t used = m_output.size();
+    m_output.resize(used + OUTPUT_CHUNK);
+    zs.next_out = reinterpret_cast<Bytef*>(&m_output[used]);
+    zs.avail_out = static_cast<uInt>(OUTPUT_CHUNK);
+    deflate(&zs, mode);
+    m_output.resize(used + OUTPUT_CHUNK - zs.avail_out);
+  } while (0 == zs.avail_out);
+  m_bytesIn += size;
+  m_bytesOut += m_output.size();
+  m_unflushed = !flush && size > 0;
+  return m_output;
+}
+
+bool Deflater::IsAvailable()
+{
+  return true;
+}
+
+#else // FT_SOCKET_COMPRESSION
+
+struct Deflater::Stream {
+};
+
+Deflater::Deflater(const CompressionParameters&)
+{
+  ESP_LOGE(TAG, "built without zlib");
+}
+
+std::string_view Deflater::Compress(const void*, std::size_t, bool)
+{
+  return {};
+}
+
+bool Deflater::IsAvailable()
+{
+  return false;
+}
+
+#endif // FT_SOCKET_COMPRESSION
+
+Deflater::~Deflater() = default;
+
+bool Deflater::IsValid() const
+{
+#ifdef FT_SOCKET_COMPRESSION
+  return m_stream && m_stream->valid;
+#else
+  return false;
+#endif
+}
+
+bool Deflater::HasUnflushed() const
+{
+  return m_unflushed;
+}
+
+uint64_t Deflater::BytesIn() const
+{
+  return m_bytesIn;
+}
+
+uint64_t Deflater::BytesOut() const
+{
+  return m_bytesOut;
+}
+
+std::size_t Deflater::MemoryFor(const CompressionParameters& params)
+{
+  int windowBits = std::clamp(params.windowBits, 9, 15);
+  int memLevel = std::clamp(params.memLevel, 1, 9);
+  return (std::size_t(1) << (windowBits + 2)) +
+         (std::size_t(1) << (memLevel + 9));
+}
+
+} // namespace FtTCP
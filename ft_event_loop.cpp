@@ -0,0 +1,154 @@
+#include "ft-socket/ft_event_loop.hpp"
+
+#include "esp_log.h"
+
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace FtTCP {
+
+static constexpr char TAG[] = "LOOP";
+static constexpr std::chrono::milliseconds IDLE_WAIT{100};
+
+EventLoop::EventLoop()
+{
+  m_epoll = epoll_create1(EPOLL_CLOEXEC);
+  m_wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (m_epoll < 0 || m_wakeup < 0) {
+    ESP_LOGE(TAG, "can't create the loop %d", errno);
+    return;
+  }
+  epoll_event event{};
+  event.events = EPOLLIN;
+  event.data.fd = m_wakeup;
+  epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeup, &event);
+}
+
+EventLoop::~EventLoop()
+{
+  if (m_wakeup >= 0)
+    close(m_wakeup);
+  if (m_epoll >= 0)
+    close(m_epoll);
+}
+
+bool EventLoop::IsValid() const
+{
+  return m_epoll >= 0 && m_wakeup >= 0;
+}
+
+bool EventLoop::Add(int fd, uint32_t events, EventCallback callback)
+{
+  epoll_event event{};
+  event.events = events;
+  event.data.fd = fd;
+  if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &event)) {
+    ESP_LOGE(TAG, "can't watch %d: %d", fd, errno);
+    return false;
+  }
+  m_callbacks[fd] = std::move(callback);
+  return true;
+}
+
+bool EventLoop::Modify(int fd, uint32_t events)
+{
+  epoll_event event{};
+  event.events = events;
+  event.data.fd = fd;
+  return 0 == epoll_ctl(m_epoll, EPOLL_CTL_MOD, fd, &event);
+}
+
+void EventLoop::Remove(int fd)
+{
+  epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, nullptr);
+  m_callbacks.erase(fd);
+}
+
+TimerId EventLoop::AddTimer(std::chrono::milliseconds delay,
+                            TimerCallback callback)
+{
+  TimerId id = ++m_timerCounter;
+  auto timer =
+    m_timers.emplace(Clock::now() + delay, Timer{id, std::move(callback)});
+  m_timerIndex[id] = timer;
+  return id;
+}
+
+void EventLoop::CancelTimer(TimerId id)
+{
+  auto index = m_timerIndex.find(id);
+  if (index == m_timerIndex.end())
+    return;
+  m_timers.erase(index->second);
+  m_timerIndex.erase(index);
+}
+
+int EventLoop::NextTimeout(std::chrono::milliseconds maxWait) const
+{
+  if (m_timers.empty())
+    return static_cast<int>(maxWait.count());
+  auto untilTimer = std::chrono::ceil<std::chrono::milliseconds>(
+    m_timers.begin()->first - Clock::now());
+  return static_cast<int>(
+    std::max<long>(0, std::min(untilTimer.count(), long(maxWait.count()))));
+}
+
+void EventLoop::RunTimers()
+{
+  auto now = Clock::now();
+  while (!m_timers.empty() && m_timers.begin()->first <= now) {
+    Timer timer = std::move(m_timers.begin()->second);
+    m_timerIndex.erase(timer.id);
+    m_timers.erase(m_timers.begin());
+    timer.callback();
+  }
+}
+
+bool EventLoop::RunOnce(std::chrono::milliseconds maxWait)
+{
+  if (m_stopping)
+    return false;
+  epoll_event events[MAX_EVENTS];
+  int count = epoll_wait(m_epoll, events, MAX_EVENTS, NextTimeout(maxWait));
+  if (count < 0 && EINTR != errno) {
+    ESP_LOGE(TAG, "epoll_wait %d", errno);
+    return false;
+  }
+  for (int i = 0; i < count; i++) {
+    int fd = events[i].data.fd;
+    if (fd == m_wakeup)
+      continue;
+    // a callback may remove itself or others, look each one up again and
+    // call a copy, small captures don't allocate
+    auto registered = m_callbacks.find(fd);
+    if (registered == m_callbacks.end())
+      continue;
+    EventCallback callback = registered->second;
+    callback(events[i].events);
+  }
+  RunTimers();
+  return !m_stopping;
+}
+
+void EventLoop::Run()
+{
+  while (RunOnce(IDLE_WAIT)) {
+  }
+}
+
+void EventLoop::Stop()
+{
+  m_stopping = true;
+  uint64_t one = 1;
+  ssize_t written = write(m_wakeup, &one, sizeof(one));
+  (void)written;
+}
+
+EventLoopPtr EventLoop::CreateEventLoop()
+{
+  return std::make_shared<EventLoop>();
+}
+
+} // namespace FtTCP
@@ -0,0 +1,142 @@
+#include "ft-socket/ft_fd_passing.hpp"
+
+#include "esp_log.h"
+
+#include <cstring>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+namespace FtTCP {
+
+static constexpr char TAG[] = "HANDOFF";
+static constexpr std::chrono::milliseconds CONNECT_RETRY{10};
+
+static bool FillUnixAddress(const std::string& path, sockaddr_un* address)
+{
+  memset(address, 0, sizeof(*address));
+  address->sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof(address->sun_path))
+    return false;
+  memcpy(address->sun_path, path.c_str(), path.size());
+  return true;
+}
+
+static bool WaitReadable(int fd, std::chrono::milliseconds timeout)
+{
+  pollfd descriptor{fd, POLLIN, 0};
+  return poll(&descriptor, 1, static_cast<int>(timeout.count())) > 0;
+}
+
+DescriptorChannel::~DescriptorChannel()
+{
+  if (m_channel != -1)
+    close(m_channel);
+  if (m_ownsPath)
+    unlink(m_path.c_str());
+}
+
+bool DescriptorChannel::Accept(const std::string& path,
+                               std::chrono::milliseconds timeout)
+{
+  sockaddr_un address;
+  if (!FillUnixAddress(path, &address))
+    return false;
+  int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listener == -1)
+    return false;
+  unlink(path.c_str());
+  if (bind(listener, (sockaddr*)&address, sizeof(address)) ||
+      listen(listener, 1)) {
+    ESP_LOGE(TAG, "can't listen on %s: %d", path.c_str(), errno);
+    close(listener);
+    return false;
+  }
+  m_path = path;
+  m_ownsPath = true;
+  if (WaitReadable(listener, timeout))
+    m_channel = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+  close(listener);
+  return m_channel != -1;
+}
+
+bool DescriptorChannel::Connect(const std::string& path,
+                                std::chrono::milliseconds timeout)
+{
+  sockaddr_un address;
+  if (!FillUnixAddress(path, &address))
+    return false;
+  auto deadline = std::chrono::steady_clock::now() + timeout;
+  do {
+    m_channel = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_channel == -1)
+      return false;
+    if (0 == connect(m_channel, (sockaddr*)&address, sizeof(address)))
+      return true;
+    close(m_channel);
+    m_channel = -1;
+    std::this_thread::sleep_for(CONNECT_RETRY);
+  } while (std::chrono::steady_clock::now() < deadline);
+  ESP_LOGE(TAG, "can't connect to %s", path.c_str());
+  return false;
+}
+
+bool DescriptorChannel::Send(int fd, const void* data, size_t size)
+{
+  iovec vector{const_cast<void*>(data), size};
+  msghdr message{};
+  message.msg_iov = &vector;
+  message.msg_iovlen = 1;
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {0};
+  if (fd != -1) {
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(header), &fd, sizeof(int));
+  }
+  return sendmsg(m_channel, &message, MSG_NOSIGNAL) ==
+         static_cast<ssize_t>(size);
+}
+
+bool DescriptorChannel::Receive(int* fd, void* data, size_t size,
+                                std::chrono::milliseconds timeout)
+{
+  *fd = -1;
+  if (!WaitReadable(m_channel, timeout))
+    return false;
+  iovec vector{data, size};
+  msghdr message{};
+  message.msg_iov = &vector;
+  message.msg_iovlen = 1;
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+  // records are small, a stream socket delivers each one whole
+  ssize_t received =
+    recvmsg(m_channel, &message, MSG_WAITALL | MSG_CMSG_CLOEXEC);
+  // a descriptor arrives with the first byte of its record, even when the
+  // read comes up short
+  int passed = -1;
+  if (received > 0) {
+    for (cmsghdr* header = CMSG_FIRSTHDR(&message); header;
+         header = CMSG_NXTHDR(&message, header)) {
+      if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS)
+        memcpy(&passed, CMSG_DATA(header), sizeof(int));
+    }
+  }
+  if (received != static_cast<ssize_t>(size)) {
+    if (passed != -1)
+      close(passed);
+    return false;
+  }
+  *fd = passed;
+  return true;
+}
+
+} // namespace FtTCP
@@ -0,0 +1,114 @@
+#include "ft-socket/ft_framing.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace FtTCP {
+
+FrameReader::FrameReader(FrameFormat format, std::size_t maxFrame)
+  : m_format(format), m_maxFrame(std::min<std::size_t>(maxFrame, UINT32_MAX))
+{
+}
+
+bool FrameReader::ParseHeader(const std::byte* data, std::size_t size,
+                              uint64_t* payload, std::size_t* header) const
+{
+  if (FrameFixed32 == m_format) {
+    if (size < 4)
+      return false;
+    *payload = (uint64_t(data[0]) << 24) | (uint64_t(data[1]) << 16) |
+               (uint64_t(data[2]) << 8) | uint64_t(data[3]);
+    *header = 4;
+    return true;
+  }
+  uint64_t value = 0;
+  for (std::size_t i = 0; i < std::min(size, MAX_HEADER); i++) {
+    uint8_t byte = static_cast<uint8_t>(data[i]);
+    value |= uint64_t(byte & 0x7F) << (7 * i);
+    if (0 == (byte & 0x80)) {
+      *payload = value;
+      *header = i + 1;
+      return true;
+    }
+  }
+  // MAX_HEADER bytes without an end reports a length above 32 bits
+  *payload = (size >= MAX_HEADER) ? UINT64_MAX : 0;
+  *header = 0;
+  return size >= MAX_HEADER;
+}
+
+std::byte* FrameReader::Prepare(std::size_t* room)
+{
+  std::size_t used = m_buffer.size() - m_begin;
+  if (m_begin) {
+    if (used)
+      std::memmove(m_buffer.data(), m_buffer.data() + m_begin, used);
+    m_buffer.resize(used);
+    m_begin = 0;
+  }
+  // the pool rounds up to its next class, don't give that back each time
+  if (0 == used && 0 == m_pending && m_buffer.capacity() > 2 * m_receiveChunk)
+    m_buffer = PooledBuffer();
+  m_buffer.reserve(std::max(m_pending, used + m_receiveChunk));
+  *room = m_buffer.capacity() - used;
+  return m_buffer.data() + used;
+}
+
+void FrameReader::SetReceiveChunk(std::size_t chunk)
+{
+  m_receiveChunk = std::max<std::size_t>(chunk, 1);
+}
+
+std::size_t FrameReader::GetCapacity() const
+{
+  return m_buffer.capacity();
+}
+
+void FrameReader::Commit(std::size_t received)
+{
+  m_buffer.resize(m_buffer.size() + received);
+}
+
+FrameReader::Status FrameReader::Next(std::string_view* frame)
+{
+  const std::byte* data = m_buffer.data() + m_begin;
+  std::size_t available = m_buffer.size() - m_begin;
+  uint64_t payload = 0;
+  std::size_t header = 0;
+  if (!ParseHeader(data, available, &payload, &header))
+    return NeedMore;
+  if (0 == header)
+    return Malformed;
+  if (payload > m_maxFrame)
+    return Oversized;
+  if (available < header + payload) {
+    m_pending = header + payload;
+    return NeedMore;
+  }
+  *frame = std::string_view(reinterpret_cast<const char*>(data + header),
+                            static_cast<std::size_t>(payload));
+  m_begin += header + payload;
+  m_pending = 0;
+  return FrameReady;
+}
+
+std::size_t FrameReader::EncodeHeader(FrameFormat format, uint32_t size,
+                                      std::byte* header)
+{
+  if (FrameFixed32 == format) {
+    header[0] = std::byte(size >> 24);
+    header[1] = std::byte(size >> 16);
+    header[2] = std::byte(size >> 8);
+    header[3] = std::byte(size);
+    return 4;
+  }
+  std::size_t length = 0;
+  do {
+    uint8_t byte = size & 0x7F;
+    size >>= 7;
+    header[length++] = std::byte(size ? (byte | 0x80) : byte);
+  } while (size);
+  return length;
+}
+
+} // namespace FtTCP
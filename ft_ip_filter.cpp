@@ -0,0 +1,166 @@
+#include "ft-socket/ft_ip_filter.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cstdlib>
+
+namespace FtTCP {
+
+bool ParseCidr(const std::string& text, Cidr* cidr)
+{
+  std::string address = text;
+  long length = 32;
+  size_t slash = text.find('/');
+  if (slash != std::string::npos) {
+    address = text.substr(0, slash);
+    const char* bits = text.c_str() + slash + 1;
+    char* end = nullptr;
+    length = std::strtol(bits, &end, 10);
+    if (end == bits || *end || length < 0 || length > 32)
+      return false;
+  }
+  in_addr parsed;
+  if (1 != inet_pton(AF_INET, address.c_str(), &parsed))
+    return false;
+  uint32_t mask = length ? ~uint32_t(0) << (32 - length) : 0;
+  cidr->prefix = ntohl(parsed.s_addr) & mask;
+  cidr->length = static_cast<uint8_t>(length);
+  return true;
+}
+
+std::string Ipv4ToString(uint32_t ip)
+{
+  in_addr address{htonl(ip)};
+  char text[INET_ADDRSTRLEN] = {};
+  inet_ntop(AF_INET, &address, text, sizeof(text));
+  return text;
+}
+
+CidrTable::CidrTable(bool allowByDefault) : m_allowByDefault(allowByDefault)
+{
+}
+
+uint32_t CidrTable::Mask(uint8_t length)
+{
+  return length ? ~uint32_t(0) << (32 - length) : 0;
+}
+
+void CidrTable::Add(const Cidr& cidr, bool allow)
+{
+  auto& rules = m_rules[cidr.length];
+  auto [it, added] = rules.emplace(cidr.prefix & Mask(cidr.length), allow);
+  if (!added)
+    it->second = it->second || allow;
+  else
+    m_size++;
+  m_lengths |= uint64_t(1) << cidr.length;
+  m_built = false;
+}
+
+bool CidrTable::Add(const std::string& cidr, bool allow)
+{
+  Cidr parsed;
+  if (!ParseCidr(cidr, &parsed))
+    return false;
+  Add(parsed, allow);
+  return true;
+}
+
+void CidrTable::Build()
+{
+  // the answer can only change where a rule's range starts or ends
+  std::vector<uint64_t> bounds{0};
+  bounds.reserve(m_size * 2 + 1);
+  for (std::size_t length = 0; length < m_rules.size(); length++) {
+    uint64_t span = uint64_t(1) << (32 - length);
+    for (const auto& rule : m_rules[length]) {
+      bounds.push_back(rule.first);
+      bounds.push_back(rule.first + span);
+    }
+  }
+  std::sort(bounds.begin(), bounds.end());
+  bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+  m_starts.clear();
+  m_allowed.clear();
+  for (uint64_t bound : bounds) {
+    if (bound > UINT32_MAX)
+      break;
+    bool allowed = Probe(static_cast<uint32_t>(bound));
+    // neighbours with the same answer are one range
+    if (!m_allowed.empty() && m_allowed.back() == allowed)
+      continue;
+    m_starts.push_back(static_cast<uint32_t>(bound));
+    m_allowed.push_back(allowed);
+  }
+  m_built = true;
+}
+
+bool CidrTable::IsAllowed(uint32_t ip) const
+{
+  if (!m_built)
+    return Probe(ip);
+  // the last range starting at or below ip, the first one starts at 0
+  auto it = std::upper_bound(m_starts.begin(), m_starts.end(), ip);
+  return m_allowed[it - m_starts.begin() - 1];
+}
+
+bool CidrTable::Probe(uint32_t ip) const
+{
+  for (uint64_t lengths = m_lengths; lengths;) {
+    // the longest length left
+    int length = 63 - __builtin_clzll(lengths);
+    lengths &= ~(uint64_t(1) << length);
+    const auto& rules = m_rules[length];
+    auto it = rules.find(ip & Mask(static_cast<uint8_t>(length)));
+    if (it != rules.end())
+      return it->second;
+  }
+  return m_allowByDefault;
+}
+
+std::size_t CidrTable::Size() const
+{
+  return m_size;
+}
+
+AddressCounter::AddressCounter(uint32_t limit, std::size_t expected)
+  : m_limit(limit)
+{
+  m_counts.reserve(expected);
+}
+
+bool AddressCounter::TryAdd(uint32_t ip)
+{
+  auto it = m_counts.find(ip);
+  if (it != m_counts.end() && m_limit && it->second >= m_limit)
+    return false;
+  m_counts[ip]++;
+  return true;
+}
+
+void AddressCounter::Add(uint32_t ip)
+{
+  m_counts[ip]++;
+}
+
+void AddressCounter::Remove(uint32_t ip)
+{
+  auto it = m_counts.find(ip);
+  if (it == m_counts.end())
+    return;
+  if (0 == --it->second)
+    m_counts.erase(it);
+}
+
+uint32_t AddressCounter::Get(uint32_t ip) const
+{
+  auto it = m_counts.find(ip);
+  return it == m_counts.end() ? 0 : it->second;
+}
+
+std::size_t AddressCounter::Size() const
+{
+  return m_counts.size();
+}
+
+} // namespace FtTCP
@@ -0,0 +1,284 @@
+#include "ft-socket/ft_load_generator.hpp"
+
+#include "esp_log.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace FtTCP {
+
+static constexpr char TAG[] = "LOAD";
+
+std::string LoadReport::ToString() const
+{
+  char buf[512];
+  std::snprintf(
+    buf, sizeof(buf) - 1,
+    "elapsed=%lldms connects=%llu failed=%llu logins=%llu commands=%llu "
+    "dropped=%llu\n"
+    "connects/s=%.1f commands/s=%.1f\n"
+    "latency us: p50=%lld p90=%lld p99=%lld max=%lld",
+    static_cast<long long>(elapsed.count()),
+    static_cast<unsigned long long>(connects),
+    static_cast<unsigned long long>(connectFailures),
+    static_cast<unsigned long long>(logins),
+    static_cast<unsigned long long>(commands),
+    static_cast<unsigned long long>(disconnects), connectsPerSecond,
+    commandsPerSecond, static_cast<long long>(latencyP50.count()),
+    static_cast<long long>(latencyP90.count()),
+    static_cast<long long>(latencyP99.count()),
+    static_cast<long long>(latencyMax.count()));
+  return std::string(buf);
+}
+
+LoadGenerator::LoadGenerator(const LoadParameters& params)
+  : m_parameters(params), m_sessions(params.sessions)
+{
+  for (const auto& command : m_parameters.script) {
+    m_scriptTotalWeight += command.weight;
+    m_scriptWeights.push_back(m_scriptTotalWeight);
+  }
+}
+
+LoadGenerator::~LoadGenerator()
+{
+  if (m_epoll != -1)
+    close(m_epoll);
+}
+
+const LoadCommand& LoadGenerator::PickCommand()
+{
+  // xorshift is plenty to shuffle the command mix
+  m_random ^= m_random << 13;
+  m_random ^= m_random >> 17;
+  m_random ^= m_random << 5;
+  unsigned int pick = m_random % m_scriptTotalWeight;
+  auto it =
+    std::upper_bound(m_scriptWeights.begin(), m_scriptWeights.end(), pick);
+  return m_parameters.script[it - m_scriptWeights.begin()];
+}
+
+bool LoadGenerator::OpenSession(std::size_t index)
+{
+  Session& session = m_sessions[index];
+  session = Session{};
+  session.socket = Socket::CreateSocket(m_address);
+  if (INVALID_SOCKET == session.socket->GetHandle()) {
+    session.socket = nullptr;
+    return false;
+  }
+  session.socket->SetNonBlocking(true);
+  if (!session.socket->Connect()) {
+    session.socket = nullptr;
+    return false;
+  }
+  epoll_event event{};
+  event.events = EPOLLIN | EPOLLOUT;
+  event.data.u64 = index;
+  epoll_ctl(m_epoll, EPOLL_CTL_ADD, session.socket->GetHandle(), &event);
+  return true;
+}
+
+void LoadGenerator::CloseSession(std::size_t index)
+{
+  Session& session = m_sessions[index];
+  if (!session.socket)
+    return;
+  epoll_ctl(m_epoll, EPOLL_CTL_DEL, session.socket->GetHandle(), nullptr);
+  session.socket = nullptr;
+}
+
+bool LoadGenerator::FlushOutput(Session& session)
+{
+  if (session.output.empty())
+    return true;
+  size_t sent = 0;
+  if (!session.socket->Send(session.output.data(), session.output.size(),
+                            MSG_NOSIGNAL, &sent)) {
+    if (errno != EAGAIN && errno != EWOULDBLOCK)
+      return false;
+  }
+  session.output.erase(0, sent);
+  return true;
+}
+
+void LoadGenerator::SendNextCommand(Session& session)
+{
+  const LoadCommand& command = PickCommand();
+  session.output += command.text;
+  session.output += '\n';
+  session.commandsSent++;
+  session.state = SessionState::AwaitReply;
+  session.sentAt = std::chrono::steady_clock::now();
+}
+
+bool LoadGenerator::ProcessInput(Session& session)
+{
+  const std::string& marker = (SessionState::AwaitPassword == session.state)
+                                ? m_parameters.passwordPrompt
+                                : m_parameters.commandPrompt;
+  if (session.input.find(marker) == std::string::npos) {
+    // wrong password, the server asks again
+    if (SessionState::AwaitPrompt == session.state &&
+        session.input.find(m_parameters.passwordPrompt) != std::string::npos)
+      return false;
+    // keep only the tail where a split marker could still start
+    if (session.input.size() > marker.size())
+      session.input.erase(0, session.input.size() - marker.size());
+    return true;
+  }
+  session.input.clear();
+
+  switch (session.state) {
+  case SessionState::AwaitPassword:
+    session.output += m_parameters.password;
+    session.output += '\n';
+    session.state = SessionState::AwaitPrompt;
+    break;
+  case SessionState::AwaitPrompt:
+    m_report.logins++;
+    SendNextCommand(session);
+    break;
+  case SessionState::AwaitReply: {
+    auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - session.sentAt);
+    m_latencies.push_back(static_cast<unsigned int>(latency.count()));
+    m_report.commands++;
+    if (session.commandsSent >= m_parameters.commandsPerSession)
+      return false;
+    SendNextCommand(session);
+    break;
+  }
+  default: break;
+  }
+  return true;
+}
+
+void LoadGenerator::OnSessionEvent(std::size_t index, uint32_t events)
+{
+  Session& session = m_sessions[index];
+  if (!session.socket)
+    return;
+
+  if (SessionState::Connecting == session.state) {
+    if (!(events & (EPOLLOUT | EPOLLERR | EPOLLHUP)))
+      return;
+    if ((events & (EPOLLERR | EPOLLHUP)) || !session.socket->FinishConnect()) {
+      m_report.connectFailures++;
+      CloseSession(index);
+      return;
+    }
+    m_report.connects++;
+    session.state = SessionState::AwaitPassword;
+  }
+
+  if (events & EPOLLIN) {
+    char buffer[RECEIVE_BUFFER_SIZE];
+    size_t received = session.socket->Receive(buffer, sizeof(buffer), 0);
+    if (0 == received) {
+      m_report.disconnects++;
+      CloseSession(index);
+      return;
+    }
+    session.input.append(buffer, received);
+    if (!ProcessInput(session)) {
+      CloseSession(index);
+      return;
+    }
+  }
+
+  if (!FlushOutput(session)) {
+    m_report.disconnects++;
+    CloseSession(index);
+    return;
+  }
+  epoll_event event{};
+  event.events = session.output.empty() ? EPOLLIN : (EPOLLIN | EPOLLOUT);
+  event.data.u64 = index;
+  epoll_ctl(m_epoll, EPOLL_CTL_MOD, session.socket->GetHandle(), &event);
+}
+
+LoadReport LoadGenerator::Run()
+{
+  m_report = LoadReport{};
+  m_latencies.clear();
+  if (m_parameters.script.empty() || 0 == m_scriptTotalWeight) {
+    ESP_LOGE(TAG, "empty command script");
+    return m_report;
+  }
+  m_address = Address::CreateClientAddress(m_parameters.host.c_str(),
+                                          m_parameters.port);
+  if (!m_address->IsValid()) {
+    ESP_LOGE(TAG, "can't resolve %s", m_address->toString().c_str());
+    return m_report;
+  }
+  m_epoll = epoll_create1(EPOLL_CLOEXEC);
+  if (-1 == m_epoll) {
+    ESP_LOGE(TAG, "epoll_create1 failed %d", errno);
+    return m_report;
+  }
+
+  uint64_t started = 0;
+  epoll_event events[MAX_EVENTS];
+  const auto start = std::chrono::steady_clock::now();
+  const auto finish = start + m_parameters.duration;
+  auto now = start;
+  while (now < finish) {
+    // ramp-up: never start more connections than the rate allows so far
+    auto elapsed =
+      std::chrono::duration_cast<std::chrono::microseconds>(now - start);
+    uint64_t allowed =
+      static_cast<uint64_t>(elapsed.count()) * m_parameters.connectRate /
+        1000000 +
+      1;
+    for (std::size_t i = 0; i < m_sessions.size() && started < allowed; i++) {
+      if (m_sessions[i].socket)
+        continue;
+      started++;
+      if (!OpenSession(i))
+        m_report.connectFailures++;
+    }
+
+    int count = epoll_wait(m_epoll, events, MAX_EVENTS,
+                           static_cast<int>(LOOP_TIMEOUT.count()));
+    for (int i = 0; i < count; i++) {
+      OnSessionEvent(static_cast<std::size_t>(events[i].data.u64),
+                     events[i].events);
+    }
+    now = std::chrono::steady_clock::now();
+  }
+
+  for (std::size_t i = 0; i < m_sessions.size(); i++)
+    CloseSession(i);
+  close(m_epoll);
+  m_epoll = -1;
+
+  m_report.elapsed =
+    std::chrono::duration_cast<std::chrono::milliseconds>(now - start);
+  double seconds = std::max<double>(m_report.elapsed.count(), 1) / 1000.0;
+  m_report.connectsPerSecond = m_report.connects / seconds;
+  m_report.commandsPerSecond = m_report.commands / seconds;
+  if (!m_latencies.empty()) {
+    std::sort(m_latencies.begin(), m_latencies.end());
+    auto percentile = [this](unsigned int p) {
+      std::size_t index = (m_latencies.size() - 1) * p / 100;
+      return std::chrono::microseconds(m_latencies[index]);
+    };
+    m_report.latencyP50 = percentile(50);
+    m_report.latencyP90 = percentile(90);
+    m_report.latencyP99 = percentile(99);
+    m_report.latencyMax = std::chrono::microseconds(m_latencies.back());
+  }
+  return m_report;
+}
+
+LoadGeneratorPtr LoadGenerator::CreateLoadGenerator(
+  const LoadParameters& params)
+{
+  return std::make_shared<LoadGenerator>(params);
+}
+
+} // namespace FtTCP
@@ -0,0 +1,367 @@
+#include "ft-socket/ft_memory_transport.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <errno.h>
+#include <limits>
+
+namespace FtTCP {
+
+namespace {
+
+// a blocking Send/Receive rechecks the peer this often
+constexpr std::chrono::milliseconds BLOCK_SLICE{100};
+constexpr std::size_t MIN_RING_SIZE{4096};
+
+int64_t Now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+// accepts the connections MemoryTransport::Connect() queued
+class MemoryListener : public Socket {
+private:
+  std::shared_ptr<MemoryTransport::Backlog> m_backlog;
+
+public:
+  MemoryListener(std::shared_ptr<MemoryTransport::Backlog> backlog)
+    : Socket(nullptr, INVALID_SOCKET), m_backlog(std::move(backlog))
+  {
+  }
+
+  ~MemoryListener() override
+  {
+    // the connections nobody accepted see their peer close
+    std::lock_guard<std::mutex> lock(m_backlog->mutex);
+    m_backlog->listening = false;
+    m_backlog->pending.clear();
+  }
+
+  bool IsInvalid() const override { return false; }
+
+  SocketPtr Accept(std::chrono::milliseconds timeout) override
+  {
+    std::unique_lock<std::mutex> lock(m_backlog->mutex);
+    if (!m_backlog->signal.wait_for(
+          lock, timeout, [this]() { return !m_backlog->pending.empty(); }))
+      return nullptr;
+    SocketPtr connection = std::move(m_backlog->pending.front());
+    m_backlog->pending.pop_front();
+    return connection;
+  }
+};
+
+} // namespace
+
+MemoryRing::MemoryRing(const MemoryLinkParameters& link)
+  : m_latency(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(link.latency)
+        .count()),
+    m_bytesPerSecond(link.bytesPerSecond)
+{
+  std::size_t size = MIN_RING_SIZE;
+  while (size < link.ringSize)
+    size *= 2;
+  m_data = std::make_unique<char[]>(size);
+  m_mask = size - 1;
+}
+
+void MemoryRing::CopyIn(uint64_t at, const void* data, std::size_t size)
+{
+  std::size_t offset = at & m_mask;
+  std::size_t first = std::min(size, m_mask + 1 - offset);
+  std::memcpy(&m_data[offset], data, first);
+  std::memcpy(&m_data[0], static_cast<const char*>(data) + first,
+              size - first);
+}
+
+void MemoryRing::CopyOut(uint64_t at, void* data, std::size_t size) const
+{
+  std::size_t offset = at & m_mask;
+  std::size_t first = std::min(size, m_mask + 1 - offset);
+  std::memcpy(data, &m_data[offset], first);
+  std::memcpy(static_cast<char*>(data) + first, &m_data[0], size - first);
+}
+
+void MemoryRing::Wake()
+{
+  // pairs with the fence in Wait(): either the sleeper sees the update
+  // or we see the sleeper
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (0 == m_waiters.load(std::memory_order_relaxed))
+    return;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_signal.notify_all();
+}
+
+template<class Ready>
+bool MemoryRing::Wait(Ready ready, const int64_t* dueAt,
+                      std::chrono::milliseconds timeout)
+{
+  if (ready())
+    return true;
+  if (timeout.count() <= 0)
+    return false;
+  auto deadline = Clock::now() + timeout;
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_waiters.fetch_add(1);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  bool result;
+  while (!(result = ready()) && Clock::now() < deadline) {
+    // a record held back by the simulated link wakes us when it's due
+    auto until = deadline;
+    if (dueAt && *dueAt)
+      until = std::min(until, Clock::time_point(
+                                std::chrono::duration_cast<Clock::duration>(
+                                  std::chrono::nanoseconds(*dueAt))));
+    m_signal.wait_until(lock, until);
+  }
+  m_waiters.fetch_sub(1);
+  return result;
+}
+
+std::size_t MemoryRing::Write(const void* data, std::size_t size)
+{
+  if (0 == size || m_readerClosed.load(std::memory_order_acquire))
+    return 0;
+  uint64_t tail = m_tail.load(std::memory_order_relaxed);
+  std::size_t room =
+    m_mask + 1 - (tail - m_head.load(std::memory_order_acquire));
+  if (room <= RECORD_HEADER)
+    return 0;
+  std::size_t bytes = std::min<std::size_t>(
+    {size, room - RECORD_HEADER, std::numeric_limits<uint32_t>::max()});
+  int64_t readyAt = 0;
+  if (m_latency || m_bytesPerSecond) {
+    // the bytes queue behind the previous write on the simulated link
+    readyAt = std::max(Now(), m_linkFreeAt);
+    if (m_bytesPerSecond)
+      readyAt += static_cast<int64_t>(bytes * 1e9 / m_bytesPerSecond);
+    m_linkFreeAt = readyAt;
+    readyAt += m_latency;
+  }
+  uint32_t recordSize = static_cast<uint32_t>(bytes);
+  CopyIn(tail, &readyAt, sizeof(readyAt));
+  CopyIn(tail + sizeof(readyAt), &recordSize, sizeof(recordSize));
+  CopyIn(tail + RECORD_HEADER, data, bytes);
+  m_tail.store(tail + RECORD_HEADER + bytes, std::memory_order_release);
+  Wake();
+  return bytes;
+}
+
+bool MemoryRing::WaitWritable(std::chrono::milliseconds timeout)
+{
+  return Wait(
+    [this]() {
+      return m_readerClosed.load(std::memory_order_acquire) ||
+             m_mask + 1 - (m_tail.load(std::memory_order_relaxed) -
+                           m_head.load(std::memory_order_acquire)) >
+               RECORD_HEADER;
+    },
+    nullptr, timeout);
+}
+
+void MemoryRing::CloseWriter()
+{
+  m_writerClosed.store(true, std::memory_order_release);
+  Wake();
+}
+
+bool MemoryRing::IsReaderClosed() const
+{
+  return m_readerClosed.load(std::memory_order_acquire);
+}
+
+bool MemoryRing::NextRecord()
+{
+  uint64_t tail = m_tail.load(std::memory_order_acquire);
+  if (tail - m_readAt < RECORD_HEADER)
+    return false;
+  int64_t readyAt;
+  CopyOut(m_readAt, &readyAt, sizeof(readyAt));
+  if (readyAt && readyAt > Now()) {
+    m_nextReadyAt = readyAt;
+    return false;
+  }
+  uint32_t recordSize;
+  CopyOut(m_readAt + sizeof(readyAt), &recordSize, sizeof(recordSize));
+  m_readAt += RECORD_HEADER;
+  m_recordLeft = recordSize;
+  m_nextReadyAt = 0;
+  return true;
+}
+
+std::size_t MemoryRing::Read(void* data, std::size_t size)
+{
+  std::size_t copied = 0;
+  while (copied < size && (m_recordLeft || NextRecord())) {
+    std::size_t bytes = std::min(size - copied, m_recordLeft);
+    CopyOut(m_readAt, static_cast<char*>(data) + copied, bytes);
+    m_readAt += bytes;
+    m_recordLeft -= bytes;
+    copied += bytes;
+  }
+  if (copied) {
+    m_head.store(m_readAt, std::memory_order_release);
+    Wake();
+  }
+  return copied;
+}
+
+bool MemoryRing::WaitReadable(std::chrono::milliseconds timeout)
+{
+  return Wait([this]() { return m_recordLeft || NextRecord() || IsDrained(); },
+              &m_nextReadyAt, timeout);
+}
+
+void MemoryRing::CloseReader()
+{
+  m_readerClosed.store(true, std::memory_order_release);
+  Wake();
+}
+
+bool MemoryRing::IsDrained() const
+{
+  return m_writerClosed.load(std::memory_order_acquire) &&
+         m_tail.load(std::memory_order_acquire) == m_readAt;
+}
+
+MemorySocket::MemorySocket(std::shared_ptr<MemoryRing> in,
+                           std::shared_ptr<MemoryRing> out)
+  : Socket(nullptr, INVALID_SOCKET), m_in(std::move(in)), m_out(std::move(out))
+{
+}
+
+MemorySocket::~MemorySocket()
+{
+  m_in->CloseReader();
+  m_out->CloseWriter();
+}
+
+bool MemorySocket::NeedsUserspaceCopy() const
+{
+  return true;
+}
+
+bool MemorySocket::IsInvalid() const
+{
+  // the peer is gone and everything it sent has been read
+  return m_out->IsReaderClosed() && m_in->IsDrained();
+}
+
+bool MemorySocket::IsReadyForRead(std::chrono::milliseconds timeout)
+{
+  return m_in->WaitReadable(timeout);
+}
+
+bool MemorySocket::IsReadyForWrite(std::chrono::milliseconds timeout)
+{
+  return m_out->WaitWritable(timeout);
+}
+
+SocketPtr MemorySocket::Accept(std::chrono::milliseconds)
+{
+  return nullptr;
+}
+
+size_t MemorySocket::Receive(void* data, size_t bytes, uint32_t)
+{
+  while (true) {
+    size_t received = m_in->Read(data, bytes);
+    // 0 at the end of the stream, as recv()
+    if (received || 0 == bytes || m_in->IsDrained())
+      return received;
+    m_in->WaitReadable(BLOCK_SLICE);
+  }
+}
+
+bool MemorySocket::Send(void* data, size_t bytes, uint32_t,
+                        size_t* bytesSent)
+{
+  if (nullptr == bytesSent) {
+    return false;
+  }
+  if (0 == bytes) {
+    return true;
+  }
+  while (true) {
+    if (m_out->IsReaderClosed()) {
+      m_errors.push(EPIPE);
+      return false;
+    }
+    size_t written = m_out->Write(data, bytes);
+    if (written) {
+      *bytesSent += written;
+      return true;
+    }
+    m_out->WaitWritable(BLOCK_SLICE);
+  }
+}
+
+bool MemorySocket::StartTls(TlsContextPtr, std::chrono::milliseconds)
+{
+  m_errors.push(EOPNOTSUPP);
+  return false;
+}
+
+bool MemorySocket::SetBusyPoll(int)
+{
+  return true;
+}
+
+int MemorySocket::GetIncomingCpu() const
+{
+  return -1;
+}
+
+bool MemorySocket::ApplyOptions(const SocketOptions&)
+{
+  return true;
+}
+
+bool MemorySocket::SetCork(bool)
+{
+  return false;
+}
+
+MemoryTransport::MemoryTransport(const MemoryLinkParameters& link)
+  : m_link(link), m_backlog(std::make_shared<Backlog>())
+{
+}
+
+SocketPtr MemoryTransport::Listen(int backlog)
+{
+  std::lock_guard<std::mutex> lock(m_backlog->mutex);
+  if (m_backlog->listening)
+    return nullptr;
+  m_backlog->listening = true;
+  m_backlog->size = std::max(backlog, 1);
+  return std::make_shared<MemoryListener>(m_backlog);
+}
+
+SocketPtr MemoryTransport::Connect()
+{
+  auto toServer = std::make_shared<MemoryRing>(m_link);
+  auto toClient = std::make_shared<MemoryRing>(m_link);
+  auto client = std::make_shared<MemorySocket>(toClient, toServer);
+  {
+    std::lock_guard<std::mutex> lock(m_backlog->mutex);
+    if (!m_backlog->listening ||
+        m_backlog->pending.size() >= static_cast<std::size_t>(m_backlog->size))
+      return nullptr;
+    m_backlog->pending.push_back(
+      std::make_shared<MemorySocket>(toServer, toClient));
+  }
+  m_backlog->signal.notify_one();
+  return client;
+}
+
+TransportPtr MemoryTransport::CreateMemoryTransport(
+  const MemoryLinkParameters& link)
+{
+  return std::make_shared<MemoryTransport>(link);
+}
+
+} // namespace FtTCP
@@ -0,0 +1,128 @@
+#include "ft-socket/ft_receive_batch.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace FtTCP {
+
+ReceiveBatcher::ReceiveBatcher(const BatchParameters& parameters,
+                               Deliver deliver,
+                               const ThreadPlacement& placement)
+  : m_parameters(parameters), m_deliver(std::move(deliver))
+{
+  m_parameters.maxRecords = std::max<std::size_t>(m_parameters.maxRecords, 1);
+  m_filling.bytes.reserve(m_parameters.maxBytes);
+  m_filling.pending.reserve(m_parameters.maxRecords);
+  m_thread = std::thread([this, placement]() { Run(placement); });
+}
+
+ReceiveBatcher::~ReceiveBatcher()
+{
+  Stop();
+}
+
+bool ReceiveBatcher::IsFull(std::size_t moreBytes) const
+{
+  // a record bigger than maxBytes still goes, in a batch of its own
+  return m_filling.pending.size() >= m_parameters.maxRecords ||
+         (!m_filling.pending.empty() &&
+          m_filling.bytes.size() + moreBytes > m_parameters.maxBytes);
+}
+
+void ReceiveBatcher::Add(ClientHandle handle, const void* data,
+                         std::size_t size)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  if (IsFull(size)) {
+    m_ready.notify_one();
+    m_room.wait(lock, [this, size]() { return m_stopping || !IsFull(size); });
+  }
+  if (m_filling.pending.empty())
+    m_firstAdded = Clock::now();
+  std::size_t offset = m_filling.bytes.size();
+  m_filling.bytes.resize(offset + size);
+  std::memcpy(m_filling.bytes.data() + offset, data, size);
+  m_filling.pending.push_back(Pending{handle, offset, size});
+  m_added++;
+  if (1 == m_filling.pending.size() || IsFull(0))
+    m_ready.notify_one();
+}
+
+void ReceiveBatcher::Flush()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  uint64_t target = m_added;
+  if (m_delivered >= target || m_stopping)
+    return;
+  m_flushing = true;
+  m_ready.notify_one();
+  m_room.wait(lock,
+              [this, target]() { return m_delivered >= target || m_stopping; });
+}
+
+void ReceiveBatcher::Stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+  m_ready.notify_one();
+  m_room.notify_all();
+  if (m_thread.joinable())
+    m_thread.join();
+}
+
+void ReceiveBatcher::GetCounters(uint64_t* batches, uint64_t* records)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  *batches = m_batches;
+  *records = m_delivered;
+}
+
+void ReceiveBatcher::Run(ThreadPlacement placement)
+{
+  placement.Apply("batch");
+  Batch delivering;
+  delivering.bytes.reserve(m_parameters.maxBytes);
+  delivering.pending.reserve(m_parameters.maxRecords);
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+    if (m_filling.pending.empty()) {
+      if (m_stopping)
+        break;
+      m_ready.wait(lock);
+      continue;
+    }
+    // wait out the hold unless the batch is complete anyway
+    auto deadline = m_firstAdded + m_parameters.maxHold;
+    if (!m_stopping && !m_flushing && !IsFull(0) && Clock::now() < deadline) {
+      m_ready.wait_until(lock, deadline);
+      continue;
+    }
+    m_flushing = false;
+    std::swap(m_filling, delivering);
+    std::size_t count = delivering.pending.size();
+    // the I/O threads fill the other buffer meanwhile
+    m_room.notify_all();
+    lock.unlock();
+
+    delivering.records.clear();
+    for (const Pending& pending : delivering.pending) {
+      delivering.records.push_back(ReceiveRecord{
+        pending.handle,
+        std::string_view(delivering.bytes.data() + pending.offset,
+                         pending.size)});
+    }
+    m_deliver(ReceiveBatch(delivering.records));
+    delivering.bytes.clear();
+    delivering.pending.clear();
+
+    lock.lock();
+    m_delivered += count;
+    m_batches++;
+    // Flush() callers wait for the delivered count
+    m_room.notify_all();
+  }
+}
+
+} // namespace FtTCP
@@ -0,0 +1,154 @@
+#include "ft-socket/ft_resume.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <sys/random.h>
+
+namespace FtTCP {
+
+// 128 bits, hex encoded
+static constexpr std::size_t TOKEN_BYTES{16};
+
+ResumeTable::ResumeTable(std::size_t capacity, std::chrono::seconds ttl)
+  : m_capacity(std::max<std::size_t>(capacity, 1)), m_ttl(ttl)
+{
+}
+
+std::string ResumeTable::NewToken()
+{
+  unsigned char bytes[TOKEN_BYTES];
+  std::size_t filled = 0;
+  while (filled < sizeof(bytes)) {
+    ssize_t got = getrandom(bytes + filled, sizeof(bytes) - filled, 0);
+    if (got <= 0)
+      break;
+    filled += got;
+  }
+  if (filled < sizeof(bytes)) {
+    // no getrandom(), still unpredictable enough for a session key
+    std::random_device device;
+    for (; filled < sizeof(bytes); filled++)
+      bytes[filled] = static_cast<unsigned char>(device());
+  }
+  char text[TOKEN_BYTES * 2 + 1];
+  for (std::size_t i = 0; i < TOKEN_BYTES; i++)
+    std::snprintf(text + i * 2, 3, "%02x", bytes[i]);
+  return std::string(text, TOKEN_BYTES * 2);
+}
+
+void ResumeTable::SkipStale()
+{
+  while (!m_parked.empty()) {
+    auto it = m_entries.find(m_parked.front().second);
+    if (it != m_entries.end() && it->second.parked &&
+        it->second.expires == m_parked.front().first)
+      return;
+    m_parked.pop_front();
+  }
+}
+
+void ResumeTable::Unpark(Entry& entry)
+{
+  if (!entry.parked)
+    return;
+  entry.parked = false;
+  m_parkedCount--;
+}
+
+std::string ResumeTable::Issue(ClientHandle handle,
+                               std::vector<ClientHandle>* evicted)
+{
+  if (m_entries.size() >= m_capacity) {
+    SkipStale();
+    if (m_parked.empty())
+      return std::string();
+    auto it = m_entries.find(m_parked.front().second);
+    evicted->push_back(it->second.handle);
+    Unpark(it->second);
+    m_entries.erase(it);
+    m_parked.pop_front();
+  }
+  std::string token = NewToken();
+  m_entries[token] = Entry{handle, false, Clock::time_point()};
+  return token;
+}
+
+bool ResumeTable::Park(const std::string& token)
+{
+  auto it = m_entries.find(token);
+  if (it == m_entries.end() || it->second.parked)
+    return false;
+  it->second.parked = true;
+  it->second.expires = Clock::now() + m_ttl;
+  m_parkedCount++;
+  m_parked.emplace_back(it->second.expires, token);
+  return true;
+}
+
+bool ResumeTable::Find(const std::string& token, ClientHandle* handle) const
+{
+  auto it = m_entries.find(token);
+  if (it == m_entries.end() ||
+      (it->second.parked && Clock::now() >= it->second.expires))
+    return false;
+  *handle = it->second.handle;
+  return true;
+}
+
+bool ResumeTable::Take(const std::string& token, ClientHandle* handle)
+{
+  if (!Find(token, handle))
+    return false;
+  auto it = m_entries.find(token);
+  Unpark(it->second);
+  m_entries.erase(it);
+  return true;
+}
+
+void ResumeTable::Remove(const std::string& token)
+{
+  auto it = m_entries.find(token);
+  if (it == m_entries.end())
+    return;
+  Unpark(it->second);
+  m_entries.erase(it);
+}
+
+std::vector<ClientHandle> ResumeTable::TakeExpired()
+{
+  std::vector<ClientHandle> expired;
+  auto now = Clock::now();
+  for (SkipStale(); !m_parked.empty() && m_parked.front().first <= now;
+       SkipStale()) {
+    auto it = m_entries.find(m_parked.front().second);
+    expired.push_back(it->second.handle);
+    Unpark(it->second);
+    m_entries.erase(it);
+    m_parked.pop_front();
+  }
+  return expired;
+}
+
+std::vector<ClientHandle> ResumeTable::TakeParked()
+{
+  std::vector<ClientHandle> parked;
+  for (auto it = m_entries.begin(); it != m_entries.end();) {
+    if (!it->second.parked) {
+      ++it;
+      continue;
+    }
+    parked.push_back(it->second.handle);
+    Unpark(it->second);
+    it = m_entries.erase(it);
+  }
+  m_parked.clear();
+  return parked;
+}
+
+std::size_t ResumeTable::GetParked() const
+{
+  return m_parkedCount;
+}
+
+} // namespace FtTCP
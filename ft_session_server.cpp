@@ -0,0 +1,353 @@
+#include "ft-socket/ft_session_server.hpp"
+
+#include "esp_log.h"
+
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace FtTCP {
+
+static constexpr uint32_t CONNECTION_EVENTS =
+  EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+// compact the output once this much of it went out
+static constexpr std::size_t OUTPUT_COMPACT_SIZE{4096};
+
+Connection::Connection(SessionServer& server, SocketPtr socket,
+                       SessionHandle handle)
+  : m_server(server), m_socket(socket), m_handle(handle)
+{
+}
+
+Connection::~Connection()
+{
+  if (m_timer)
+    m_server.m_loop->CancelTimer(m_timer);
+}
+
+bool Connection::IsOpen() const
+{
+  return !m_closed;
+}
+
+SessionHandle Connection::GetHandle() const
+{
+  return m_handle;
+}
+
+bool Connection::HasLine() const
+{
+  return m_input.find('\n') != std::string::npos;
+}
+
+void Connection::ReadAvailable()
+{
+  // edge triggered: read until EAGAIN or until there is a line, the rest
+  // waits in the kernel for the next ReadLine()
+  while (!m_closed && !HasLine() && m_input.size() <= MAX_LINE) {
+    std::size_t used = m_input.size();
+    m_input.resize(used + RECEIVE_CHUNK);
+    ssize_t received =
+      recv(m_socket->GetHandle(), &m_input[used], RECEIVE_CHUNK, MSG_DONTWAIT);
+    m_input.resize(used +
+                   static_cast<std::size_t>(std::max<ssize_t>(received, 0)));
+    if (received > 0)
+      continue;
+    if (received < 0 && (EAGAIN == errno || EWOULDBLOCK == errno))
+      return;
+    if (received < 0 && EINTR == errno)
+      continue;
+    m_closed = true;
+  }
+}
+
+void Connection::Flush()
+{
+  while (m_outputSent < m_output.size()) {
+    ssize_t sent = send(m_socket->GetHandle(), m_output.data() + m_outputSent,
+                        m_output.size() - m_outputSent,
+                        MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (sent > 0) {
+      m_outputSent += static_cast<std::size_t>(sent);
+      continue;
+    }
+    if (sent < 0 && (EAGAIN == errno || EWOULDBLOCK == errno))
+      return;
+    if (sent < 0 && EINTR == errno)
+      continue;
+    m_closed = true;
+    return;
+  }
+  // the capacity stays for the next replies
+  m_output.clear();
+  m_outputSent = 0;
+}
+
+void Connection::Suspend(Wait wait, std::coroutine_handle<> waiter,
+                         std::chrono::milliseconds timeout)
+{
+  m_wait = wait;
+  m_waiter = waiter;
+  m_timedOut = false;
+  if (timeout.count() > 0) {
+    m_timer = m_server.m_loop->AddTimer(timeout, [this]() {
+      m_timer = 0;
+      m_timedOut = true;
+      m_server.Resume(*this);
+    });
+  }
+}
+
+void Connection::OnEvent(uint32_t events)
+{
+  if (events & (EPOLLERR | EPOLLHUP))
+    m_closed = true;
+  if (events & EPOLLOUT)
+    Flush();
+  switch (m_wait) {
+  case Readable:
+    ReadAvailable();
+    if (HasLine() || m_closed || m_input.size() > MAX_LINE)
+      m_server.Resume(*this);
+    break;
+  case Writable:
+    if (m_closed || m_output.size() - m_outputSent <= MAX_PENDING_OUTPUT)
+      m_server.Resume(*this);
+    break;
+  default: break;
+  }
+}
+
+bool Connection::ReadLineAwaiter::await_ready()
+{
+  Connection& c = connection;
+  c.m_timedOut = false;
+  // the previous line is no longer referenced
+  if (c.m_consumed) {
+    c.m_input.erase(0, c.m_consumed);
+    c.m_consumed = 0;
+  }
+  if (!c.HasLine())
+    c.ReadAvailable();
+  return c.HasLine() || c.m_closed || c.m_input.size() > MAX_LINE;
+}
+
+void Connection::ReadLineAwaiter::await_suspend(std::coroutine_handle<> waiter)
+{
+  connection.Suspend(Readable, waiter,
+                     connection.m_server.m_parameters.clientTimeOut);
+}
+
+std::optional<std::string_view> Connection::ReadLineAwaiter::await_resume()
+{
+  Connection& c = connection;
+  std::size_t end = c.m_input.find('\n');
+  if (c.m_timedOut || std::string::npos == end) {
+    if (c.m_input.size() > MAX_LINE) {
+      ESP_LOGW(SessionServer::TAG, "client %lu line too long", c.m_handle);
+      c.Close();
+    }
+    c.m_timedOut = false;
+    return std::nullopt;
+  }
+  c.m_consumed = end + 1;
+  if (end > 0 && '\r' == c.m_input[end - 1])
+    end--;
+  return std::string_view(c.m_input.data(), end);
+}
+
+bool Connection::WriteAwaiter::await_ready()
+{
+  Connection& c = connection;
+  c.Flush();
+  return c.m_closed ||
+         c.m_output.size() - c.m_outputSent <= MAX_PENDING_OUTPUT;
+}
+
+void Connection::WriteAwaiter::await_suspend(std::coroutine_handle<> waiter)
+{
+  connection.Suspend(Writable, waiter, std::chrono::milliseconds(0));
+}
+
+bool Connection::WriteAwaiter::await_resume()
+{
+  return !connection.m_closed;
+}
+
+void Connection::SleepAwaiter::await_suspend(std::coroutine_handle<> waiter)
+{
+  connection.Suspend(Timer, waiter, delay);
+}
+
+Connection::ReadLineAwaiter Connection::ReadLine()
+{
+  return ReadLineAwaiter{*this};
+}
+
+Connection::WriteAwaiter Connection::Write(std::string_view data)
+{
+  if (!m_closed) {
+    if (m_outputSent >= OUTPUT_COMPACT_SIZE) {
+      m_output.erase(0, m_outputSent);
+      m_outputSent = 0;
+    }
+    m_output.append(data);
+  }
+  return WriteAwaiter{*this};
+}
+
+Connection::SleepAwaiter Connection::Sleep(std::chrono::milliseconds delay)
+{
+  return SleepAwaiter{*this, delay};
+}
+
+void Connection::Close()
+{
+  if (m_closed)
+    return;
+  // what the socket doesn't take right now is dropped
+  Flush();
+  m_closed = true;
+  shutdown(m_socket->GetHandle(), SHUT_RDWR);
+}
+
+SessionServer::SessionServer(const SessionParameters& params,
+                             SessionFnType session)
+  : m_parameters(params), m_session(session)
+{
+  m_loop = EventLoop::CreateEventLoop();
+}
+
+SessionServer::~SessionServer()
+{
+  Stop();
+}
+
+bool SessionServer::Start()
+{
+  if (m_loopThread.joinable() || !m_loop->IsValid())
+    return false;
+  m_address = Address::CreateListenerAddress(m_parameters.port, true);
+  m_listenerSocket = Socket::CreateSocket(m_address);
+  if (!m_listenerSocket->Bind() ||
+      !m_listenerSocket->Listen(m_parameters.backlog)) {
+    ESP_LOGE(TAG, "can't listen on %u: %s", m_parameters.port,
+             m_listenerSocket->ErrorsToStr().c_str());
+    m_listenerSocket = nullptr;
+    return false;
+  }
+  m_listenerSocket->SetNonBlocking(true);
+  m_loop->Add(m_listenerSocket->GetHandle(), EPOLLIN,
+              [this](uint32_t) { OnAccept(); });
+  m_loopThread = std::thread([this]() { this->Run(); });
+  return true;
+}
+
+void SessionServer::Stop()
+{
+  m_loop->Stop();
+  if (m_loopThread.joinable())
+    m_loopThread.join();
+}
+
+std::size_t SessionServer::ConnectionCount() const
+{
+  return m_connectionCount.load();
+}
+
+void SessionServer::Run()
+{
+  m_parameters.ioThreads.Apply("0");
+  ESP_LOGI(TAG, "Started");
+  m_loop->Run();
+  // suspended sessions are destroyed on the thread which ran them
+  m_connections.clear();
+  m_connectionCount = 0;
+  m_loop->Remove(m_listenerSocket->GetHandle());
+  m_listenerSocket = nullptr;
+  ESP_LOGI(TAG, "Stopped");
+}
+
+void SessionServer::OnAccept()
+{
+  while (true) {
+    int fd = accept4(m_listenerSocket->GetHandle(), nullptr, nullptr,
+                     SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (EINTR == errno)
+        continue;
+      if (EAGAIN != errno && EWOULDBLOCK != errno)
+        ESP_LOGW(TAG, "accept failed %d", errno);
+      return;
+    }
+    if (m_connections.size() >= m_parameters.maxConnections) {
+      ESP_LOGW(TAG, "connection refused, %zu clients", m_connections.size());
+      close(fd);
+      continue;
+    }
+    auto connection = std::make_shared<Connection>(
+      *this, Socket::CreateSocket(m_address, fd), ++m_handlesCounter);
+    m_connections[fd] = connection;
+    m_connectionCount = m_connections.size();
+    m_loop->Add(fd, CONNECTION_EVENTS,
+                [this, fd](uint32_t events) { OnConnectionEvent(fd, events); });
+    connection->m_session = m_session(*connection);
+    connection->m_session.Start();
+    if (connection->m_session.IsDone())
+      Finish(connection);
+  }
+}
+
+void SessionServer::OnConnectionEvent(int fd, uint32_t events)
+{
+  auto found = m_connections.find(fd);
+  if (found == m_connections.end())
+    return;
+  // the session may finish inside, keep the connection until we return
+  ConnectionPtr connection = found->second;
+  connection->OnEvent(events);
+}
+
+void SessionServer::Resume(Connection& connection)
+{
+  if (connection.m_timer) {
+    m_loop->CancelTimer(connection.m_timer);
+    connection.m_timer = 0;
+  }
+  connection.m_wait = Connection::None;
+  std::coroutine_handle<> waiter = std::exchange(connection.m_waiter, {});
+  waiter.resume();
+  if (connection.m_session.IsDone()) {
+    auto found = m_connections.find(connection.m_socket->GetHandle());
+    if (found != m_connections.end())
+      Finish(found->second);
+  }
+}
+
+void SessionServer::Finish(ConnectionPtr connection)
+{
+  if (connection->m_session.IsValid()) {
+    // a failed session is closed like a finished one
+    try {
+      connection->m_session.await_resume();
+    }
+    catch (const std::exception& error) {
+      ESP_LOGE(TAG, "client %lu session failed: %s", connection->m_handle,
+               error.what());
+    }
+  }
+  connection->Flush();
+  int fd = connection->m_socket->GetHandle();
+  m_loop->Remove(fd);
+  m_connections.erase(fd);
+  m_connectionCount = m_connections.size();
+}
+
+SessionServerPtr SessionServer::CreateSessionServer(
+  const SessionParameters& params, SessionFnType session)
+{
+  return std::make_shared<SessionServer>(params, session);
+}
+
+} // namespace FtTCP
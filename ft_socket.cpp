@@ -1,13 +1,29 @@
 #include "ft-socket/ft_socket.hpp"
 
 #include "esp_log.h"
+#include "ft-socket/ft_trace.hpp"
 
+#include <algorithm>
 #include <errno.h>
+#include <fcntl.h>
+#include <linux/sockios.h>
 #include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
 #include <sys/ioctl.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <unistd.h>
 
+#ifdef FT_SOCKET_TLS
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#endif
+
 namespace FtTCP {
 
 Socket::Socket(AddressPtr address)
@@ -19,8 +35,10 @@ Socket::Socket(AddressPtr address)
   if (!m_address->IsValid()) {
     return;
   }
-  const sockaddr_in* addr = m_address->GetAddress();
-  m_socket = socket(addr->sin_family, m_address->GetSocketType(), m_address->GetProto());
+  // no descriptor leaks into processes we spawn, e.g. during an upgrade
+  m_socket = socket(m_address->GetFamily(),
+                    m_address->GetSocketType() | SOCK_CLOEXEC,
+                    m_address->GetProto());
 }
 
 Socket::Socket(AddressPtr address, PlatformSocket sock)
@@ -30,6 +48,13 @@ Socket::Socket(AddressPtr address, PlatformSocket sock)
 
 Socket::~Socket()
 {
+#ifdef FT_SOCKET_TLS
+  if (m_ssl) {
+    // best effort close_notify, we don't wait for the peer's one
+    SSL_shutdown(m_ssl);
+    SSL_free(m_ssl);
+  }
+#endif
   if (m_socket != INVALID_SOCKET) {
     shutdown(m_socket, SHUT_RDWR);
     close(m_socket);
@@ -47,29 +72,90 @@ std::string Socket::ErrorsToStr() const
   return res;
 }
 
+// poll() rather than select(): with thousands of clients the descriptors
+// go past FD_SETSIZE; returns 1 when one of the events (or an error) is
+// pending, 0 on timeout
+static int WaitForEvents(PlatformSocket socket, short events,
+                         std::chrono::microseconds timeout)
+{
+  pollfd descriptor{socket, events, 0};
+  auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+  auto nanos =
+    std::chrono::duration_cast<std::chrono::nanoseconds>(timeout - seconds);
+  timespec wait{static_cast<time_t>(seconds.count()),
+                static_cast<long>(nanos.count())};
+  // spinning checks would flood the trace
+  if (0 == timeout.count())
+    return ppoll(&descriptor, 1, &wait, nullptr);
+  FT_TRACE_SPAN(span, "poll", 0);
+  int result = ppoll(&descriptor, 1, &wait, nullptr);
+  FT_TRACE_VALUE(span, result);
+  return result;
+}
+
+void Socket::SetPeer(const sockaddr_storage& peer)
+{
+  if (AF_INET != peer.ss_family)
+    return;
+  const sockaddr_in* address = reinterpret_cast<const sockaddr_in*>(&peer);
+  m_peerIp = ntohl(address->sin_addr.s_addr);
+  m_peerPort = ntohs(address->sin_port);
+  m_hasPeer = true;
+}
+
+bool Socket::GetPeerIpv4(uint32_t* ip, uint16_t* port) const
+{
+  if (!m_hasPeer)
+    return false;
+  *ip = m_peerIp;
+  if (port)
+    *port = m_peerPort;
+  return true;
+}
+
+bool Socket::LoadPeerAddress()
+{
+  sockaddr_storage peer;
+  socklen_t peerLength = sizeof(peer);
+  if (0 != getpeername(m_socket, reinterpret_cast<sockaddr*>(&peer),
+                       &peerLength)) {
+    m_errors.push(errno);
+    return false;
+  }
+  SetPeer(peer);
+  return m_hasPeer;
+}
+
+int Socket::WaitForAnyReadable(const std::vector<PlatformSocket>& sockets,
+                               std::chrono::milliseconds timeout)
+{
+  std::vector<pollfd> descriptors;
+  descriptors.reserve(sockets.size());
+  for (PlatformSocket socket : sockets)
+    descriptors.push_back(pollfd{socket, POLLIN, 0});
+  FT_TRACE_SPAN(span, "poll", descriptors.size());
+  if (poll(descriptors.data(), descriptors.size(), timeout.count()) <= 0)
+    return -1;
+  for (size_t i = 0; i < descriptors.size(); i++) {
+    if (descriptors[i].revents)
+      return static_cast<int>(i);
+  }
+  return -1;
+}
+
 bool Socket::IsInvalid() const
 {
   if (m_socket == INVALID_SOCKET)
     return true;
 
-  fd_set socketSetErr;
-  timeval tmval{0, TCP_NODELAY_US};
-
-  FD_ZERO(&socketSetErr);
-  FD_SET(m_socket, &socketSetErr);
-  PlatformError ErrDescr = select(static_cast<int>(m_socket + 1), (fd_set*)0,
-                                  (fd_set*)0, &socketSetErr, &tmval);
-  if (ErrDescr != 0) // invalid
+  pollfd descriptor{m_socket, POLLOUT | POLLPRI, 0};
+  timespec wait{0, TCP_NODELAY_US * 1000};
+  PlatformError result = ppoll(&descriptor, 1, &wait, nullptr);
+  if (result > 0 && (descriptor.revents & (POLLPRI | POLLNVAL))) // invalid
   {
     return true;
   }
-
-  fd_set socketSetWr;
-  FD_ZERO(&socketSetWr);
-  FD_SET(m_socket, &socketSetWr);
-  PlatformError WrDescr = select(static_cast<int>(m_socket + 1), (fd_set*)0,
-                                 &socketSetWr, (fd_set*)0, &tmval);
-  if (WrDescr < 1) // invalid
+  if (result < 1) // invalid
   {
     PlatformError lastError = errno;
     m_errors.push(lastError);
@@ -78,12 +164,32 @@ bool Socket::IsInvalid() const
   return false; // socket is valid
 }
 
+PlatformSocket Socket::Release()
+{
+  PlatformSocket sock = m_socket;
+  m_socket = INVALID_SOCKET;
+  return sock;
+}
+
+PlatformSocket Socket::GetHandle() const
+{
+  return m_socket;
+}
+
 void Socket::SetNonBlocking(bool nonBlocking)
 {
   u_long mode = nonBlocking ? 1 : 0;
   ioctl(m_socket, FIONBIO, &mode);
 }
 
+bool Socket::EnterNonBlocking()
+{
+  if (0 != (fcntl(m_socket, F_GETFL) & O_NONBLOCK))
+    return false;
+  SetNonBlocking(true);
+  return true;
+}
+
 bool Socket::Connect()
 {
   if (m_socket == INVALID_SOCKET) {
@@ -100,27 +206,79 @@ bool Socket::Connect()
     m_errors.push(lastError);
     return false;
   }
-  const sockaddr_in* addr = m_address->GetAddress();
   result =
-    connect(m_socket, (struct sockaddr*)addr, sizeof(struct sockaddr_in));
+    connect(m_socket, m_address->GetSockAddr(), m_address->GetLength());
   if (SOCKET_ERROR == result) {
     PlatformError lastError = errno;
-    m_errors.push(lastError);
-    return false;
+    // non-blocking connect completes later, see FinishConnect
+    if (lastError != EINPROGRESS) {
+      m_errors.push(lastError);
+      return false;
+    }
   }
 
   return true;
 }
 
+bool Socket::FinishConnect()
+{
+  PlatformError pending = 0;
+  socklen_t length = sizeof(pending);
+  if (SOCKET_ERROR ==
+      getsockopt(m_socket, SOL_SOCKET, SO_ERROR, &pending, &length)) {
+    pending = errno;
+  }
+  if (0 != pending) {
+    m_errors.push(pending);
+    return false;
+  }
+  return true;
+}
+
+PlatformError Socket::StaleSocketProbe() const
+{
+  // non-blocking, a live server with a full backlog answers EAGAIN
+  PlatformSocket probe =
+    socket(m_address->GetFamily(),
+           m_address->GetSocketType() | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+  if (INVALID_SOCKET == probe)
+    return errno;
+  PlatformError result = 0;
+  if (SOCKET_ERROR ==
+      connect(probe, m_address->GetSockAddr(), m_address->GetLength()))
+    result = errno;
+  close(probe);
+  return result;
+}
+
 bool Socket::Bind()
 {
-  const sockaddr_in* addr = m_address->GetAddress();
   ESP_LOGI("TELNET", "socket bind: %s", m_address->toString().c_str());
-  // reuse address in case server socket
-  PlatformSocket option = 1;
-  setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR, &option, sizeof(option));
+  if (m_address->IsLocal()) {
+    // a socket file outlives its listener, the same way SO_REUSEADDR lets
+    // a TCP port be bound again; only ever remove a socket, not a file,
+    // and only a stale one: a live server still accepts on it
+    const sockaddr_un* local =
+      reinterpret_cast<const sockaddr_un*>(m_address->GetSockAddr());
+    struct stat status;
+    if ('\0' != local->sun_path[0] && 0 == lstat(local->sun_path, &status) &&
+        S_ISSOCK(status.st_mode)) {
+      PlatformError probeError = StaleSocketProbe();
+      if (ECONNREFUSED != probeError) {
+        ESP_LOGE("TELNET", "%s is in use", local->sun_path);
+        m_errors.push(0 == probeError ? EADDRINUSE : probeError);
+        return false;
+      }
+      unlink(local->sun_path);
+    }
+  }
+  else {
+    // reuse address in case server socket
+    PlatformSocket option = 1;
+    setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR, &option, sizeof(option));
+  }
   PlatformError result =
-    bind(m_socket, (struct sockaddr*)addr, sizeof(struct sockaddr_in));
+    bind(m_socket, m_address->GetSockAddr(), m_address->GetLength());
   if (result == SOCKET_ERROR) {
     PlatformError lastError = errno;
     if (lastError != EAGAIN && lastError != EINPROGRESS) {
@@ -131,9 +289,9 @@ bool Socket::Bind()
   return true;
 }
 
-bool Socket::Listen()
+bool Socket::Listen(int backlog)
 {
-  PlatformError result = listen(m_socket, MAX_BACKLOG);
+  PlatformError result = listen(m_socket, backlog);
   if (result == SOCKET_ERROR) {
     PlatformError lastError = errno;
     if (lastError != EAGAIN && lastError != EINPROGRESS) {
@@ -146,19 +304,19 @@ bool Socket::Listen()
 
 SocketPtr Socket::Accept(std::chrono::milliseconds timeout)
 {
-  struct timeval tmval {
-    0, static_cast<suseconds_t>(
-         std::chrono::duration_cast<std::chrono::microseconds>(timeout).count())
-  };
-  fd_set rfds;
-  FD_ZERO(&rfds);
-  FD_SET(m_socket, &rfds);
-  PlatformError selectresult = select(
-    static_cast<int>(m_socket + 1), &rfds, (fd_set*)0, (fd_set*)0, &tmval);
-  if (selectresult > 0) {
+  if (WaitForEvents(m_socket, POLLIN, timeout) > 0) {
+    FT_TRACE_SPAN(span, "accept", 0);
     PlatformSocket newSocket = INVALID_SOCKET;
-    newSocket = accept(m_socket, nullptr, nullptr);
-    return CreateSocket(m_address, newSocket);
+    // on the stack, the peer is kept in the new socket by value
+    sockaddr_storage peer;
+    socklen_t peerLength = sizeof(peer);
+    newSocket = accept4(m_socket, reinterpret_cast<sockaddr*>(&peer),
+                        &peerLength, SOCK_CLOEXEC);
+    FT_TRACE_VALUE(span, newSocket);
+    SocketPtr accepted = CreateSocket(m_address, newSocket);
+    if (INVALID_SOCKET != newSocket)
+      accepted->SetPeer(peer);
+    return accepted;
   }
 
   return nullptr;
@@ -166,15 +324,13 @@ SocketPtr Socket::Accept(std::chrono::milliseconds timeout)
 
 bool Socket::IsReadyForRead(std::chrono::milliseconds timeout)
 {
-  fd_set socketSet;
-  FD_ZERO(&socketSet);
-  FD_SET(m_socket, &socketSet);
-  struct timeval tmval {
-    0, static_cast<suseconds_t>(
-         std::chrono::duration_cast<std::chrono::microseconds>(timeout).count())
-  };
-  PlatformError result = select(
-    static_cast<int>(m_socket + 1), &socketSet, (fd_set*)0, (fd_set*)0, &tmval);
+#ifdef FT_SOCKET_TLS
+  // decrypted bytes may already wait inside OpenSSL
+  if (m_ssl && SSL_pending(m_ssl) > 0)
+    return true;
+#endif
+  // a hang-up wakes the wait too, the next Receive() reports it
+  PlatformError result = WaitForEvents(m_socket, POLLIN | POLLRDHUP, timeout);
   if (result == SOCKET_ERROR) {
     PlatformError lastError = errno;
     m_errors.push(lastError);
@@ -185,15 +341,7 @@ bool Socket::IsReadyForRead(std::chrono::milliseconds timeout)
 
 bool Socket::IsReadyForWrite(std::chrono::milliseconds timeout)
 {
-  fd_set socketSet;
-  FD_ZERO(&socketSet);
-  FD_SET(m_socket, &socketSet);
-  struct timeval tmval {
-    0, static_cast<suseconds_t>(
-         std::chrono::duration_cast<std::chrono::microseconds>(timeout).count())
-  };
-  PlatformError result = select(
-    static_cast<int>(m_socket + 1), (fd_set*)0, &socketSet, (fd_set*)0, &tmval);
+  PlatformError result = WaitForEvents(m_socket, POLLOUT, timeout);
 
   if (result == SOCKET_ERROR) {
     PlatformError lastError = errno;
@@ -205,13 +353,36 @@ bool Socket::IsReadyForWrite(std::chrono::milliseconds timeout)
 
 size_t Socket::Receive(void* data, size_t bytes, uint32_t flags)
 {
+  FT_TRACE_SPAN(span, "recv", 0);
+  m_wouldBlock = false;
+#ifdef FT_SOCKET_TLS
+  if (m_ssl) {
+    int received = SSL_read(m_ssl, data, static_cast<int>(bytes));
+    FT_TRACE_VALUE(span, std::max(received, 0));
+    if (received <= 0) {
+      // part of a record, or a handshake message which isn't data
+      int error = SSL_get_error(m_ssl, received);
+      m_wouldBlock =
+        SSL_ERROR_WANT_READ == error || SSL_ERROR_WANT_WRITE == error;
+      // not an error, nothing drains the queue on this path
+      if (!m_wouldBlock)
+        m_errors.push(EPROTO);
+      return 0;
+    }
+    return static_cast<size_t>(received);
+  }
+#endif
   auto received =
     recv(m_socket, static_cast<char*>(data), static_cast<int>(bytes), flags);
   if (received == SOCKET_ERROR) {
     PlatformError lastError = errno;
-    m_errors.push(lastError);
+    m_wouldBlock = EAGAIN == lastError || EWOULDBLOCK == lastError ||
+                   EINTR == lastError;
+    if (!m_wouldBlock)
+      m_errors.push(lastError);
     return 0;
   }
+  FT_TRACE_VALUE(span, received);
   return static_cast<size_t>(received);
 }
 
@@ -220,6 +391,23 @@ bool Socket::Send(void* data, size_t bytes, uint32_t flags, size_t* bytesSent)
   if (nullptr == bytesSent) {
     return false;
   }
+  FT_TRACE_SPAN(span, "send", bytes);
+#ifdef FT_SOCKET_TLS
+  // with kTLS the kernel frames the records, plain send is enough
+  if (m_ssl && !m_kernelTlsSend) {
+    int written = SSL_write(m_ssl, data, static_cast<int>(bytes));
+    if (written <= 0) {
+      PlatformError lastError =
+        (SSL_ERROR_WANT_WRITE == SSL_get_error(m_ssl, written)) ? EAGAIN
+                                                                 : EPROTO;
+      ESP_LOGE("TELNET", "Error send %d", lastError);
+      m_errors.push(lastError);
+      return false;
+    }
+    *bytesSent += static_cast<size_t>(written);
+    return true;
+  }
+#endif
   ssize_t sent = send(m_socket, static_cast<const char*>(data),
                       static_cast<int>(bytes), flags);
   if (sent == SOCKET_ERROR || sent <= 0) {
@@ -232,13 +420,108 @@ bool Socket::Send(void* data, size_t bytes, uint32_t flags, size_t* bytesSent)
   return true;
 }
 
+bool Socket::WouldBlock() const
+{
+  return m_wouldBlock;
+}
+
+bool Socket::NeedsUserspaceCopy() const
+{
+  return m_ssl && !m_kernelTlsSend;
+}
+
+bool Socket::SendFile(int fd, off_t* offset, size_t bytes, size_t* bytesSent)
+{
+  if (nullptr == bytesSent || nullptr == offset) {
+    return false;
+  }
+  if (NeedsUserspaceCopy()) {
+    // userspace TLS has to see the plaintext, in-process transports the bytes
+    char chunk[USERSPACE_COPY_CHUNK];
+    ssize_t got = pread(fd, chunk, std::min(bytes, sizeof(chunk)), *offset);
+    if (got <= 0) {
+      m_errors.push((0 == got) ? EIO : errno);
+      return false;
+    }
+    size_t sent = 0;
+    if (!Send(chunk, static_cast<size_t>(got), MSG_NOSIGNAL, &sent))
+      return false;
+    *offset += static_cast<off_t>(sent);
+    *bytesSent += sent;
+    return true;
+  }
+  FT_TRACE_SPAN(span, "sendfile", bytes);
+  bool wasBlocking = EnterNonBlocking();
+  ssize_t sent = sendfile(m_socket, fd, offset, bytes);
+  PlatformError lastError = errno;
+  if (wasBlocking)
+    SetNonBlocking(false);
+  // the socket buffer is full, the rest goes on the next flush
+  if (sent < 0 && (EAGAIN == lastError || EWOULDBLOCK == lastError))
+    return true;
+  if (sent <= 0) {
+    // sendfile returns 0 when the file is shorter than announced
+    m_errors.push((0 == sent) ? EIO : lastError);
+    return false;
+  }
+  *bytesSent += static_cast<size_t>(sent);
+  return true;
+}
+
+bool Socket::Splice(int pipeFd, size_t bytes, size_t* bytesSent,
+                    bool* endOfStream)
+{
+  if (nullptr == bytesSent || nullptr == endOfStream) {
+    return false;
+  }
+  ssize_t moved;
+  if (NeedsUserspaceCopy()) {
+    // the pipe may be blocking and it's the caller's, a slow writer must
+    // not hold up the client loop: read only what is there already
+    if (0 == WaitForEvents(pipeFd, POLLIN, std::chrono::microseconds(0))) {
+      *endOfStream = false;
+      return true;
+    }
+    char chunk[USERSPACE_COPY_CHUNK];
+    moved = read(pipeFd, chunk, std::min(bytes, sizeof(chunk)));
+    if (moved > 0) {
+      size_t sent = 0;
+      if (!Send(chunk, static_cast<size_t>(moved), MSG_NOSIGNAL, &sent))
+        return false;
+    }
+  }
+  else {
+    FT_TRACE_SPAN(span, "splice", bytes);
+    // SPLICE_F_NONBLOCK is for the pipe, the socket's own flag counts too
+    bool wasBlocking = EnterNonBlocking();
+    moved = splice(pipeFd, nullptr, m_socket, nullptr, bytes,
+                   SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    PlatformError lastError = errno;
+    if (wasBlocking)
+      SetNonBlocking(false);
+    errno = lastError;
+  }
+  if (moved < 0) {
+    PlatformError lastError = errno;
+    // nothing in the pipe yet or a full socket buffer, try again on the
+    // next flush
+    if (lastError == EAGAIN)
+      return true;
+    m_errors.push(lastError);
+    return false;
+  }
+  *endOfStream = (0 == moved);
+  *bytesSent += static_cast<size_t>(moved);
+  return true;
+}
+
 bool Socket::SendDatagram(const void* data, size_t bytes)
 {
   if (nullptr == data || IPProto::eUDP != m_address->GetProto()) {
     return false;
   }
-  const sockaddr_in* addr = m_address->GetAddress();
-  int sended = sendto(m_socket, data, bytes, MSG_NOSIGNAL, (struct sockaddr*)addr, sizeof(sockaddr_in));
+  int sended = sendto(m_socket, data, bytes, MSG_NOSIGNAL,
+                      m_address->GetSockAddr(), m_address->GetLength());
   bool res = (sended > -1);
   if (!res)
   {
@@ -248,6 +531,353 @@ bool Socket::SendDatagram(const void* data, size_t bytes)
   return res;
 }
 
+size_t Socket::ReceiveDatagram(void* data, size_t bytes, std::string* sender)
+{
+  sockaddr_in from{};
+  socklen_t length = sizeof(from);
+  ssize_t received =
+    recvfrom(m_socket, data, bytes, 0, (struct sockaddr*)&from, &length);
+  if (received == SOCKET_ERROR) {
+    PlatformError lastError = errno;
+    m_errors.push(lastError);
+    return 0;
+  }
+  if (sender) {
+    char host[INET_ADDRSTRLEN] = "";
+    inet_ntop(AF_INET, &from.sin_addr, host, sizeof(host));
+    *sender = host;
+  }
+  return static_cast<size_t>(received);
+}
+
+bool Socket::StartTls(TlsContextPtr context, std::chrono::milliseconds timeout)
+{
+#ifdef FT_SOCKET_TLS
+  if (m_socket == INVALID_SOCKET || m_ssl || !context || !context->IsValid()) {
+    return false;
+  }
+  m_tlsContext = context;
+  m_ssl = SSL_new(context->GetContext());
+  BIO* bio = BIO_new(TlsContext::GetSocketMethod());
+  BIO_set_fd(bio, m_socket, BIO_NOCLOSE);
+  SSL_set_bio(m_ssl, bio, bio);
+  if (context->IsServer()) {
+    SSL_set_accept_state(m_ssl);
+  }
+  else {
+    SSL_set_connect_state(m_ssl);
+    if (!context->GetHostName().empty())
+      SSL_set_tlsext_host_name(m_ssl, context->GetHostName().c_str());
+    SSL_SESSION* session = context->AcquireSession();
+    if (session) {
+      SSL_set_session(m_ssl, session);
+      SSL_SESSION_free(session);
+    }
+  }
+
+  // a blocking SSL_do_handshake() would wait for a silent peer forever,
+  // the deadline only holds when every step returns to us
+  bool wasBlocking = 0 == (fcntl(m_socket, F_GETFL) & O_NONBLOCK);
+  if (wasBlocking)
+    SetNonBlocking(true);
+  auto deadline = std::chrono::steady_clock::now() + timeout;
+  int result;
+  while (1 != (result = SSL_do_handshake(m_ssl))) {
+    int error = SSL_get_error(m_ssl, result);
+    auto left = std::chrono::duration_cast<std::chrono::microseconds>(
+      deadline - std::chrono::steady_clock::now());
+    PlatformError lastError = EPROTO;
+    if (SSL_ERROR_WANT_READ == error || SSL_ERROR_WANT_WRITE == error) {
+      short events = (SSL_ERROR_WANT_READ == error) ? POLLIN : POLLOUT;
+      if (left.count() > 0 && WaitForEvents(m_socket, events, left) > 0)
+        continue;
+      lastError = ETIMEDOUT;
+    }
+    ESP_LOGE("TLS", "handshake failed %d: %lu", lastError, ERR_get_error());
+    m_errors.push(lastError);
+    SSL_free(m_ssl);
+    m_ssl = nullptr;
+    if (wasBlocking)
+      SetNonBlocking(false);
+    return false;
+  }
+  if (wasBlocking)
+    SetNonBlocking(false);
+  m_kernelTlsSend = BIO_get_ktls_send(SSL_get_wbio(m_ssl));
+  // kTLS records, close_notify included, go out through the stock socket
+  // BIO without MSG_NOSIGNAL
+  if (m_kernelTlsSend)
+    IgnoreBrokenPipe();
+  return true;
+#else
+  m_errors.push(EPROTONOSUPPORT);
+  return false;
+#endif
+}
+
+bool Socket::SetBusyPoll(int microseconds)
+{
+  PlatformError result = setsockopt(m_socket, SOL_SOCKET, SO_BUSY_POLL,
+                                    &microseconds, sizeof(microseconds));
+  if (SOCKET_ERROR == result) {
+    // above net.core.busy_read it needs CAP_NET_ADMIN
+    PlatformError lastError = errno;
+    m_errors.push(lastError);
+    return false;
+  }
+  return true;
+}
+
+static bool SetIntOption(PlatformSocket socket, int level, int name, int value,
+                         std::queue<PlatformError>& errors)
+{
+  if (SOCKET_ERROR ==
+      setsockopt(socket, level, name, &value, sizeof(value))) {
+    errors.push(errno);
+    return false;
+  }
+  return true;
+}
+
+bool Socket::ApplyOptions(const SocketOptions& options)
+{
+  bool result = true;
+  if (options.sendBuffer > 0)
+    result &= SetIntOption(m_socket, SOL_SOCKET, SO_SNDBUF, options.sendBuffer,
+                           m_errors);
+  if (options.receiveBuffer > 0)
+    result &= SetIntOption(m_socket, SOL_SOCKET, SO_RCVBUF,
+                           options.receiveBuffer, m_errors);
+  // the rest is TCP's, a unix socket has no segments to tune
+  if (IsLocal())
+    return result;
+  if (options.noDelay)
+    result &= SetIntOption(m_socket, IPPROTO_TCP, TCP_NODELAY, 1, m_errors);
+  if (options.keepAlive) {
+    result &= SetIntOption(m_socket, SOL_SOCKET, SO_KEEPALIVE, 1, m_errors);
+    if (options.keepAliveIdle > 0)
+      result &= SetIntOption(m_socket, IPPROTO_TCP, TCP_KEEPIDLE,
+                             options.keepAliveIdle, m_errors);
+    if (options.keepAliveInterval > 0)
+      result &= SetIntOption(m_socket, IPPROTO_TCP, TCP_KEEPINTVL,
+                             options.keepAliveInterval, m_errors);
+    if (options.keepAliveCount > 0)
+      result &= SetIntOption(m_socket, IPPROTO_TCP, TCP_KEEPCNT,
+                             options.keepAliveCount, m_errors);
+  }
+  if (options.userTimeout >= 0)
+    result &= SetIntOption(m_socket, IPPROTO_TCP, TCP_USER_TIMEOUT,
+                           options.userTimeout, m_errors);
+  if (options.notSentLowat > 0)
+    result &= SetIntOption(m_socket, IPPROTO_TCP, TCP_NOTSENT_LOWAT,
+                           options.notSentLowat, m_errors);
+  return result;
+}
+
+bool Socket::SetCork(bool cork)
+{
+  if (IsLocal())
+    return false;
+  return SetIntOption(m_socket, IPPROTO_TCP, TCP_CORK, cork ? 1 : 0,
+                      m_errors);
+}
+
+SocketOptions SocketOptions::Interactive()
+{
+  SocketOptions options;
+  options.noDelay = true;
+  options.cork = true;
+  options.keepAlive = true;
+  options.keepAliveIdle = 60;
+  options.keepAliveInterval = 10;
+  options.keepAliveCount = 6;
+  options.userTimeout = 30000;
+  return options;
+}
+
+SocketOptions SocketOptions::Bulk()
+{
+  SocketOptions options;
+  options.sendBuffer = 1024 * 1024;
+  options.receiveBuffer = 256 * 1024;
+  options.notSentLowat = 128 * 1024;
+  options.cork = true;
+  return options;
+}
+
+int Socket::GetIncomingCpu() const
+{
+  int cpu = -1;
+  socklen_t length = sizeof(cpu);
+  if (SOCKET_ERROR ==
+      getsockopt(m_socket, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &length))
+    return -1;
+  return cpu;
+}
+
+int Socket::GetSendBufferSize() const
+{
+  if (m_socket == INVALID_SOCKET)
+    return -1;
+  int size = 0;
+  socklen_t length = sizeof(size);
+  if (SOCKET_ERROR ==
+      getsockopt(m_socket, SOL_SOCKET, SO_SNDBUF, &size, &length))
+    return -1;
+  return size;
+}
+
+// "" is INADDR_ANY
+static bool ParseIPv4(const std::string& text, in_addr* address)
+{
+  if (text.empty()) {
+    address->s_addr = htonl(INADDR_ANY);
+    return true;
+  }
+  return 1 == inet_pton(AF_INET, text.c_str(), address);
+}
+
+static bool ChangeMembership(PlatformSocket socket, int name,
+                             const std::string& group,
+                             const std::string& interfaceIp,
+                             std::queue<PlatformError>& errors)
+{
+  ip_mreq request;
+  if (!ParseIPv4(group, &request.imr_multiaddr) ||
+      !ParseIPv4(interfaceIp, &request.imr_interface)) {
+    errors.push(EINVAL);
+    return false;
+  }
+  if (SOCKET_ERROR ==
+      setsockopt(socket, IPPROTO_IP, name, &request, sizeof(request))) {
+    errors.push(errno);
+    return false;
+  }
+  return true;
+}
+
+bool Socket::JoinGroup(const std::string& group, const std::string& interfaceIp)
+{
+  // Linux delivers every joined group to all sockets on the port otherwise
+  return SetIntOption(m_socket, IPPROTO_IP, IP_MULTICAST_ALL, 0, m_errors) &&
+         ChangeMembership(m_socket, IP_ADD_MEMBERSHIP, group, interfaceIp,
+                          m_errors);
+}
+
+bool Socket::LeaveGroup(const std::string& group,
+                        const std::string& interfaceIp)
+{
+  return ChangeMembership(m_socket, IP_DROP_MEMBERSHIP, group, interfaceIp,
+                          m_errors);
+}
+
+bool Socket::SetMulticastTtl(int ttl)
+{
+  return SetIntOption(m_socket, IPPROTO_IP, IP_MULTICAST_TTL, ttl, m_errors);
+}
+
+bool Socket::SetMulticastInterface(const std::string& interfaceIp)
+{
+  in_addr address;
+  if (!ParseIPv4(interfaceIp, &address)) {
+    m_errors.push(EINVAL);
+    return false;
+  }
+  if (SOCKET_ERROR == setsockopt(m_socket, IPPROTO_IP, IP_MULTICAST_IF,
+                                 &address, sizeof(address))) {
+    m_errors.push(errno);
+    return false;
+  }
+  return true;
+}
+
+bool Socket::SetMulticastLoopback(bool loopback)
+{
+  return SetIntOption(m_socket, IPPROTO_IP, IP_MULTICAST_LOOP,
+                      loopback ? 1 : 0, m_errors);
+}
+
+bool Socket::GetTcpInfo(TcpInfo* info) const
+{
+  if (INVALID_SOCKET == m_socket || IsLocal())
+    return false;
+  tcp_info kernel;
+  socklen_t length = sizeof(kernel);
+  if (SOCKET_ERROR ==
+      getsockopt(m_socket, IPPROTO_TCP, TCP_INFO, &kernel, &length))
+    return false;
+  info->rttMicroseconds = kernel.tcpi_rtt;
+  info->rttVarMicroseconds = kernel.tcpi_rttvar;
+  info->retransmits = kernel.tcpi_total_retrans;
+  info->unackedSegments = kernel.tcpi_unacked;
+  info->lostSegments = kernel.tcpi_lost;
+  info->congestionWindow = kernel.tcpi_snd_cwnd;
+  info->lastReceiveMilliseconds = kernel.tcpi_last_data_recv;
+  // the send queue holds both, SIOCOUTQNSD counts the part not sent yet
+  int queued = 0;
+  int unsent = 0;
+  if (SOCKET_ERROR != ioctl(m_socket, SIOCOUTQ, &queued) &&
+      SOCKET_ERROR != ioctl(m_socket, SIOCOUTQNSD, &unsent)) {
+    info->unsentBytes = unsent;
+    info->unackedBytes = std::max(queued - unsent, 0);
+  }
+  return true;
+}
+
+bool Socket::GetPeerCredentials(pid_t* pid, uid_t* uid, gid_t* gid) const
+{
+  if (!IsLocal())
+    return false;
+  // the peer's credentials as of its connect(), the kernel vouches for them
+  ucred credentials;
+  socklen_t length = sizeof(credentials);
+  if (SOCKET_ERROR ==
+      getsockopt(m_socket, SOL_SOCKET, SO_PEERCRED, &credentials, &length)) {
+    m_errors.push(errno);
+    return false;
+  }
+  if (pid)
+    *pid = credentials.pid;
+  if (uid)
+    *uid = credentials.uid;
+  if (gid)
+    *gid = credentials.gid;
+  return true;
+}
+
+bool Socket::IsLocal() const
+{
+  return m_address && m_address->IsLocal();
+}
+
+bool Socket::IsTls() const
+{
+  return nullptr != m_ssl;
+}
+
+bool Socket::IsTlsResumed() const
+{
+#ifdef FT_SOCKET_TLS
+  return m_ssl && SSL_session_reused(m_ssl);
+#else
+  return false;
+#endif
+}
+
+bool Socket::IsKernelTls() const
+{
+  return m_kernelTlsSend;
+}
+
+void Socket::IgnoreBrokenPipe()
+{
+  struct sigaction current;
+  if (0 != sigaction(SIGPIPE, nullptr, &current) ||
+      (current.sa_flags & SA_SIGINFO) || SIG_DFL != current.sa_handler)
+    return;
+  signal(SIGPIPE, SIG_IGN);
+}
+
 SocketPtr Socket::CreateSocket(AddressPtr address)
 {
   return std::make_shared<Socket>(address);
@@ -1,6 +1,7 @@
 #include "ft-socket/ft_socket_address.hpp"
 
 #include <cstring>
+#include <sys/un.h>
 
 namespace FtTCP {
 
@@ -36,8 +37,41 @@ Address::Address(const int port, const bool async, IPProto proto)
   FillPresentation();
 }
 
+Address::Address(const std::string& path, const bool isListener,
+                 const bool isAbstract)
+  : m_host{path}, m_port{0}, m_isListener{isListener}, m_isAsync{false},
+    m_proto{IPProto::eLocal}, m_sockType{SOCK_STREAM}
+{
+  FillLocal(isAbstract);
+}
+
+void Address::FillLocal(bool isAbstract)
+{
+  memset(&m_address, 0, sizeof(m_address));
+  sockaddr_un& local = *reinterpret_cast<sockaddr_un*>(&m_address);
+  local.sun_family = AF_UNIX;
+  // the abstract name follows a NUL and isn't NUL terminated itself
+  std::size_t offset = isAbstract ? 1 : 0;
+  m_isValid = !m_host.empty() &&
+              m_host.size() + offset + (isAbstract ? 0 : 1) <=
+                sizeof(local.sun_path);
+  if (!m_isValid) {
+    m_length = 0;
+    m_presentation =
+      m_host.empty() ? "[empty]" : "unix:" + m_host + " path too long";
+    return;
+  }
+  memcpy(local.sun_path + offset, m_host.data(), m_host.size());
+  m_length = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) +
+                                    offset + m_host.size() +
+                                    (isAbstract ? 0 : 1));
+  m_presentation = std::string(isAbstract ? "unix:@" : "unix:") + m_host;
+}
+
 void Address::FillPresentation()
 {
+  sockaddr_in& address4 = *reinterpret_cast<sockaddr_in*>(&m_address);
+  m_length = sizeof(sockaddr_in);
   m_isValid = false;
   if (IsEmpty()) {
     m_presentation = "[empty]";
@@ -59,12 +93,12 @@ void Address::FillPresentation()
       m_host.c_str(), std::to_string(m_port).c_str(), &hints, &address);
     if (0 == res) {
       
-      m_address = *(reinterpret_cast<sockaddr_in*>(address->ai_addr));
-      m_address.sin_family = AF_INET;
-      m_address.sin_port = htons(m_port);
+      address4 = *(reinterpret_cast<sockaddr_in*>(address->ai_addr));
+      address4.sin_family = AF_INET;
+      address4.sin_port = htons(m_port);
       m_isValid = true;
       if (m_isValid) {
-        inet_ntop(m_address.sin_family, &m_address.sin_addr, ipstr,
+        inet_ntop(address4.sin_family, &address4.sin_addr, ipstr,
                   INET_ADDRSTRLEN);
       }
       else {
@@ -74,9 +108,9 @@ void Address::FillPresentation()
     freeaddrinfo(address);
   }
   else {
-    m_address.sin_addr.s_addr = htonl(INADDR_ANY);
-    m_address.sin_family = AF_INET;
-    m_address.sin_port = htons(m_port);
+    address4.sin_addr.s_addr = htonl(INADDR_ANY);
+    address4.sin_family = AF_INET;
+    address4.sin_port = htons(m_port);
     m_isValid = true;
     strncpy(ipstr, "[any address]", INET_ADDRSTRLEN);
   }
@@ -94,6 +128,9 @@ void Address::FillPresentation()
 
 bool Address::IsEmpty() const noexcept
 {
+  if (IPProto::eLocal == m_proto) {
+    return m_host.empty();
+  }
   if (m_isListener) {
     return (m_port < 1);
   }
@@ -114,7 +151,33 @@ std::string Address::toString() const
 
 const sockaddr_in* Address::GetAddress() const
 {
-  return &m_address;
+  return reinterpret_cast<const sockaddr_in*>(&m_address);
+}
+
+const sockaddr* Address::GetSockAddr() const
+{
+  return reinterpret_cast<const sockaddr*>(&m_address);
+}
+
+socklen_t Address::GetLength() const
+{
+  return m_length;
+}
+
+int Address::GetFamily() const
+{
+  return m_address.ss_family;
+}
+
+bool Address::IsLocal() const
+{
+  return AF_UNIX == m_address.ss_family;
+}
+
+bool Address::IsMulticast() const
+{
+  return AF_INET == m_address.ss_family &&
+         IN_MULTICAST(ntohl(GetAddress()->sin_addr.s_addr));
 }
 
 IPProto Address::GetProto() const
@@ -137,6 +200,22 @@ AddressPtr Address::CreateListenerAddress(const int port, const bool isAsync)
   return std::make_shared<Address>(port, isAsync);
 }
 
+AddressPtr Address::CreateUnixAddress(const std::string& path,
+                                      const bool isListener)
+{
+  bool isAbstract = !path.empty() && '@' == path[0];
+  return std::make_shared<Address>(isAbstract ? path.substr(1) : path,
+                                   isListener, isAbstract);
+}
+
+AddressPtr Address::CreateMulticastAddress(const char* group, const int port)
+{
+  AddressPtr address = std::make_shared<Address>(group, port, FtTCP::eUDP);
+  if (!address->IsMulticast())
+    address->m_isValid = false;
+  return address;
+}
+
 AddressPtr Address::CreateBroadcastAddress(const char* self_ip, const int port)
 {
   char masked[INET_ADDRSTRLEN];
@@ -1,46 +1,335 @@
 #include "ft-socket/ft_socket_queues.hpp"
 
+#include "ft-socket/ft_trace.hpp"
+
+#include <algorithm>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
 namespace FtTCP {
 
-bool SocketSendQueue::Send(SocketPtr socket)
+SocketSendQueue::~SocketSendQueue()
 {
   std::lock_guard<std::mutex> lock(m_mutex);
-  if (m_queue.empty())
-    return true;
+  while (!m_queue.empty())
+    PopFront();
+}
 
-  Buffer buffer = m_queue.front();
-  size_t bytesSent = 0;
-  if (!socket->Send(&buffer[m_sent], buffer.size() - m_sent, 0,
-                    &bytesSent))
-    return false;
-  m_sent += bytesSent;
-  if (m_sent == buffer.size()) {
+void SocketSendQueue::Release(SendSegment& segment)
+{
+  if (segment.fd != -1)
+    close(segment.fd);
+  std::size_t capacity = segment.buffer.capacity();
+  m_held -= capacity;
+  if (m_budget)
+    m_budget->Remove(capacity);
+}
+
+void SocketSendQueue::PopFront()
+{
+  Release(m_queue.front());
+  m_queue.pop_front();
+}
+
+void SocketSendQueue::NoteWrite(size_t size)
+{
+  m_writeAverage = m_writeAverage ? (m_writeAverage * 3 + size) / 4 : size;
+}
+
+size_t SocketSendQueue::ChunkSize() const
+{
+  // a power of two from the floor, the pool has classes for those
+  size_t chunk = m_minChunk;
+  while (chunk < m_writeAverage && chunk < m_maxChunk)
+    chunk *= 2;
+  chunk = std::min(chunk, m_maxChunk);
+  // bigger than the socket takes at once would only wait in memory
+  if (m_sendSpace)
+    chunk = std::min(chunk, std::max(m_sendSpace, m_minChunk));
+  if (chunk > m_minChunk && m_budget && !m_budget->HasRoom(chunk))
+    chunk = m_minChunk;
+  return chunk;
+}
+
+void SocketSendQueue::Hold(const Buffer& buffer)
+{
+  m_held += buffer.capacity();
+  if (m_budget)
+    m_budget->Add(buffer.capacity());
+}
+
+bool SocketSendQueue::Send(SocketPtr socket, size_t* bytesSent,
+                           size_t maxBytes)
+{
+  // the front segment leaves the queue for the syscall, pushes from other
+  // threads don't wait for the socket meanwhile
+  SendSegment segment;
+  bool queuedBehind = false;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_queue.empty())
+      return true;
+    segment = std::move(m_queue.front());
     m_queue.pop_front();
-    m_sent = 0;
+    queuedBehind = !m_queue.empty();
   }
-  return true;
+
+  size_t sent = 0;
+  bool ok = true;
+  bool done = false;
+  switch (segment.kind) {
+  case SendSegment::File: {
+    size_t chunk = std::min({segment.remaining, MAX_STREAM_CHUNK, maxBytes});
+    ok = socket->SendFile(segment.fd, &segment.offset, chunk, &sent);
+    segment.remaining -= sent;
+    done = ok && 0 == segment.remaining;
+    break;
+  }
+  case SendSegment::Pipe: {
+    bool endOfStream = false;
+    size_t chunk = std::min({segment.remaining, MAX_STREAM_CHUNK, maxBytes});
+    ok = socket->Splice(segment.fd, chunk, &sent, &endOfStream);
+    segment.remaining -= sent;
+    done = ok && (endOfStream || 0 == segment.remaining);
+    break;
+  }
+  case SendSegment::Bytes:
+  default: {
+    Buffer& buffer = segment.buffer;
+    size_t bytes = std::min(buffer.size() - m_sent, maxBytes);
+    // the last part, or the last one the caller allows, pushes the
+    // segment out
+    bool more = m_cork && queuedBehind && bytes < maxBytes;
+    ok = socket->Send(&buffer[m_sent], bytes,
+                      MSG_NOSIGNAL | (more ? MSG_MORE : 0), &sent);
+    m_sent += sent;
+    done = ok && m_sent == buffer.size();
+    if (done)
+      m_sent = 0;
+    break;
+  }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (done)
+      Release(segment);
+    else
+      m_queue.push_front(std::move(segment));
+  }
+  if (ok && bytesSent)
+    *bytesSent += sent;
+  return ok;
 }
 
-void SocketSendQueue::Push(const void* source, size_t size)
+void SocketSendQueue::Append(const void* source, size_t size)
 {
-  if (0 == size)
-    return;
-
-  std::lock_guard<std::mutex> lock(m_mutex);
   std::byte* pointer = (std::byte*)source;
   size_t remainder = size;
+  // top up the last chunk before taking a new one from the pool
+  if (!m_queue.empty() && SendSegment::Bytes == m_queue.back().kind) {
+    size_t taken = m_queue.back().buffer.append(pointer, remainder);
+    pointer += taken;
+    remainder -= taken;
+  }
+  size_t chunk = remainder ? ChunkSize() : 0;
   while (remainder) {
-    size_t bytesToWrite = std::min(remainder, MAX_SEND_BUFFER);
-    Buffer buffer(pointer, pointer + bytesToWrite);
-    m_queue.push_back(std::move(buffer));
+    size_t bytesToWrite = std::min(remainder, chunk);
+    SendSegment segment;
+    segment.buffer.reserve(chunk);
+    segment.buffer.append(pointer, bytesToWrite);
+    Hold(segment.buffer);
+    m_queue.push_back(std::move(segment));
     pointer += bytesToWrite;
     remainder -= bytesToWrite;
   }
 }
 
+void SocketSendQueue::AppendData(const void* source, size_t size)
+{
+  if (!m_deflater) {
+    Append(source, size);
+    return;
+  }
+  std::string_view compressed = m_deflater->Compress(source, size, false);
+  Append(compressed.data(), compressed.size());
+}
+
+void SocketSendQueue::Push(const void* source, size_t size)
+{
+  if (0 == size)
+    return;
+
+  // includes waiting for the lock, Send() only holds it between syscalls
+  FT_TRACE_SPAN(span, "enqueue", size);
+  std::lock_guard<std::mutex> lock(m_mutex);
+  NoteWrite(size);
+  AppendData(source, size);
+}
+
+void SocketSendQueue::Push(Buffer&& buffer)
+{
+  if (buffer.empty())
+    return;
+
+  FT_TRACE_SPAN(span, "enqueue", buffer.size());
+  std::lock_guard<std::mutex> lock(m_mutex);
+  NoteWrite(buffer.size());
+  if (m_deflater) {
+    AppendData(buffer.data(), buffer.size());
+    return;
+  }
+  // a small one still tops up the last chunk
+  if (!m_queue.empty() && SendSegment::Bytes == m_queue.back().kind) {
+    Buffer& last = m_queue.back().buffer;
+    if (last.capacity() - last.size() >= buffer.size()) {
+      last.append(buffer.data(), buffer.size());
+      return;
+    }
+  }
+  SendSegment segment;
+  segment.buffer = std::move(buffer);
+  Hold(segment.buffer);
+  m_queue.push_back(std::move(segment));
+}
+
+void SocketSendQueue::Push(const void* prefix, size_t prefixSize,
+                           const void* source, size_t size)
+{
+  FT_TRACE_SPAN(span, "enqueue", prefixSize + size);
+  std::lock_guard<std::mutex> lock(m_mutex);
+  NoteWrite(prefixSize + size);
+  AppendData(prefix, prefixSize);
+  AppendData(source, size);
+}
+
+bool SocketSendQueue::PushDescriptor(SendSegment::Kind kind, int fd,
+                                     off_t offset, size_t length)
+{
+  if (0 == length)
+    return true;
+  // the queue owns its own descriptor, the caller may close theirs
+  int owned = dup(fd);
+  if (-1 == owned)
+    return false;
+
+  SendSegment segment;
+  segment.kind = kind;
+  segment.fd = owned;
+  segment.offset = offset;
+  segment.remaining = length;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_queue.push_back(std::move(segment));
+  return true;
+}
+
+bool SocketSendQueue::PushFile(int fd, off_t offset, size_t length)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_deflater) {
+      // sendfile would bypass the compressor
+      char chunk[COMPRESS_FILE_CHUNK];
+      while (length) {
+        ssize_t got = pread(fd, chunk, std::min(length, sizeof(chunk)), offset);
+        if (got <= 0)
+          return false;
+        AppendData(chunk, static_cast<size_t>(got));
+        offset += got;
+        length -= static_cast<size_t>(got);
+      }
+      return true;
+    }
+  }
+  return PushDescriptor(SendSegment::File, fd, offset, length);
+}
+
+bool SocketSendQueue::PushPipe(int pipeFd, size_t length)
+{
+  if (IsCompressed())
+    return false;
+  return PushDescriptor(SendSegment::Pipe, pipeFd, 0, length);
+}
+
 bool SocketSendQueue::IsEmpty()
 {
   std::lock_guard<std::mutex> lock(m_mutex);
   return m_queue.empty();
 }
+
+void SocketSendQueue::SetCork(bool cork)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_cork = cork;
+}
+
+void SocketSendQueue::SetSizing(size_t minChunk, size_t maxChunk,
+                                MemoryBudgetPtr budget)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_minChunk = std::max<size_t>(minChunk, 1);
+  m_maxChunk = std::max(maxChunk, m_minChunk);
+  // what is queued already moves over to the new budget
+  if (m_budget)
+    m_budget->Remove(m_held);
+  m_budget = std::move(budget);
+  if (m_budget)
+    m_budget->Add(m_held);
+}
+
+void SocketSendQueue::SetSendSpace(size_t bytes)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_sendSpace = bytes;
+}
+
+size_t SocketSendQueue::GetHeldBytes()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_held;
+}
+
+bool SocketSendQueue::StartCompression(const void* marker, size_t size,
+                                       const CompressionParameters& params)
+{
+  auto deflater = std::make_unique<Deflater>(params);
+  if (!deflater->IsValid())
+    return false;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_deflater)
+    return false;
+  Append(marker, size);
+  m_deflater = std::move(deflater);
+  return true;
+}
+
+bool SocketSendQueue::IsCompressed()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return nullptr != m_deflater;
+}
+
+bool SocketSendQueue::HasUnflushedCompression()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_deflater && m_deflater->HasUnflushed();
+}
+
+void SocketSendQueue::FlushCompression()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_deflater || !m_deflater->HasUnflushed())
+    return;
+  std::string_view compressed = m_deflater->Compress(nullptr, 0, true);
+  Append(compressed.data(), compressed.size());
+}
+
+void SocketSendQueue::GetCompressionCounters(uint64_t* bytesIn,
+                                             uint64_t* bytesOut)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  *bytesIn = m_deflater ? m_deflater->BytesIn() : 0;
+  *bytesOut = m_deflater ? m_deflater->BytesOut() : 0;
+}
 } // namespace FtTCP
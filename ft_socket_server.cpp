@@ -1,22 +1,123 @@
 #include "ft-socket/ft_socket_server.hpp"
 
 #include "esp_log.h"
+#include "ft-socket/ft_fd_passing.hpp"
+#include "ft-socket/ft_trace.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <tuple>
+#include <errno.h>
+#include <unistd.h>
 
 namespace FtTCP {
+
+namespace {
+// one record per passed descriptor: the header carries the first listener,
+// how many listeners there are and the client count; the other listeners
+// follow it, then the clients
+struct HandoffRecord {
+  uint32_t magic;
+  // clients after the listeners, header only
+  uint32_t count;
+  // client records only
+  uint64_t handle;
+  uint8_t authenticated;
+  uint16_t listener;
+  // header only
+  uint16_t listeners;
+};
+
+// "FTH1" carried the listener count in the header's handle
+constexpr uint32_t HANDOFF_MAGIC{0x46544832}; // "FTH2"
+
+FrameFormat FrameFormatOf(Protocol protocol)
+{
+  return ProtocolFixed32Frames == protocol ? FrameFixed32 : FrameVarint;
+}
+} // namespace
+
 Server::Server(const ServerParameters& params)
 {
   m_parameters = params;
   m_stage = Stage::Initializing;
+  std::vector<ListenerParameters> listeners = m_parameters.listeners;
+  if (listeners.empty()) {
+    ListenerParameters single;
+    single.port = m_parameters.port;
+    single.unixPath = m_parameters.unixPath;
+    single.transport = m_parameters.transport;
+    single.protocol = m_parameters.protocol;
+    listeners.push_back(single);
+  }
+  for (const auto& parameters : listeners) {
+    auto listener = std::make_unique<Listener>();
+    listener->parameters = parameters;
+    m_listeners.push_back(std::move(listener));
+  }
+  const RateLimit& accepts = m_parameters.limits.accepts;
+  m_accepts = TokenBucket(accepts.rate, accepts.burst);
+  m_bufferBudget =
+    std::make_shared<MemoryBudget>(m_parameters.buffers.memoryBudget);
+  const AccessParameters& access = m_parameters.access;
+  m_accessRules = CidrTable(access.allowByDefault);
+  for (const auto& rule : access.allow) {
+    if (!m_accessRules.Add(rule, true))
+      ESP_LOGW(TAG, "allow rule %s ignored", rule.c_str());
+  }
+  for (const auto& rule : access.deny) {
+    if (!m_accessRules.Add(rule, false))
+      ESP_LOGW(TAG, "deny rule %s ignored", rule.c_str());
+  }
+  m_accessRules.Build();
+  m_addressCounts =
+    AddressCounter(access.maxPerAddress, m_parameters.maxConnections);
+  if (m_parameters.batch.enabled) {
+    m_batcher = std::make_unique<ReceiveBatcher>(
+      m_parameters.batch,
+      [this](ReceiveBatch batch) { NotifyReceiveBatch(batch); },
+      m_parameters.callbackThreads);
+  }
+  if (m_parameters.resume.enabled) {
+    m_resumeTable = std::make_unique<ResumeTable>(
+      m_parameters.resume.maxSessions, m_parameters.resume.ttl);
+  }
+  m_authPool = WorkerPool::CreateWorkerPool(
+    std::max<unsigned short int>(m_parameters.authWorkers, 1),
+    AUTH_QUEUE_SIZE, m_parameters.callbackThreads);
+  if (m_parameters.callbackWorkers) {
+    m_callbackPool = WorkerPool::CreateWorkerPool(
+      m_parameters.callbackWorkers, m_parameters.callbackQueueSize,
+      m_parameters.callbackThreads);
+  }
 }
 
 Server::~Server()
 {
   Stop();
+  if (m_batcher)
+    m_batcher->Stop();
+  m_authPool->Stop();
+  if (m_callbackPool)
+    m_callbackPool->Stop();
 }
 
 void Server::Start()
 {
   m_stage = Server::Stage::Initializing;
+  Socket::IgnoreBrokenPipe();
+  {
+    // clients taken over from a previous process get their threads now
+    std::lock_guard<std::mutex> lock(m_listenerMutex);
+    for (auto& client : m_clients) {
+      if (!client.second->thread.joinable()) {
+        ClientPtr adopted = client.second;
+        adopted->thread =
+          std::thread([this, adopted]() { this->RunClient(adopted); });
+      }
+    }
+  }
   m_listenerThread = std::thread([this]() { this->Run(); });
 }
 
@@ -43,13 +144,64 @@ void Server::SetPrompt(const char* prompt)
   m_commandPrompt += "\033[0m ";
 }
 
-bool Server::DoInitializing()
+AddressPtr Server::ListenerAddress(const ListenerParameters& listener)
+{
+  if (!listener.unixPath.empty())
+    return Address::CreateUnixAddress(listener.unixPath, true);
+  return Address::CreateListenerAddress(listener.port, true);
+}
+
+const ListenerParameters& Server::ListenerOf(ClientPtr client) const
 {
-  AddressPtr address = Address::CreateListenerAddress(m_parameters.port, true);
-  m_listenerSocket = Socket::CreateSocket(address);
-  m_listenerSocket->SetNonBlocking(true);
-  if (m_listenerSocket->Bind() == false) {
-    m_stage = Stage::Shutingdown;
+  return m_listeners[client->listener]->parameters;
+}
+
+void Server::HoldConnection(ClientPtr client)
+{
+  m_listeners[client->listener]->clients++;
+  if (client->peerCounted)
+    m_addressCounts.Add(client->peerIp);
+}
+
+void Server::ReleaseConnection(ClientPtr client)
+{
+  m_listeners[client->listener]->clients--;
+  if (client->peerCounted)
+    m_addressCounts.Remove(client->peerIp);
+}
+
+bool Server::IsTrustedPeer(ClientPtr client) const
+{
+  const std::vector<uid_t>& trusted = m_parameters.trustedUids;
+  pid_t pid = 0;
+  uid_t uid = 0;
+  if (trusted.empty() ||
+      !client->socket->GetPeerCredentials(&pid, &uid, nullptr) ||
+      std::find(trusted.begin(), trusted.end(), uid) == trusted.end())
+    return false;
+  ESP_LOGI(TAG, "client %lu trusted: pid %d uid %u", client->clientHandle,
+           static_cast<int>(pid), static_cast<unsigned>(uid));
+  return true;
+}
+
+bool Server::OpenListener(Listener& listener)
+{
+  const ListenerParameters& parameters = listener.parameters;
+  if (parameters.transport) {
+    listener.socket = parameters.transport->Listen(m_parameters.backlog);
+    if (!listener.socket) {
+      // mutex prevent change event function on calling
+      std::lock_guard<std::mutex> lock(m_notifierMutex);
+      if (m_onUpdate) {
+        m_onUpdate(*this, ServerReason::InitiallListenFail, EADDRINUSE);
+      }
+      return false;
+    }
+    return true;
+  }
+  SocketPtr socket = Socket::CreateSocket(ListenerAddress(parameters));
+  socket->SetNonBlocking(true);
+  if (socket->Bind() == false) {
     // mutex prevent change event function on calling
     std::lock_guard<std::mutex> lock(m_notifierMutex);
     if (m_onUpdate) {
@@ -57,8 +209,7 @@ bool Server::DoInitializing()
     }
     return false;
   }
-  if (m_listenerSocket->Listen() == false) {
-    m_stage = Stage::Shutingdown;
+  if (socket->Listen(m_parameters.backlog) == false) {
     // mutex prevent change event function on calling
     std::lock_guard<std::mutex> lock(m_notifierMutex);
     if (m_onUpdate) {
@@ -66,29 +217,116 @@ bool Server::DoInitializing()
     }
     return false;
   }
+  listener.socket = socket;
+  return true;
+}
+
+bool Server::DoInitializing()
+{
+  for (auto& listener : m_listeners) {
+    // kept from the previous Start() or taken over, no re-bind window
+    if (listener->socket)
+      continue;
+    if (!OpenListener(*listener)) {
+      ESP_LOGW(TAG, "listener %s failed", listener->parameters.name.c_str());
+      m_stage = Stage::Shutingdown;
+      return false;
+    }
+  }
 
   m_stage = Stage::Listening;
   return true;
 }
 
+SocketPtr Server::AcceptNext(std::size_t* listener)
+{
+  if (1 == m_listeners.size()) {
+    *listener = 0;
+    return m_listeners[0]->socket->Accept(ACCEPT_TIMEOUT);
+  }
+  // transports have no descriptor to poll, they are asked in turn and
+  // keep the wait short; the rotation keeps a busy port from starving
+  // the others
+  std::vector<PlatformSocket> handles;
+  std::vector<std::size_t> polled;
+  bool transports = false;
+  for (std::size_t i = 0; i < m_listeners.size(); i++) {
+    std::size_t index = (m_nextListener + i) % m_listeners.size();
+    SocketPtr socket = m_listeners[index]->socket;
+    if (INVALID_SOCKET != socket->GetHandle()) {
+      handles.push_back(socket->GetHandle());
+      polled.push_back(index);
+      continue;
+    }
+    transports = true;
+    if (SocketPtr accepted = socket->Accept(NOWAIT)) {
+      *listener = index;
+      m_nextListener = index + 1;
+      return accepted;
+    }
+  }
+  if (handles.empty())
+    return nullptr;
+  int ready = Socket::WaitForAnyReadable(
+    handles, transports ? LISTENER_THROTTLE_TIME : ACCEPT_TIMEOUT);
+  if (ready < 0)
+    return nullptr;
+  *listener = polled[ready];
+  m_nextListener = polled[ready] + 1;
+  return m_listeners[polled[ready]]->socket->Accept(NOWAIT);
+}
+
 bool Server::DoListening()
 {
-  SocketPtr connectionSocket = m_listenerSocket->Accept(ACCEPT_TIMEOUT);
+  if (0 == m_accepts.Available()) {
+    // reconnect storms wait in the kernel backlog
+    if (!m_acceptLimited) {
+      m_acceptLimited = true;
+      m_acceptsLimited++;
+    }
+    return false;
+  }
+  m_acceptLimited = false;
+  std::size_t index = 0;
+  SocketPtr connectionSocket = AcceptNext(&index);
   if (connectionSocket && connectionSocket->IsInvalid() == false) {
-    auto client = std::make_shared<Client>(
-      *this, ++m_clientHandlesCounter, true, connectionSocket);
+    m_accepts.Take(1);
+    if (!connectionSocket->ApplyOptions(m_parameters.socketOptions))
+      ESP_LOGW(TAG, "socket options refused: %s",
+               connectionSocket->ErrorsToStr().c_str());
+    Listener& listener = *m_listeners[index];
+    // refused before anything is set up for the connection
+    uint32_t peerIp = 0;
+    bool hasPeer = connectionSocket->GetPeerIpv4(&peerIp, nullptr);
+    bool refused = hasPeer && !m_accessRules.IsAllowed(peerIp);
+    if (refused)
+      m_accessDenied++;
     {
       std::lock_guard<std::mutex> lock_listener(m_listenerMutex);
-      if (m_clients.size() >= m_parameters.maxConnections) {
-        // mutex prevent change event function on calling
-        std::lock_guard<std::mutex> lock(m_notifierMutex);
-        if (m_onUpdate) {
-          m_onUpdate(*this, ServerReason::ConnectionRefused, 0);
-        }
-        return false;
+      unsigned short int listenerCap = listener.parameters.maxConnections;
+      refused = refused || m_clients.size() >= m_parameters.maxConnections ||
+                (listenerCap && listener.clients.load() >= listenerCap);
+      if (!refused && hasPeer && !m_addressCounts.TryAdd(peerIp)) {
+        m_addressLimited++;
+        refused = true;
+      }
+      if (!refused)
+        listener.clients++;
+    }
+    if (refused) {
+      // mutex prevent change event function on calling
+      std::lock_guard<std::mutex> lock(m_notifierMutex);
+      if (m_onUpdate) {
+        m_onUpdate(*this, ServerReason::ConnectionRefused, 0);
       }
+      return false;
     }
+    auto client = std::make_shared<Client>(
+      *this, ++m_clientHandlesCounter, true, connectionSocket, index);
+    client->peerIp = peerIp;
+    client->peerCounted = hasPeer;
 
+    FT_TRACE_INSTANT("accepted", client->clientHandle);
     client->thread = std::thread([this, client]() { this->RunClient(client); });
     {
       std::lock_guard<std::mutex> lock(m_listenerMutex);
@@ -108,6 +346,7 @@ bool Server::DoListening()
 
 void Server::CleanupClients()
 {
+  EndParkedSessions();
   bool ClientsDeleted = false;
   {
     std::lock_guard<std::mutex> lock(m_listenerMutex);
@@ -134,6 +373,7 @@ void Server::CleanupClients()
 
 void Server::Run()
 {
+  m_parameters.ioThreads.Apply("listen");
   {
     // mutex prevent change event function on calling
     std::lock_guard<std::mutex> lock(m_notifierMutex);
@@ -166,12 +406,37 @@ void Server::Run()
 
   ESP_LOGI(TAG, "Stopping");
 
+  std::map<ClientHandle, ClientPtr> clients;
   {
     std::lock_guard<std::mutex> lock(m_listenerMutex);
-    for (auto& client : m_clients)
+    clients = m_clients;
+  }
+  // client threads take m_listenerMutex on their way out, join unlocked
+  for (auto& client : clients) {
+    if (client.second->thread.joinable())
       client.second->thread.join();
-
+  }
+  // parked sessions end with the server
+  {
+    std::lock_guard<std::mutex> lock(m_listenerMutex);
+    if (m_resumeTable)
+      m_resumeTable->TakeParked();
+    m_resumeEnded.clear();
+  }
+  for (auto& client : clients) {
+    if (client.second->parked.exchange(false))
+      NotifyDisconnect(client.second);
+  }
+  // the disconnect callbacks may still wait in the executor
+  for (auto& client : clients) {
+    StrandPtr strand = client.second->strand;
+    if (strand && !strand->WaitIdle(CALLBACK_DRAIN_TIMEOUT))
+      ESP_LOGW(TAG, "client %lu callbacks still running", client.first);
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_listenerMutex);
     m_clients.clear();
+    m_clientsForDelete = {};
   }
 
   {
@@ -181,137 +446,1134 @@ void Server::Run()
       m_onUpdate(*this, ServerReason::ServerStopped, 0);
     }
   }
-  m_listenerSocket = nullptr;
   ESP_LOGI(TAG, "Stopped");
 }
 
-bool Server::ProcessClientPassword(const ClientHandle clientHandle,
-                                   const void* data, const size_t size)
+void Server::ProcessClientPassword(ClientPtr client, const void* data,
+                                   const size_t size)
 {
-  // mutex prevent change event function on calling
-  std::lock_guard<std::mutex> lock(m_notifierMutex);
-  if (nullptr == m_onPasswordEntered) {
-    SendToClient(clientHandle, WRONG_PASSWORD_MESSAGE);
-    SendToClient(clientHandle, PASSWORD_PROMPT);
+  OnPasswordEntered onPasswordEntered;
+  OnPasswordEnteredAsync onPasswordEnteredAsync;
+  {
+    // mutex prevent change event function on calling
+    std::lock_guard<std::mutex> lock(m_notifierMutex);
+    onPasswordEntered = m_onPasswordEntered;
+    onPasswordEnteredAsync = m_onPasswordEnteredAsync;
+  }
+
+  std::string password(static_cast<const char*>(data), size);
+  if (onPasswordEnteredAsync) {
+    client->pendingAuth =
+      onPasswordEnteredAsync(*this, client->clientHandle, std::move(password));
+    return;
+  }
+  if (nullptr == onPasswordEntered) {
+    client->pendingAuth = MakeAuthResult(false);
+    return;
+  }
+
+  // slow checks run on the auth pool, the I/O thread only polls the result
+  auto check = std::make_shared<std::packaged_task<bool()>>(
+    [this, onPasswordEntered, handle = client->clientHandle,
+     password = std::move(password)]() {
+      return onPasswordEntered(*this, handle, password.data(),
+                               password.size());
+    });
+  client->pendingAuth = check->get_future();
+  if (!m_authPool->Post([check]() { (*check)(); })) {
+    ESP_LOGW(TAG, "auth queue is full");
+    client->pendingAuth = MakeAuthResult(false);
+  }
+}
+
+bool Server::CompleteClientPassword(ClientPtr client)
+{
+  bool accepted = false;
+  try {
+    accepted = client->pendingAuth.get();
+  }
+  catch (const std::exception& e) {
+    ESP_LOGE(TAG, "password check failed: %s", e.what());
+  }
+  if (accepted)
+    return true;
+
+  SendToClient(client->clientHandle, WRONG_PASSWORD_MESSAGE);
+  if (++client->passwordAttempts >= m_parameters.maxPasswordAttempts) {
+    SendToClient(client->clientHandle, TOO_MANY_ATTEMPTS_MESSAGE);
+    client->connected = false;
     return false;
   }
+  if (!client->authenticated)
+    SendToClient(client->clientHandle, PASSWORD_PROMPT);
+  return false;
+}
 
-  if (!m_onPasswordEntered(*this, clientHandle, data, size)) {
-    SendToClient(clientHandle, WRONG_PASSWORD_MESSAGE);
-    SendToClient(clientHandle, PASSWORD_PROMPT);
+void Server::IssueResumeToken(ClientPtr client)
+{
+  // deflate state doesn't survive the connection, see ParkClient
+  if (!m_resumeTable || client->forSend.IsCompressed())
+    return;
+  std::lock_guard<std::mutex> lock(m_listenerMutex);
+  client->resumeToken =
+    m_resumeTable->Issue(client->clientHandle, &m_resumeEnded);
+  if (client->resumeToken.empty()) {
+    ESP_LOGW(TAG, "client %lu gets no resume token, too many sessions",
+             client->clientHandle);
+    return;
+  }
+  std::string message =
+    std::string(RESUME_TOKEN_MESSAGE) + client->resumeToken + "\n";
+  client->forSend.Push(message.data(), message.size());
+}
+
+bool Server::TryResume(ClientPtr client, const void* data, const size_t size)
+{
+  std::string_view line(static_cast<const char*>(data), size);
+  if (!m_resumeTable || 0 != line.compare(0, RESUME_COMMAND.size(),
+                                          RESUME_COMMAND))
     return false;
+  line.remove_prefix(RESUME_COMMAND.size());
+  while (!line.empty() && static_cast<unsigned char>(line.back()) <= ' ')
+    line.remove_suffix(1);
+
+  ClientPtr session;
+  std::unique_lock<std::mutex> lock(m_listenerMutex);
+  {
+    std::string token(line);
+    ClientHandle handle = 0;
+    auto clIter = m_resumeTable->Find(token, &handle) ? m_clients.find(handle)
+                                                      : m_clients.end();
+    // the session keeps its protocol and permissions: a token presented on
+    // another listener, e.g. a read-only or framed one, doesn't resume it
+    if (clIter != m_clients.end() &&
+        clIter->second->listener != client->listener) {
+      ESP_LOGW(TAG, "client %lu: session %lu belongs to listener %zu, not %zu",
+               client->clientHandle, handle, clIter->second->listener,
+               client->listener);
+      clIter = m_clients.end();
+    }
+    if (clIter != m_clients.end() && !clIter->second->finished &&
+        m_resumeTable->Take(token, &handle)) {
+      session = clIter->second;
+      session->claimed = true;
+      // still connected as far as we know: a half open connection,
+      // its I/O thread lets go of it
+      if (!session->parked) {
+        session->lost = true;
+        session->connected = false;
+      }
+    }
   }
+  // an unknown or expired token counts as a wrong password, guesses run
+  // out of attempts
+  client->pendingAuth = MakeAuthResult(false);
+  if (!session)
+    return true;
 
+  // ParkClient() or the end of its RunClient() wakes us
+  m_sessionReleased.wait_for(lock, RESUME_PARK_TIMEOUT, [&session]() {
+    return session->parked || session->finished;
+  });
+  session->claimed = false;
+  // the session ended instead, or the server is stopping and ends it
+  if (!session->parked || Stage::Shutingdown == m_stage.load())
+    return true;
+  client->pendingAuth = AuthResult();
+  session->socket = client->socket;
+  session->lost = false;
+  session->connected = true;
+  session->resumed = true;
+  session->parked = false;
+  session->peerIp = client->peerIp;
+  session->peerCounted = client->peerCounted;
+  HoldConnection(session);
+  client->movedOut = true;
+  client->connected = false;
+  // a fresh token for every connection, an old one may have been seen
+  session->resumeToken =
+    m_resumeTable->Issue(session->clientHandle, &m_resumeEnded);
+  std::string message(RESUMED_MESSAGE);
+  if (!session->resumeToken.empty()) {
+    message += std::string(RESUME_TOKEN_MESSAGE) + session->resumeToken + "\n";
+  }
+  session->forSend.Push(message.data(), message.size());
+  // its RunClient is done, the thread only waits to be joined
+  if (session->thread.joinable())
+    session->thread.join();
+  session->thread = std::thread([this, session]() { this->RunClient(session); });
+  m_sessionsResumed++;
+  ESP_LOGI(TAG, "client %lu resumed session %lu", client->clientHandle,
+           session->clientHandle);
   return true;
 }
 
-void Server::RunClient(ClientPtr client)
+bool Server::ParkClient(ClientPtr client)
+{
+  // deflate state can't move to another connection; stopping or handing
+  // over ends every session
+  if (!m_resumeTable || client->resumeToken.empty() || !client->lost ||
+      client->forSend.IsCompressed() || m_handingOver ||
+      Stage::Shutingdown == m_stage.load())
+    return false;
+  std::lock_guard<std::mutex> lock(m_listenerMutex);
+  // a claimed token is out of the table, the new connection waits for us
+  if (!client->claimed && !m_resumeTable->Park(client->resumeToken))
+    return false;
+  ReleaseConnection(client);
+  client->socket = nullptr;
+  client->parked = true;
+  if (client->claimed)
+    m_sessionReleased.notify_all();
+  ESP_LOGI(TAG, "client %lu parked, %zu bytes queued", client->clientHandle,
+           client->forSend.GetHeldBytes());
+  return true;
+}
+
+void Server::EndParkedSessions()
+{
+  std::vector<ClientPtr> ended;
+  {
+    std::lock_guard<std::mutex> lock(m_listenerMutex);
+    if (!m_resumeTable)
+      return;
+    std::vector<ClientHandle> handles = m_resumeTable->TakeExpired();
+    handles.insert(handles.end(), m_resumeEnded.begin(), m_resumeEnded.end());
+    m_resumeEnded.clear();
+    for (ClientHandle handle : handles) {
+      auto clIter = m_clients.find(handle);
+      if (clIter == m_clients.end() || !clIter->second->parked.exchange(false))
+        continue;
+      clIter->second->finished = true;
+      m_clientsForDelete.push(handle);
+      ended.push_back(clIter->second);
+    }
+  }
+  for (auto& client : ended) {
+    ESP_LOGI(TAG, "client %lu session ended unresumed", client->clientHandle);
+    NotifyDisconnect(client);
+  }
+}
+
+bool Server::DrainClient(ClientPtr client, std::chrono::milliseconds timeout)
+{
+  auto deadline = std::chrono::steady_clock::now() + timeout;
+  while (!client->forSend.IsEmpty()) {
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+      deadline - std::chrono::steady_clock::now());
+    if (left.count() <= 0 || !client->socket->IsReadyForWrite(left))
+      return false;
+    size_t sent = 0;
+    if (!client->forSend.Send(client->socket, &sent))
+      return false;
+    // an empty pipe segment, its writer may still come
+    if (0 == sent)
+      std::this_thread::sleep_for(CLIENT_THROTTLE_TIME);
+  }
+  return true;
+}
+
+bool Server::WaitForRead(ClientPtr client)
 {
-  bool awaitPassword = true;
+  if (m_parameters.lowLatency) {
+    // spin a little: a reply usually comes back sooner than a wakeup
+    auto spinUntil =
+      std::chrono::steady_clock::now() + m_parameters.spinBeforeBlock;
+    do {
+      if (client->socket->IsReadyForRead(NOWAIT))
+        return true;
+    } while (std::chrono::steady_clock::now() < spinUntil);
+  }
+  return client->socket->IsReadyForRead(CLIENT_THROTTLE_TIME);
+}
+
+void Server::PlaceClientThread(ClientPtr client)
+{
+  m_parameters.ioThreads.Apply("c" + std::to_string(client->clientHandle));
+  if (!m_parameters.lowLatency)
+    return;
+  if (!client->socket->SetBusyPoll(m_parameters.busyPollMicroseconds)) {
+    ESP_LOGW(TAG, "SO_BUSY_POLL refused: %s",
+             client->socket->ErrorsToStr().c_str());
+  }
+  // follow the packets to the CPU which handles them, if we may run there
+  int cpu = client->socket->GetIncomingCpu();
+  const auto& allowed = m_parameters.ioThreads.cpus;
+  if (cpu >= 0 && (allowed.empty() || std::find(allowed.begin(),
+                                                allowed.end(), cpu) !=
+                                        allowed.end())) {
+    SetCurrentThreadAffinity({cpu});
+  }
+}
+
+void Server::NotifyConnect(ClientPtr client)
+{
+  if (!client->strand) {
+    // mutex prevent change event function on calling
+    std::lock_guard<std::mutex> lock(m_notifierMutex);
+    if (m_onConnect) {
+      m_onConnect(*this, client->clientHandle);
+    }
+    return;
+  }
+  // the setters are refused while listening, and Run() drains the strands
+  // before the server initializes again, the callbacks are read unlocked
+  ClientHandle handle = client->clientHandle;
+  client->strand->Post(
+    [this, handle]() {
+      if (m_onConnect)
+        m_onConnect(*this, handle);
+    },
+    true);
+}
+
+void Server::NotifyDisconnect(ClientPtr client)
+{
+  // the client's last records go first
+  if (m_batcher)
+    m_batcher->Flush();
+  if (!client->strand) {
+    // mutex prevent change event function on calling
+    std::lock_guard<std::mutex> lock(m_notifierMutex);
+    if (m_onDisconnect) {
+      m_onDisconnect(*this, client->clientHandle);
+    }
+    return;
+  }
+  ClientHandle handle = client->clientHandle;
+  client->strand->Post(
+    [this, handle]() {
+      if (m_onDisconnect)
+        m_onDisconnect(*this, handle);
+    },
+    true);
+}
+
+void Server::NotifyReceiveBatch(ReceiveBatch batch)
+{
+  // mutex prevent change event function on calling
+  std::lock_guard<std::mutex> lock(m_notifierMutex);
+  if (m_onReceiveBatch) {
+    FT_TRACE_SPAN(span, "batch callback", batch.size());
+    m_onReceiveBatch(*this, batch);
+  }
+}
+
+bool Server::NotifyReceive(ClientPtr client, const void* data,
+                           const size_t size)
+{
+  if (m_batcher && m_onReceiveBatch) {
+    // copied, the receive buffer is reused by the next read
+    m_batcher->Add(client->clientHandle, data, size);
+    return true;
+  }
+  if (!client->strand) {
+    // mutex prevent change event function on calling
+    std::unique_lock<std::mutex> lock(m_notifierMutex, std::defer_lock);
+    {
+      FT_TRACE_SPAN(span, "notifier wait", client->clientHandle);
+      lock.lock();
+    }
+    if (m_onReceiveData) {
+      FT_TRACE_SPAN(span, "receive callback", size);
+      m_onReceiveData(*this, client->clientHandle, data, size);
+    }
+    return true;
+  }
+  ClientHandle handle = client->clientHandle;
+  // the receive buffer is reused by the next read
+  std::string received(static_cast<const char*>(data), size);
+  // a paused client is only read with room in its queue, a saturated pool
+  // makes its I/O thread run the callbacks
+  bool mandatory = OverflowPause == m_parameters.callbackOverflow;
+  if (client->strand->Post(
+        [this, client, handle, received = std::move(received)]() {
+          // the I/O thread holds back a corked flush meanwhile
+          client->callbacksRunning++;
+          if (m_onReceiveData) {
+            FT_TRACE_SPAN(span, "receive callback", received.size());
+            m_onReceiveData(*this, handle, received.data(), received.size());
+          }
+          client->callbacksRunning--;
+        },
+        mandatory))
+    return true;
 
+  if (OverflowDisconnect == m_parameters.callbackOverflow) {
+    ESP_LOGW(TAG, "client %lu callback queue overflow, disconnecting",
+             handle);
+    m_clientsOverflowed++;
+    return false;
+  }
+  m_receivesDropped++;
+  return true;
+}
+
+bool Server::DeliverFrames(ClientPtr client, FrameReader& frames)
+{
+  std::string_view frame;
+  while (true) {
+    switch (frames.Next(&frame)) {
+    case FrameReader::FrameReady:
+      if (!NotifyReceive(client, frame.data(), frame.size()))
+        return false;
+      break;
+    case FrameReader::NeedMore: return true;
+    case FrameReader::Oversized:
+      ESP_LOGW(TAG, "client %lu frame over %zu bytes", client->clientHandle,
+               m_parameters.maxFrameSize);
+      return false;
+    case FrameReader::Malformed:
+    default:
+      ESP_LOGW(TAG, "client %lu malformed frame header", client->clientHandle);
+      return false;
+    }
+  }
+}
+
+std::size_t Server::FilterTelnet(ClientPtr client, void* data,
+                                 std::size_t size)
+{
+  size = client->telnet.Filter(data, size);
+  if (client->telnet.TakeDoCompress() &&
+      client->forSend.StartCompression(Telnet::START_COMPRESS2,
+                                       sizeof(Telnet::START_COMPRESS2),
+                                       m_parameters.compression)) {
+    ESP_LOGI(TAG, "client %lu compressed, %zu bytes of state",
+             client->clientHandle,
+             Deflater::MemoryFor(m_parameters.compression));
+  }
+  return size;
+}
+
+std::size_t Server::ReadBudget(ClientPtr client, std::size_t room)
+{
+  std::size_t budget = std::min(room, client->inboundBytes.Available());
+  // wait for a whole chunk rather than trickle in a few bytes per iteration
+  std::size_t wanted = std::min(room, client->inboundBytes.GetBurst());
+  bool commandsLeft = client->commands.Available() > 0;
+  if (budget >= wanted && commandsLeft) {
+    client->readLimited = false;
+    return budget;
+  }
+  if (!client->readLimited) {
+    client->readLimited = true;
+    if (!commandsLeft)
+      m_commandsLimited++;
+    else
+      m_inboundLimited++;
+  }
+  return 0;
+}
+
+void Server::HoldReceiveBuffer(ClientPtr client, std::size_t capacity)
+{
+  std::size_t held = client->receiveBytes.exchange(capacity);
+  if (capacity > held)
+    m_bufferBudget->Add(capacity - held);
+  else
+    m_bufferBudget->Remove(held - capacity);
+}
+
+std::size_t Server::FlushClient(ClientPtr client)
+{
+  bool cork = m_parameters.socketOptions.cork;
+  // a reply being built on a callback thread goes out in one piece, but
+  // never wait twice in a row for a busy client
+  if (cork && client->callbacksRunning > 0 && !client->flushDeferred) {
+    client->flushDeferred = true;
+    return 0;
+  }
+  client->flushDeferred = false;
+  client->forSend.FlushCompression();
+  if (client->forSend.IsEmpty()) {
+    client->flushLimited = false;
+    return 0;
+  }
+  FT_TRACE_SPAN(span, "flush", 0);
+  std::size_t budget =
+    std::min(MAX_FLUSH_PER_ITERATION, client->outboundBytes.Available());
+  // SSL_write has no MSG_MORE, cork the socket for the whole flush
+  bool corked = cork && client->socket->IsTls() &&
+                !client->forSend.IsEmpty() && client->socket->SetCork(true);
+  size_t flushed = 0;
+  while (!client->forSend.IsEmpty() && flushed < budget) {
+    size_t bytesSent = 0;
+    if (!client->forSend.Send(client->socket, &bytesSent, budget - flushed)) {
+      client->lost = true;
+      client->connected = false;
+      break;
+    }
+    if (!client->connected)
+      break;
+    // an empty pipe, retry on the next iteration
+    if (0 == bytesSent)
+      break;
+    flushed += bytesSent;
+  }
+  if (corked)
+    client->socket->SetCork(false);
+  client->outboundBytes.Take(flushed);
+  FT_TRACE_VALUE(span, flushed);
+  bool backlog = !client->forSend.IsEmpty();
+  if (backlog && flushed) {
+    // the socket backed up: no chunk bigger than its (autotuned) buffer
+    int space = client->socket->GetSendBufferSize();
+    client->forSend.SetSendSpace(space > 0 ? space : 0);
+  }
+  // the queue keeps what the rate didn't allow for the next iterations
+  bool limited =
+    budget < MAX_FLUSH_PER_ITERATION && flushed >= budget && backlog;
+  if (limited && !client->flushLimited)
+    m_outboundLimited++;
+  client->flushLimited = limited;
+  return flushed;
+}
+
+void Server::RunClient(ClientPtr client)
+{
+  PlaceClientThread(client);
+  // MSG_MORE means nothing to a unix socket
+  client->forSend.SetCork(m_parameters.socketOptions.cork &&
+                          !client->socket->IsLocal());
+  const BufferSizing& sizing = m_parameters.buffers;
+  client->forSend.SetSizing(sizing.minSendChunk, sizing.maxSendChunk,
+                            m_bufferBudget);
+  const RateLimits& limits = m_parameters.limits;
+  client->inboundBytes =
+    TokenBucket(limits.inboundBytes.rate, limits.inboundBytes.burst);
+  client->commands = TokenBucket(limits.commands.rate, limits.commands.burst);
+  client->outboundBytes =
+    TokenBucket(limits.outboundBytes.rate, limits.outboundBytes.burst);
+  if (m_callbackPool && !client->strand) {
+    client->strand =
+      Strand::CreateStrand(m_callbackPool, m_parameters.callbackQueuePerClient);
+  }
   std::chrono::time_point timeoutTime =
     std::chrono::system_clock::now() +
     client->server.m_parameters.clientTimeOut;
 
-  Buffer receiveBuffer(RECEIVE_BUFFER_SIZE);
+  AdaptiveSize receiveSize(sizing.minReceive, sizing.maxReceive,
+                           sizing.shrinkAfter);
+  // telnet only, framed clients read into the frame reader
+  Buffer receiveBuffer;
 
   std::this_thread::sleep_for(CLIENT_THROTTLE_TIME);
 
-  SendToClient(client->clientHandle, PASSWORD_PROMPT);
+  if (client->resumed) {
+    // the application never saw it leave
+    client->resumed = false;
+  }
+  else if (client->authenticated) {
+    // taken over from a previous process, the client already logged in
+    NotifyConnect(client);
+  }
+  else if (m_parameters.tls) {
+    if (!client->socket->StartTls(m_parameters.tls)) {
+      client->connected = false;
+      // mutex prevent change event function on calling
+      std::lock_guard<std::mutex> lock(m_notifierMutex);
+      if (m_onUpdate) {
+        m_onUpdate(*this, ServerReason::ConnectionTlsFailed, EPROTO);
+      }
+    }
+    else {
+      ESP_LOGI(TAG, "client %lu TLS %s%s", client->clientHandle,
+               client->socket->IsTlsResumed() ? "resumed" : "full handshake",
+               client->socket->IsKernelTls() ? ", kernel TLS" : "");
+    }
+  }
+
+  if (client->connected && !client->authenticated && IsTrustedPeer(client)) {
+    client->authenticated = true;
+    NotifyConnect(client);
+  }
+
+  // framed clients are read straight into the reader's buffer
+  const ListenerParameters& listener = ListenerOf(client);
+  std::unique_ptr<FrameReader> frames;
+  if (ProtocolTelnet != listener.protocol) {
+    frames = std::make_unique<FrameReader>(FrameFormatOf(listener.protocol),
+                                           m_parameters.maxFrameSize);
+  }
+
+  if (!frames && !client->authenticated &&
+      m_parameters.compression.enabled && Deflater::IsAvailable()) {
+    // the answer may come with the password, the filter catches it
+    client->telnetFiltered = true;
+    SendToClient(client->clientHandle,
+                 std::string_view(Telnet::WILL_COMPRESS2,
+                                  sizeof(Telnet::WILL_COMPRESS2)));
+  }
+
+  // machine clients and listeners without a password skip the password
+  // stage
+  if ((frames || !listener.password) && client->connected &&
+      !client->authenticated) {
+    client->authenticated = true;
+    NotifyConnect(client);
+  }
+
+  // nothing goes out in plaintext after a failed TLS handshake
+  if (client->connected && !client->authenticated)
+    SendToClient(client->clientHandle, PASSWORD_PROMPT);
 
   while (client->connected && Stage::Shutingdown != m_stage.load()) {
-    std::this_thread::sleep_for(CLIENT_THROTTLE_TIME);
+    if (!m_parameters.lowLatency)
+      std::this_thread::sleep_for(CLIENT_THROTTLE_TIME);
 
     if (std::chrono::system_clock::now() >= timeoutTime) {
       client->connected = false;
       break;
     }
 
-    if (client->socket->IsReadyForWrite(NOWAIT)) {
-      while (!client->forSend.IsEmpty()) {
-        if (!client->forSend.Send(client->socket)) {
-          client->connected = false;
-          break;
-        }
-        if (!client->connected)
-          break;
-
+    // nothing queued, nothing to poll for; a hang-up wakes WaitForRead()
+    // and the failing Receive() or Send() marks the client lost
+    bool idle = client->forSend.IsEmpty() &&
+                !client->forSend.HasUnflushedCompression();
+    if (!idle && client->socket->IsReadyForWrite(NOWAIT)) {
+      if (FlushClient(client))
         timeoutTime = std::chrono::system_clock::now() +
                       client->server.m_parameters.clientTimeOut;
+      if (!client->connected)
+        break;
+    }
+
+    if (client->pendingAuth.valid()) {
+      // parked: nothing is read until the password check completes
+      if (std::future_status::ready !=
+          client->pendingAuth.wait_for(CLIENT_THROTTLE_TIME))
+        continue;
+      if (CompleteClientPassword(client)) {
+        client->authenticated = true;
+        IssueResumeToken(client);
+        NotifyConnect(client);
       }
+      continue;
     }
 
-    if (client->socket->IsInvalid()) {
-      break;
+    if (client->strand && OverflowPause == m_parameters.callbackOverflow &&
+        client->strand->IsFull()) {
+      // the application is behind on this client, leave the data in the
+      // kernel until it catches up
+      timeoutTime = std::chrono::system_clock::now() +
+                    client->server.m_parameters.clientTimeOut;
+      std::this_thread::sleep_for(CLIENT_THROTTLE_TIME);
+      continue;
     }
 
-    if (client->socket->IsReadyForRead(CLIENT_THROTTLE_TIME)) {
-      size_t bytesReceived =
-        client->socket->Receive(receiveBuffer.data(), RECEIVE_BUFFER_SIZE, 0);
+    // the previous read is consumed, the buffer may change size now
+    void* readInto;
+    std::size_t readRoom;
+    if (frames) {
+      frames->SetReceiveChunk(receiveSize.Get());
+      readInto = frames->Prepare(&readRoom);
+      HoldReceiveBuffer(client, frames->GetCapacity());
+    }
+    else {
+      if (receiveBuffer.size() != receiveSize.Get()) {
+        receiveBuffer = Buffer(receiveSize.Get());
+        HoldReceiveBuffer(client, receiveBuffer.capacity());
+      }
+      readInto = receiveBuffer.data();
+      readRoom = receiveBuffer.size();
+    }
+    std::size_t readBudget = ReadBudget(client, readRoom);
+    if (0 == readBudget) {
+      // over its rate: the data stays in the kernel and TCP slows the peer
+      timeoutTime = std::chrono::system_clock::now() +
+                    client->server.m_parameters.clientTimeOut;
+      std::this_thread::sleep_for(CLIENT_THROTTLE_TIME);
+      continue;
+    }
+
+    if (WaitForRead(client)) {
+      size_t bytesReceived = client->socket->Receive(readInto, readBudget, 0);
       if (bytesReceived) {
-        if (awaitPassword) {
-          if (ProcessClientPassword(
-                client->clientHandle, receiveBuffer.data(), bytesReceived)) {
-            awaitPassword = false;
-            // mutex prevent change event function on calling
-            std::lock_guard<std::mutex> lock(m_notifierMutex);
-            if (m_onConnect) {
-              m_onConnect(*this, client->clientHandle);
-            }
+        // filtering, framing and the callbacks
+        FT_TRACE_SPAN(span, "deliver", bytesReceived);
+        receiveSize.OnRead(bytesReceived, readRoom, m_bufferBudget.get());
+        client->inboundBytes.Take(bytesReceived);
+        client->commands.Take(1);
+        if (client->telnetFiltered) {
+          bytesReceived =
+            FilterTelnet(client, receiveBuffer.data(), bytesReceived);
+          if (0 == bytesReceived)
+            continue;
+        }
+        if (frames) {
+          frames->Commit(bytesReceived);
+          if (!DeliverFrames(client, *frames)) {
+            client->connected = false;
+            break;
           }
+        }
+        else if (!client->authenticated) {
+          if (!TryResume(client, receiveBuffer.data(), bytesReceived))
+            ProcessClientPassword(client, receiveBuffer.data(), bytesReceived);
+          if (client->movedOut)
+            break;
           continue;
         }
-        {
-          // mutex prevent change event function on calling
-          std::lock_guard<std::mutex> lock(m_notifierMutex);
-          if (m_onReceiveData) {
-            m_onReceiveData(*this, client->clientHandle, receiveBuffer.data(),
-                            bytesReceived);
-          }
+        else if (!NotifyReceive(client, receiveBuffer.data(), bytesReceived)) {
+          client->connected = false;
+          break;
         }
         timeoutTime = std::chrono::system_clock::now() +
                       client->server.m_parameters.clientTimeOut;
       }
+      else if (client->socket->WouldBlock()) {
+        receiveSize.OnIdle();
+      }
       else {
+        client->lost = true;
         break;
       }
     }
+    else {
+      receiveSize.OnIdle();
+    }
   }
-  {
-    // mutex prevent change event function on calling
-    std::lock_guard<std::mutex> lock(m_notifierMutex);
-    if (m_onDisconnect) {
-      m_onDisconnect(*this, client->clientHandle);
+  HoldReceiveBuffer(client, 0);
+  if (client->movedOut) {
+    // the connection lives on in the resumed session
+    std::lock_guard<std::mutex> lock(m_listenerMutex);
+    ReleaseConnection(client);
+    client->socket = nullptr;
+    client->finished = true;
+    m_clientsForDelete.push(client->clientHandle);
+    return;
+  }
+  if (ParkClient(client))
+    return;
+  // userspace TLS and deflate state can't cross processes, those clients
+  // are closed, as are the ones without a descriptor
+  bool handOver = m_handingOver && client->connected &&
+                  !client->socket->IsTls() &&
+                  !client->forSend.IsCompressed() &&
+                  INVALID_SOCKET != client->socket->GetHandle();
+  if (handOver) {
+    // the new process starts with an empty queue, output left here would
+    // be a silent gap in the client's stream
+    handOver = DrainClient(client, HANDOFF_FLUSH_TIMEOUT);
+    if (!handOver)
+      ESP_LOGW(TAG, "client %lu closed, its output didn't drain for the "
+               "handoff", client->clientHandle);
+  }
+  else {
+    // best effort: deliver what was queued before the close, e.g. the
+    // reason
+    client->forSend.FlushCompression();
+    while (!client->forSend.IsEmpty() &&
+           client->socket->IsReadyForWrite(NOWAIT)) {
+      // an empty pipe sends nothing, don't spin on it
+      size_t sent = 0;
+      if (!client->forSend.Send(client->socket, &sent) || 0 == sent)
+        break;
     }
   }
+  // a handed over client stays connected, in the new process
+  if (!handOver)
+    NotifyDisconnect(client);
   std::lock_guard<std::mutex> lock(m_listenerMutex);
-  client->socket = nullptr;
+  if (client->forSend.IsCompressed()) {
+    uint64_t bytesIn, bytesOut;
+    client->forSend.GetCompressionCounters(&bytesIn, &bytesOut);
+    m_compressedClients++;
+    m_compressionBytesIn += bytesIn;
+    m_compressionBytesOut += bytesOut;
+  }
+  ReleaseConnection(client);
+  if (m_resumeTable && !client->resumeToken.empty())
+    m_resumeTable->Remove(client->resumeToken);
+  client->finished = true;
+  if (client->claimed)
+    m_sessionReleased.notify_all();
+  if (handOver)
+    m_handedOver.push_back(client);
+  else
+    client->socket = nullptr;
   client->server.m_clientsForDelete.push(client->clientHandle);
 }
 
+ServerStats Server::GetStats()
+{
+  ServerStats stats;
+  if (m_callbackPool) {
+    WorkerPoolStats pool = m_callbackPool->GetStats();
+    stats.callbackQueueDepth = pool.queueDepth;
+    stats.callbackMaxQueueDepth = pool.maxQueueDepth;
+    stats.callbacksExecuted = pool.executed;
+    stats.callbacksRejected = pool.rejected;
+  }
+  stats.receivesDropped = m_receivesDropped.load();
+  stats.clientsOverflowed = m_clientsOverflowed.load();
+  stats.inboundLimited = m_inboundLimited.load();
+  stats.commandsLimited = m_commandsLimited.load();
+  stats.outboundLimited = m_outboundLimited.load();
+  stats.acceptsLimited = m_acceptsLimited.load();
+  stats.accessDenied = m_accessDenied.load();
+  stats.addressLimited = m_addressLimited.load();
+  stats.compressedClients = m_compressedClients.load();
+  stats.compressionBytesIn = m_compressionBytesIn.load();
+  stats.compressionBytesOut = m_compressionBytesOut.load();
+  stats.bufferBudget = m_bufferBudget->GetLimit();
+  for (const auto& listener : m_listeners)
+    stats.listenerClients.push_back(listener->clients.load());
+  stats.sessionsResumed = m_sessionsResumed.load();
+  if (m_batcher)
+    m_batcher->GetCounters(&stats.batches, &stats.batchRecords);
+  std::vector<ClientPtr> clients;
+  {
+    std::lock_guard<std::mutex> lock(m_listenerMutex);
+    if (m_resumeTable)
+      stats.parkedSessions = m_resumeTable->GetParked();
+    clients.reserve(m_clients.size());
+    for (auto& [handle, client] : m_clients) {
+      if (!client->finished && !client->parked)
+        clients.push_back(client);
+    }
+  }
+  // the queue locks are taken without the listener one, a client busy
+  // sending holds up neither accepts nor other clients' output
+  for (auto& client : clients) {
+    stats.clients++;
+    uint64_t held = client->receiveBytes.load() + client->forSend.GetHeldBytes();
+    stats.bufferBytes += held;
+    stats.maxClientBufferBytes = std::max(stats.maxClientBufferBytes, held);
+    if (!client->forSend.IsCompressed())
+      continue;
+    uint64_t bytesIn, bytesOut;
+    client->forSend.GetCompressionCounters(&bytesIn, &bytesOut);
+    stats.compressedClients++;
+    stats.compressionBytesIn += bytesIn;
+    stats.compressionBytesOut += bytesOut;
+  }
+  return stats;
+}
+
+std::vector<ClientStats> Server::GetClientStats()
+{
+  std::vector<std::tuple<ClientStats, SocketPtr, ClientPtr>> clients;
+  {
+    std::lock_guard<std::mutex> lock(m_listenerMutex);
+    clients.reserve(m_clients.size());
+    for (auto& [handle, client] : m_clients) {
+      if (client->finished || client->parked || !client->socket)
+        continue;
+      ClientStats stats;
+      stats.handle = handle;
+      stats.listener = client->listener;
+      stats.peerIp = client->peerIp;
+      clients.emplace_back(stats, client->socket, client);
+    }
+  }
+  // the queue locks and syscalls run without the listener lock, accepts
+  // and sends go on meanwhile
+  std::vector<ClientStats> result;
+  result.reserve(clients.size());
+  for (auto& [stats, socket, client] : clients) {
+    stats.bufferBytes =
+      client->receiveBytes.load() + client->forSend.GetHeldBytes();
+    stats.hasTcpInfo = socket->GetTcpInfo(&stats.tcp);
+    result.push_back(stats);
+  }
+  return result;
+}
+
+std::string ClientStats::ToString() const
+{
+  char buf[256];
+  if (!hasTcpInfo) {
+    std::snprintf(buf, sizeof(buf) - 1, "client %lu: listener=%zu buffers=%llu",
+                  handle, listener,
+                  static_cast<unsigned long long>(bufferBytes));
+    return buf;
+  }
+  std::snprintf(buf, sizeof(buf) - 1,
+                "client %lu: listener=%zu buffers=%llu rtt=%u/%u us "
+                "retransmits=%u lost=%u cwnd=%u unacked=%llu B/%u segments "
+                "unsent=%llu B idle=%u ms",
+                handle, listener, static_cast<unsigned long long>(bufferBytes),
+                tcp.rttMicroseconds, tcp.rttVarMicroseconds, tcp.retransmits,
+                tcp.lostSegments, tcp.congestionWindow,
+                static_cast<unsigned long long>(tcp.unackedBytes),
+                tcp.unackedSegments,
+                static_cast<unsigned long long>(tcp.unsentBytes),
+                tcp.lastReceiveMilliseconds);
+  return buf;
+}
+
+std::string ServerStats::ToString() const
+{
+  char buf[768];
+  std::snprintf(buf, sizeof(buf) - 1,
+                "clients=%zu; "
+                "callbacks: queue=%zu max=%zu executed=%llu rejected=%llu "
+                "dropped=%llu overflowed=%llu; limited: inbound=%llu "
+                "commands=%llu outbound=%llu accepts=%llu; compressed: "
+                "clients=%llu in=%llu out=%llu; buffers: bytes=%llu "
+                "per client=%llu max=%llu budget=%llu",
+                clients, callbackQueueDepth, callbackMaxQueueDepth,
+                static_cast<unsigned long long>(callbacksExecuted),
+                static_cast<unsigned long long>(callbacksRejected),
+                static_cast<unsigned long long>(receivesDropped),
+                static_cast<unsigned long long>(clientsOverflowed),
+                static_cast<unsigned long long>(inboundLimited),
+                static_cast<unsigned long long>(commandsLimited),
+                static_cast<unsigned long long>(outboundLimited),
+                static_cast<unsigned long long>(acceptsLimited),
+                static_cast<unsigned long long>(compressedClients),
+                static_cast<unsigned long long>(compressionBytesIn),
+                static_cast<unsigned long long>(compressionBytesOut),
+                static_cast<unsigned long long>(bufferBytes),
+                static_cast<unsigned long long>(
+                  clients ? bufferBytes / clients : 0),
+                static_cast<unsigned long long>(maxClientBufferBytes),
+                static_cast<unsigned long long>(bufferBudget));
+  std::string text(buf);
+  if (accessDenied || addressLimited) {
+    text += "; refused: denied=" + std::to_string(accessDenied) +
+            " per address=" + std::to_string(addressLimited);
+  }
+  if (batches) {
+    text += "; batches=" + std::to_string(batches) +
+            " records=" + std::to_string(batchRecords);
+  }
+  if (parkedSessions || sessionsResumed) {
+    text += "; resume: parked=" + std::to_string(parkedSessions) +
+            " resumed=" + std::to_string(sessionsResumed);
+  }
+  if (listenerClients.size() > 1) {
+    text += "; listeners:";
+    for (std::size_t count : listenerClients)
+      text += " " + std::to_string(count);
+  }
+  return text;
+}
+
 void Server::SendToClient(ClientHandle clientHandle, const std::string_view& msg)
 {
   std::lock_guard<std::mutex> lock(m_listenerMutex);
-  if (m_clients.find(clientHandle) == m_clients.end())
+  auto clIter = m_clients.find(clientHandle);
+  if (clIter == m_clients.end())
     return;
-  m_clients[clientHandle]->forSend.Push(msg.data(), msg.length());
+  clIter->second->forSend.Push(msg.data(), msg.length());
+}
+
+ClientWriter Server::GetWriter(ClientHandle clientHandle)
+{
+  std::lock_guard<std::mutex> lock(m_listenerMutex);
+  auto clIter = m_clients.find(clientHandle);
+  if (clIter == m_clients.end())
+    return ClientWriter();
+  // shares the client's lifetime, points at its queue
+  return ClientWriter(std::shared_ptr<SocketSendQueue>(
+                        clIter->second, &clIter->second->forSend),
+                      &m_commandPrompt);
+}
+
+bool Server::SendFileToClient(ClientHandle clientHandle, int fd, off_t offset,
+                              size_t length)
+{
+  std::lock_guard<std::mutex> lock(m_listenerMutex);
+  auto clIter = m_clients.find(clientHandle);
+  if (clIter == m_clients.end())
+    return false;
+  return clIter->second->forSend.PushFile(fd, offset, length);
+}
+
+bool Server::SendPipeToClient(ClientHandle clientHandle, int pipeFd,
+                              size_t length)
+{
+  std::lock_guard<std::mutex> lock(m_listenerMutex);
+  auto clIter = m_clients.find(clientHandle);
+  if (clIter == m_clients.end())
+    return false;
+  return clIter->second->forSend.PushPipe(pipeFd, length);
+}
+
+bool Server::SendFrame(ClientHandle clientHandle,
+                       const std::string_view& payload)
+{
+  if (payload.size() > UINT32_MAX)
+    return false;
+  std::lock_guard<std::mutex> lock(m_listenerMutex);
+  auto clIter = m_clients.find(clientHandle);
+  if (clIter == m_clients.end())
+    return false;
+  Protocol protocol = ListenerOf(clIter->second).protocol;
+  if (ProtocolTelnet == protocol)
+    return false;
+  std::byte header[FrameReader::MAX_HEADER];
+  size_t headerSize =
+    FrameReader::EncodeHeader(FrameFormatOf(protocol),
+                              static_cast<uint32_t>(payload.size()), header);
+  // one push, frames sent from several threads don't interleave
+  clIter->second->forSend.Push(header, headerSize, payload.data(),
+                               payload.size());
+  return true;
 }
 
 void Server::ShowPrompt(ClientHandle clientHandle)
 {
   std::lock_guard<std::mutex> lock(m_listenerMutex);
-  if (m_clients.find(clientHandle) == m_clients.end())
+  auto clIter = m_clients.find(clientHandle);
+  if (clIter == m_clients.end())
     return;
-  m_clients[clientHandle]->forSend.Push(
-    m_commandPrompt.c_str(), m_commandPrompt.length());
+  clIter->second->forSend.Push(m_commandPrompt.c_str(),
+                               m_commandPrompt.length());
+}
+
+int Server::GetClientListener(ClientHandle clientHandle)
+{
+  std::lock_guard<std::mutex> lock(m_listenerMutex);
+  auto clIter = m_clients.find(clientHandle);
+  if (clIter == m_clients.end())
+    return -1;
+  return static_cast<int>(clIter->second->listener);
 }
 
 void Server::CloseClient(ClientHandle clientHandle)
 {
   std::lock_guard<std::mutex> lock(m_listenerMutex);
-  if (m_clients.find(clientHandle) == m_clients.end())
+  auto clIter = m_clients.find(clientHandle);
+  if (clIter == m_clients.end())
     return;
-  m_clients[clientHandle]->connected = false;
+  clIter->second->connected = false;
+  if (clIter->second->parked && m_resumeTable) {
+    // ended by the listener thread, this may run inside a callback
+    m_resumeTable->Remove(clIter->second->resumeToken);
+    m_resumeEnded.push_back(clientHandle);
+  }
+}
+
+bool Server::HandOver(const std::string& channelPath)
+{
+  DescriptorChannel channel;
+  if (!channel.Connect(channelPath, HANDOFF_TIMEOUT))
+    return false;
+
+  auto start = std::chrono::steady_clock::now();
+  m_handingOver = true;
+  Stop();
+  m_handingOver = false;
+
+  // the sockets are released, never shut down: the other process owns them
+  // transports are left out, their listeners pass as none
+  // value initialized, no stale stack bytes leave in the padding
+  HandoffRecord record{};
+  record.magic = HANDOFF_MAGIC;
+  record.count = static_cast<uint32_t>(m_handedOver.size());
+  record.listeners = static_cast<uint16_t>(m_listeners.size());
+  bool result = true;
+  for (std::size_t i = 0; i < m_listeners.size(); i++) {
+    SocketPtr& socket = m_listeners[i]->socket;
+    PlatformSocket listener = (socket && !m_listeners[i]->parameters.transport)
+                                ? socket->Release()
+                                : INVALID_SOCKET;
+    socket = nullptr;
+    record.listener = static_cast<uint16_t>(i);
+    result = channel.Send(listener, &record, sizeof(record)) && result;
+    if (listener != INVALID_SOCKET)
+      close(listener);
+    record.count = 0;
+    record.listeners = 0;
+  }
+  for (auto& client : m_handedOver) {
+    record.handle = client->clientHandle;
+    record.authenticated = client->authenticated ? 1 : 0;
+    record.listener = static_cast<uint16_t>(client->listener);
+    PlatformSocket sock = client->socket->Release();
+    client->socket = nullptr;
+    result = channel.Send(sock, &record, sizeof(record)) && result;
+    close(sock);
+  }
+
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now() - start);
+  ESP_LOGI(TAG, "handed over %zu clients in %lld ms", m_handedOver.size(),
+           static_cast<long long>(elapsed.count()));
+  m_handedOver.clear();
+  return result;
+}
+
+bool Server::TakeOver(const std::string& channelPath,
+                      std::chrono::milliseconds timeout)
+{
+  if (m_listenerThread.joinable())
+    return false;
+  for (const auto& listener : m_listeners) {
+    if (listener->socket)
+      return false;
+  }
+  DescriptorChannel channel;
+  if (!channel.Accept(channelPath, timeout))
+    return false;
+
+  auto start = std::chrono::steady_clock::now();
+  HandoffRecord header{};
+  PlatformSocket sock;
+  if (!channel.Receive(&sock, &header, sizeof(header), HANDOFF_TIMEOUT) ||
+      HANDOFF_MAGIC != header.magic) {
+    if (sock != INVALID_SOCKET)
+      close(sock);
+    ESP_LOGE(TAG, "bad handoff from %s, format %08x", channelPath.c_str(),
+             header.magic);
+    return false;
+  }
+  // listeners are matched by position, surplus ones are closed; the header
+  // carries the first one
+  std::size_t listeners = std::max<std::size_t>(header.listeners, 1);
+  for (std::size_t i = 0; i < listeners; i++) {
+    if (i > 0) {
+      HandoffRecord record{};
+      if (!channel.Receive(&sock, &record, sizeof(record), HANDOFF_TIMEOUT)) {
+        ESP_LOGE(TAG, "handoff from %s cut short", channelPath.c_str());
+        return false;
+      }
+    }
+    if (sock == INVALID_SOCKET)
+      continue;
+    if (i >= m_listeners.size()) {
+      close(sock);
+      continue;
+    }
+    Listener& listener = *m_listeners[i];
+    listener.socket =
+      Socket::CreateSocket(ListenerAddress(listener.parameters), sock);
+    listener.socket->SetNonBlocking(true);
+  }
+
+  std::lock_guard<std::mutex> lock(m_listenerMutex);
+  for (uint32_t i = 0; i < header.count; i++) {
+    HandoffRecord record{};
+    if (!channel.Receive(&sock, &record, sizeof(record), HANDOFF_TIMEOUT))
+      break;
+    if (sock == INVALID_SOCKET || HANDOFF_MAGIC != record.magic)
+      continue;
+    // a listener this process doesn't have
+    std::size_t index = record.listener < m_listeners.size()
+                          ? record.listener
+                          : 0;
+    Listener& listener = *m_listeners[index];
+    auto client = std::make_shared<Client>(
+      *this, record.handle, true,
+      Socket::CreateSocket(ListenerAddress(listener.parameters), sock), index);
+    client->authenticated = (0 != record.authenticated);
+    client->peerCounted = client->socket->LoadPeerAddress() &&
+                          client->socket->GetPeerIpv4(&client->peerIp,
+                                                      nullptr);
+    HoldConnection(client);
+    m_clients[client->clientHandle] = client;
+    m_clientHandlesCounter = std::max(m_clientHandlesCounter, record.handle);
+  }
+
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now() - start);
+  ESP_LOGI(TAG, "took over %zu clients in %lld ms", m_clients.size(),
+           static_cast<long long>(elapsed.count()));
+  return true;
 }
 
 ServerPtr Server::CreateServer(unsigned short int port,
@@ -0,0 +1,58 @@
+#include "ft-socket/ft_telnet.hpp"
+
+#include <utility>
+
+namespace FtTCP {
+
+std::size_t TelnetInput::Filter(void* data, std::size_t size)
+{
+  uint8_t* bytes = static_cast<uint8_t*>(data);
+  std::size_t kept = 0;
+  for (std::size_t i = 0; i < size; i++) {
+    uint8_t byte = bytes[i];
+    switch (m_state) {
+    case Data:
+      if (Telnet::IAC == byte)
+        m_state = Command;
+      else
+        bytes[kept++] = byte;
+      break;
+    case Command:
+      if (Telnet::IAC == byte) {
+        // escaped 255 is data
+        bytes[kept++] = byte;
+        m_state = Data;
+      }
+      else if (byte >= Telnet::WILL && byte <= Telnet::DONT) {
+        m_command = byte;
+        m_state = Option;
+      }
+      else if (Telnet::SB == byte)
+        m_state = Subnegotiation;
+      else
+        m_state = Data;
+      break;
+    case Option:
+      if (Telnet::COMPRESS2 == byte && Telnet::DO == m_command)
+        m_doCompress = true;
+      m_state = Data;
+      break;
+    case Subnegotiation:
+      if (Telnet::IAC == byte)
+        m_state = SubnegotiationIac;
+      break;
+    case SubnegotiationIac:
+    default:
+      m_state = (Telnet::SE == byte) ? Data : Subnegotiation;
+      break;
+    }
+  }
+  return kept;
+}
+
+bool TelnetInput::TakeDoCompress()
+{
+  return std::exchange(m_doCompress, false);
+}
+
+} // namespace FtTCP
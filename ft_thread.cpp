@@ -0,0 +1,41 @@
+#include "ft-socket/ft_thread.hpp"
+
+#include "esp_log.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace FtTCP {
+
+static constexpr size_t MAX_THREAD_NAME{15};
+
+void ThreadPlacement::Apply(const std::string& suffix) const
+{
+  if (!name.empty())
+    SetCurrentThreadName(name + "-" + suffix);
+  if (!cpus.empty())
+    SetCurrentThreadAffinity(cpus);
+}
+
+bool SetCurrentThreadAffinity(const std::vector<int>& cpus)
+{
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus) {
+    if (cpu >= 0 && cpu < CPU_SETSIZE)
+      CPU_SET(cpu, &set);
+  }
+  int result = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if (result) {
+    ESP_LOGW("THREAD", "can't set affinity: %d", result);
+    return false;
+  }
+  return true;
+}
+
+void SetCurrentThreadName(const std::string& name)
+{
+  pthread_setname_np(pthread_self(), name.substr(0, MAX_THREAD_NAME).c_str());
+}
+
+} // namespace FtTCP
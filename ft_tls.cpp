@@ -0,0 +1,303 @@
+#include "ft-socket/ft_tls.hpp"
+
+#include "esp_log.h"
+
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+
+#ifdef FT_SOCKET_TLS
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#endif
+
+namespace FtTCP {
+
+static constexpr char TAG[] = "TLS";
+
+#ifdef FT_SOCKET_TLS
+
+static constexpr unsigned char SESSION_ID_CONTEXT[] = "ft-socket";
+
+TlsContext::TlsContext(bool isServer) : m_isServer(isServer)
+{
+  m_context = SSL_CTX_new(isServer ? TLS_server_method() : TLS_client_method());
+  if (nullptr == m_context) {
+    ESP_LOGE(TAG, "SSL_CTX_new failed %lu", ERR_get_error());
+    return;
+  }
+  SSL_CTX_set_min_proto_version(m_context, TLS1_2_VERSION);
+  // the record layer moves to the kernel after the handshake when possible
+  SSL_CTX_set_options(m_context, SSL_OP_ENABLE_KTLS);
+  SSL_CTX_set_app_data(m_context, this);
+  if (isServer) {
+    SSL_CTX_set_session_id_context(m_context, SESSION_ID_CONTEXT,
+                                   sizeof(SESSION_ID_CONTEXT) - 1);
+    SSL_CTX_set_session_cache_mode(m_context, SSL_SESS_CACHE_SERVER);
+  }
+  else {
+    SSL_CTX_set_session_cache_mode(
+      m_context, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(m_context, &TlsContext::OnNewSession);
+  }
+}
+
+TlsContext::~TlsContext()
+{
+  ForgetSession();
+  if (m_context)
+    SSL_CTX_free(m_context);
+}
+
+int TlsContext::OnNewSession(ssl_st* ssl, ssl_session_st* session)
+{
+  auto* self =
+    static_cast<TlsContext*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+  if (nullptr == self)
+    return 0;
+  self->StoreSession(session);
+  // we keep the reference
+  return 1;
+}
+
+bool TlsContext::LoadCertificate(const std::string& certFile,
+                                 const std::string& keyFile)
+{
+  if (!m_context)
+    return false;
+  if (1 != SSL_CTX_use_certificate_chain_file(m_context, certFile.c_str()) ||
+      1 != SSL_CTX_use_PrivateKey_file(m_context, keyFile.c_str(),
+                                       SSL_FILETYPE_PEM) ||
+      1 != SSL_CTX_check_private_key(m_context)) {
+    ESP_LOGE(TAG, "can't load certificate %s: %lu", certFile.c_str(),
+             ERR_get_error());
+    return false;
+  }
+  return true;
+}
+
+bool TlsContext::GenerateSelfSigned(const std::string& commonName)
+{
+  if (!m_context)
+    return false;
+  EVP_PKEY* key = EVP_EC_gen("P-256");
+  X509* cert = X509_new();
+  bool result = false;
+  if (key && cert) {
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 365L * 24 * 3600);
+    X509_set_pubkey(cert, key);
+    X509_NAME* name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(
+      name, "CN", MBSTRING_ASC,
+      reinterpret_cast<const unsigned char*>(commonName.c_str()), -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+    result = X509_sign(cert, key, EVP_sha256()) > 0 &&
+             1 == SSL_CTX_use_certificate(m_context, cert) &&
+             1 == SSL_CTX_use_PrivateKey(m_context, key);
+  }
+  if (!result)
+    ESP_LOGE(TAG, "can't generate certificate: %lu", ERR_get_error());
+  X509_free(cert);
+  EVP_PKEY_free(key);
+  return result;
+}
+
+bool TlsContext::SetVerify(const TlsVerifyParameters& verify)
+{
+  if (!m_context || m_isServer)
+    return false;
+  m_hostName = verify.hostName;
+  if (!verify.verifyPeer) {
+    SSL_CTX_set_verify(m_context, SSL_VERIFY_NONE, nullptr);
+    return true;
+  }
+  bool loaded =
+    (verify.caFile.empty() && verify.caPath.empty())
+      ? 1 == SSL_CTX_set_default_verify_paths(m_context)
+      : 1 == SSL_CTX_load_verify_locations(
+               m_context, verify.caFile.empty() ? nullptr : verify.caFile.c_str(),
+               verify.caPath.empty() ? nullptr : verify.caPath.c_str());
+  if (!loaded) {
+    ESP_LOGE(TAG, "can't load CAs %s%s: %lu", verify.caFile.c_str(),
+             verify.caPath.c_str(), ERR_get_error());
+    return false;
+  }
+  if (!verify.hostName.empty() &&
+      1 != X509_VERIFY_PARAM_set1_host(SSL_CTX_get0_param(m_context),
+                                       verify.hostName.c_str(), 0)) {
+    ESP_LOGE(TAG, "bad host name %s", verify.hostName.c_str());
+    return false;
+  }
+  // a failed check fails the handshake
+  SSL_CTX_set_verify(m_context, SSL_VERIFY_PEER, nullptr);
+  return true;
+}
+
+// the stock socket BIO's write with MSG_NOSIGNAL; once kTLS sends, the
+// records and their control messages are the stock BIO's again, which can
+// raise SIGPIPE
+static int WriteNoSignal(BIO* bio, const char* data, int size)
+{
+  if (BIO_get_ktls_send(bio))
+    return BIO_meth_get_write(BIO_s_socket())(bio, data, size);
+  int socket = -1;
+  BIO_get_fd(bio, &socket);
+  errno = 0;
+  int sent = static_cast<int>(send(socket, data, size, MSG_NOSIGNAL));
+  BIO_clear_retry_flags(bio);
+  if (sent <= 0 && BIO_sock_should_retry(sent))
+    BIO_set_retry_write(bio);
+  return sent;
+}
+
+static int PutsNoSignal(BIO* bio, const char* text)
+{
+  return WriteNoSignal(bio, text, static_cast<int>(strlen(text)));
+}
+
+const bio_method_st* TlsContext::GetSocketMethod()
+{
+  static BIO_METHOD* method = []() {
+    const BIO_METHOD* socket = BIO_s_socket();
+    BIO_METHOD* result =
+      BIO_meth_new(BIO_TYPE_SOCKET, "socket with MSG_NOSIGNAL");
+    BIO_meth_set_write(result, WriteNoSignal);
+    BIO_meth_set_puts(result, PutsNoSignal);
+    BIO_meth_set_read(result, BIO_meth_get_read(socket));
+    BIO_meth_set_ctrl(result, BIO_meth_get_ctrl(socket));
+    BIO_meth_set_create(result, BIO_meth_get_create(socket));
+    BIO_meth_set_destroy(result, BIO_meth_get_destroy(socket));
+    return result;
+  }();
+  return method;
+}
+
+ssl_session_st* TlsContext::AcquireSession()
+{
+  std::lock_guard<std::mutex> lock(m_sessionMutex);
+  if (m_session)
+    SSL_SESSION_up_ref(m_session);
+  return m_session;
+}
+
+void TlsContext::StoreSession(ssl_session_st* session)
+{
+  std::lock_guard<std::mutex> lock(m_sessionMutex);
+  if (m_session)
+    SSL_SESSION_free(m_session);
+  m_session = session;
+}
+
+void TlsContext::ForgetSession()
+{
+  StoreSession(nullptr);
+}
+
+bool TlsContext::IsAvailable()
+{
+  return true;
+}
+
+#else // FT_SOCKET_TLS
+
+TlsContext::TlsContext(bool isServer) : m_isServer(isServer)
+{
+  ESP_LOGW(TAG, "built without TLS support");
+}
+
+TlsContext::~TlsContext() = default;
+
+int TlsContext::OnNewSession(ssl_st*, ssl_session_st*)
+{
+  return 0;
+}
+
+bool TlsContext::LoadCertificate(const std::string&, const std::string&)
+{
+  return false;
+}
+
+bool TlsContext::GenerateSelfSigned(const std::string&)
+{
+  return false;
+}
+
+bool TlsContext::SetVerify(const TlsVerifyParameters&)
+{
+  return false;
+}
+
+const bio_method_st* TlsContext::GetSocketMethod()
+{
+  return nullptr;
+}
+
+ssl_session_st* TlsContext::AcquireSession()
+{
+  return nullptr;
+}
+
+void TlsContext::StoreSession(ssl_session_st*) {}
+
+void TlsContext::ForgetSession() {}
+
+bool TlsContext::IsAvailable()
+{
+  return false;
+}
+
+#endif // FT_SOCKET_TLS
+
+bool TlsContext::IsValid() const
+{
+  return nullptr != m_context;
+}
+
+bool TlsContext::IsServer() const
+{
+  return m_isServer;
+}
+
+ssl_ctx_st* TlsContext::GetContext() const
+{
+  return m_context;
+}
+
+const std::string& TlsContext::GetHostName() const
+{
+  return m_hostName;
+}
+
+TlsContextPtr TlsContext::CreateServerContext(const std::string& certFile,
+                                              const std::string& keyFile)
+{
+  auto context = std::make_shared<TlsContext>(true);
+  if (!context->LoadCertificate(certFile, keyFile))
+    return nullptr;
+  return context;
+}
+
+TlsContextPtr TlsContext::CreateSelfSignedServerContext(
+  const std::string& commonName)
+{
+  auto context = std::make_shared<TlsContext>(true);
+  if (!context->GenerateSelfSigned(commonName))
+    return nullptr;
+  return context;
+}
+
+TlsContextPtr TlsContext::CreateClientContext(
+  const TlsVerifyParameters& verify)
+{
+  auto context = std::make_shared<TlsContext>(false);
+  if (!context->IsValid() || !context->SetVerify(verify))
+    return nullptr;
+  return context;
+}
+
+} // namespace FtTCP
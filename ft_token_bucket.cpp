@@ -0,0 +1,60 @@
+#include "ft-socket/ft_token_bucket.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace FtTCP {
+
+TokenBucket::TokenBucket(double rate, double burst)
+  : m_rate(rate)
+  // below one token nothing would ever pass
+  , m_burst(std::max(burst > 0 ? burst : rate, 1.0))
+  , m_tokens(m_burst)
+  , m_updated(Clock::now())
+{
+}
+
+void TokenBucket::Refill()
+{
+  auto now = Clock::now();
+  double elapsed = std::chrono::duration<double>(now - m_updated).count();
+  m_updated = now;
+  m_tokens = std::min(m_burst, m_tokens + elapsed * m_rate);
+}
+
+bool TokenBucket::IsLimited() const
+{
+  return m_rate > 0;
+}
+
+std::size_t TokenBucket::GetBurst() const
+{
+  return IsLimited() ? static_cast<std::size_t>(m_burst) : SIZE_MAX;
+}
+
+std::size_t TokenBucket::Available()
+{
+  if (!IsLimited())
+    return SIZE_MAX;
+  Refill();
+  return (m_tokens < 1) ? 0 : static_cast<std::size_t>(m_tokens);
+}
+
+void TokenBucket::Take(double tokens)
+{
+  if (IsLimited())
+    m_tokens -= tokens;
+}
+
+bool TokenBucket::TryTake(double tokens)
+{
+  if (!IsLimited())
+    return true;
+  Refill();
+  if (m_tokens < tokens)
+    return false;
+  m_tokens -= tokens;
+  return true;
+}
+
+} // namespace FtTCP
@@ -0,0 +1,207 @@
+#include "ft-socket/ft_trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <pthread.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace FtTCP {
+namespace Trace {
+
+#ifdef FT_SOCKET_TRACE
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// the counter rate is measured for at least this long
+constexpr std::chrono::milliseconds CALIBRATION{10};
+
+struct Event {
+  const char* name;
+  uint64_t start;
+  uint64_t end;
+  uint64_t value;
+};
+
+// written by its thread only; the dump reads it racily and drops what
+// may have been overwritten while copying
+struct ThreadRing {
+  std::unique_ptr<Event[]> events{new Event[EVENTS_PER_THREAD]};
+  std::atomic<uint64_t> written{0};
+  pid_t tid{0};
+  std::string name;
+};
+
+struct Registry {
+  std::mutex mutex;
+  std::vector<std::shared_ptr<ThreadRing>> running;
+  std::deque<std::shared_ptr<ThreadRing>> finished;
+  // where ticks are converted to time from
+  uint64_t originTicks{Now()};
+  Clock::time_point origin{Clock::now()};
+};
+
+Registry& GetRegistry()
+{
+  // never destroyed: threads may still record during exit
+  static Registry* registry = new Registry();
+  return *registry;
+}
+
+// registers the thread's ring and moves it to the finished ones on exit
+class ThreadRingHolder {
+public:
+  std::shared_ptr<ThreadRing> ring;
+
+  ThreadRingHolder() : ring(std::make_shared<ThreadRing>())
+  {
+    ring->tid = gettid();
+    char name[16] = {};
+    if (0 == pthread_getname_np(pthread_self(), name, sizeof(name)))
+      ring->name = name;
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.running.push_back(ring);
+  }
+
+  ~ThreadRingHolder()
+  {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    auto it = std::find(registry.running.begin(), registry.running.end(), ring);
+    if (it != registry.running.end())
+      registry.running.erase(it);
+    if (0 == ring->written.load(std::memory_order_relaxed))
+      return;
+    registry.finished.push_back(ring);
+    if (registry.finished.size() > MAX_FINISHED_THREADS)
+      registry.finished.pop_front();
+  }
+};
+
+// ticks per microsecond since the origin
+double TicksPerMicrosecond(const Registry& registry)
+{
+  auto elapsed = Clock::now() - registry.origin;
+  if (elapsed < CALIBRATION) {
+    std::this_thread::sleep_for(CALIBRATION - elapsed);
+    elapsed = Clock::now() - registry.origin;
+  }
+  uint64_t ticks = Now() - registry.originTicks;
+  return ticks /
+         std::chrono::duration<double, std::micro>(elapsed).count();
+}
+
+void WriteEscaped(std::ostream& out, const std::string& text)
+{
+  for (char c : text) {
+    if ('"' == c || '\\' == c)
+      out << '\\';
+    if (static_cast<unsigned char>(c) >= ' ')
+      out << c;
+  }
+}
+
+void WriteRing(std::ostream& out, const ThreadRing& ring, pid_t pid,
+               uint64_t originTicks, double ticksPerUs, bool* first)
+{
+  uint64_t written = ring.written.load(std::memory_order_acquire);
+  std::vector<Event> events(ring.events.get(),
+                            ring.events.get() + EVENTS_PER_THREAD);
+  uint64_t after = ring.written.load(std::memory_order_acquire);
+  uint64_t from = (after > EVENTS_PER_THREAD) ? after - EVENTS_PER_THREAD : 0;
+
+  out << (*first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\","
+      << "\"pid\":" << pid << ",\"tid\":" << ring.tid
+      << ",\"args\":{\"name\":\"";
+  WriteEscaped(out, ring.name);
+  out << "\"}}";
+  *first = false;
+  for (uint64_t i = from; i < written; i++) {
+    const Event& event = events[i % EVENTS_PER_THREAD];
+    // recorded before the origin by a clock on another core
+    double start = (event.start > originTicks)
+                     ? (event.start - originTicks) / ticksPerUs
+                     : 0;
+    out << ",\n{\"name\":\"" << event.name << "\",\"pid\":" << pid
+        << ",\"tid\":" << ring.tid << ",\"ts\":" << start;
+    if (event.end == event.start)
+      out << ",\"ph\":\"i\",\"s\":\"t\"";
+    else
+      out << ",\"ph\":\"X\",\"dur\":" << (event.end - event.start) / ticksPerUs;
+    out << ",\"args\":{\"value\":" << event.value << "}}";
+  }
+}
+
+} // namespace
+
+void Record(const char* name, uint64_t start, uint64_t end, uint64_t value)
+{
+  thread_local ThreadRingHolder holder;
+  ThreadRing& ring = *holder.ring;
+  uint64_t index = ring.written.load(std::memory_order_relaxed);
+  ring.events[index % EVENTS_PER_THREAD] = Event{name, start, end, value};
+  ring.written.store(index + 1, std::memory_order_release);
+}
+
+bool IsEnabled()
+{
+  return true;
+}
+
+void WriteChromeJson(std::ostream& out)
+{
+  Registry& registry = GetRegistry();
+  double ticksPerUs = TicksPerMicrosecond(registry);
+  std::vector<std::shared_ptr<ThreadRing>> rings;
+  {
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    rings.assign(registry.finished.begin(), registry.finished.end());
+    rings.insert(rings.end(), registry.running.begin(),
+                 registry.running.end());
+  }
+  pid_t pid = getpid();
+  bool first = true;
+  std::ios_base::fmtflags flags = out.flags();
+  out << std::fixed;
+  out.precision(3);
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  for (const auto& ring : rings)
+    WriteRing(out, *ring, pid, registry.originTicks, ticksPerUs, &first);
+  out << "\n]}\n";
+  out.flags(flags);
+}
+#else
+void Record(const char*, uint64_t, uint64_t, uint64_t)
+{
+}
+
+bool IsEnabled()
+{
+  return false;
+}
+
+void WriteChromeJson(std::ostream& out)
+{
+  out << "{\"traceEvents\":[]}\n";
+}
+#endif
+
+bool DumpChromeJson(const std::string& path)
+{
+  std::ofstream out(path, std::ios::trunc);
+  if (!out)
+    return false;
+  WriteChromeJson(out);
+  return static_cast<bool>(out);
+}
+
+} // namespace Trace
+} // namespace FtTCP
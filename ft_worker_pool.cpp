@@ -0,0 +1,175 @@
+#include "ft-socket/ft_worker_pool.hpp"
+
+#include <algorithm>
+
+namespace FtTCP {
+
+WorkerPool::WorkerPool(std::size_t threads, std::size_t maxQueue,
+                       const ThreadPlacement& placement)
+  : m_maxQueue(maxQueue)
+{
+  for (std::size_t i = 0; i < threads; i++) {
+    m_workers.emplace_back([this, i, placement]() {
+      placement.Apply(std::to_string(i));
+      this->Run();
+    });
+  }
+}
+
+WorkerPool::~WorkerPool()
+{
+  Stop();
+}
+
+void WorkerPool::Run()
+{
+  while (true) {
+    WorkerTask task;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_wakeup.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+      if (m_stopping)
+        return;
+      task = std::move(m_tasks.front());
+      m_tasks.pop_front();
+      m_executed++;
+    }
+    task();
+  }
+}
+
+bool WorkerPool::Post(WorkerTask task)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_stopping || m_tasks.size() >= m_maxQueue) {
+      m_rejected++;
+      return false;
+    }
+    m_tasks.push_back(std::move(task));
+    m_maxDepth = std::max(m_maxDepth, m_tasks.size());
+  }
+  m_wakeup.notify_one();
+  return true;
+}
+
+void WorkerPool::Stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+  m_wakeup.notify_all();
+  for (auto& worker : m_workers) {
+    if (worker.joinable())
+      worker.join();
+  }
+  // destroying the tasks breaks any promise they still hold
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_tasks.clear();
+}
+
+std::size_t WorkerPool::QueueDepth()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_tasks.size();
+}
+
+WorkerPoolStats WorkerPool::GetStats()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  WorkerPoolStats stats;
+  stats.queueDepth = m_tasks.size();
+  stats.maxQueueDepth = m_maxDepth;
+  stats.executed = m_executed;
+  stats.rejected = m_rejected;
+  return stats;
+}
+
+WorkerPoolPtr WorkerPool::CreateWorkerPool(std::size_t threads,
+                                           std::size_t maxQueue,
+                                           const ThreadPlacement& placement)
+{
+  return std::make_shared<WorkerPool>(threads, maxQueue, placement);
+}
+
+Strand::Strand(WorkerPoolPtr pool, std::size_t maxPending)
+  : m_pool(pool), m_maxPending(maxPending)
+{
+}
+
+bool Strand::Post(WorkerTask task, bool mandatory)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!mandatory && m_tasks.size() >= m_maxPending)
+      return false;
+    m_tasks.push_back(std::move(task));
+    if (m_scheduled)
+      return true;
+    m_scheduled = true;
+  }
+  auto self = shared_from_this();
+  if (m_pool->Post([self]() { self->Drain(); }))
+    return true;
+  if (mandatory) {
+    // nothing of this strand runs elsewhere, order is kept
+    Drain();
+    return true;
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_tasks.pop_back();
+  m_scheduled = false;
+  m_idle.notify_all();
+  return false;
+}
+
+void Strand::Drain()
+{
+  for (std::size_t done = 0;; done++) {
+    WorkerTask task;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_tasks.empty()) {
+        m_scheduled = false;
+        m_idle.notify_all();
+        return;
+      }
+      if (done == MAX_BATCH) {
+        auto self = shared_from_this();
+        // give the pool threads to the other strands, go on if it's full
+        if (m_pool->Post([self]() { self->Drain(); }))
+          return;
+        done = 0;
+      }
+      task = std::move(m_tasks.front());
+      m_tasks.pop_front();
+    }
+    task();
+  }
+}
+
+std::size_t Strand::Pending()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_tasks.size();
+}
+
+bool Strand::IsFull()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_tasks.size() >= m_maxPending;
+}
+
+bool Strand::WaitIdle(std::chrono::milliseconds timeout)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  return m_idle.wait_for(lock, timeout, [this]() { return !m_scheduled; });
+}
+
+StrandPtr Strand::CreateStrand(WorkerPoolPtr pool, std::size_t maxPending)
+{
+  return std::make_shared<Strand>(pool, maxPending);
+}
+
+} // namespace FtTCP
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace FtTCP {
+
+// A discovery announcement as received from one server.
+struct Announcement {
+  // the sender, filled in by the receiver
+  std::string host;
+  uint16_t port{0};
+  uint16_t connections{0};
+  uint16_t maxConnections{0};
+  // application figure, 0 idle .. 1000 saturated
+  uint16_t load{0};
+  std::string appVersion;
+  std::chrono::steady_clock::time_point received;
+
+  // the higher of connection occupancy and load, 0 .. 1000
+  unsigned Score() const;
+  bool IsFull() const;
+};
+
+// The datagram a server broadcasts, built once; the load fields sit at
+// fixed offsets and are patched in place. Network byte order:
+//   0 magic "FTAN"   4 format   5 header size   6 port
+//   8 connections   10 max connections   12 load   14 version length
+//   header size: application version
+// Newer formats may only grow the header, older readers skip the rest.
+class AnnouncementPacket {
+public:
+  static constexpr uint8_t FORMAT{1};
+  static constexpr std::size_t HEADER_SIZE{16};
+  static constexpr std::size_t MAX_APP_VERSION{255};
+
+private:
+  std::vector<uint8_t> m_data;
+
+  void Patch(std::size_t offset, uint16_t value);
+
+public:
+  AnnouncementPacket(const std::string& appVersion, uint16_t port,
+                     uint16_t maxConnections);
+
+  void SetConnections(uint16_t connections);
+  void SetLoad(uint16_t load);
+  const void* Data() const;
+  std::size_t Size() const;
+
+  // false for anything but a well formed announcement
+  static bool Parse(const void* data, std::size_t size,
+                    Announcement* announcement);
+};
+
+// Client side discovery: the latest announcement of every server heard
+// from, and where to connect next. Thread safe.
+class AnnouncementTable {
+private:
+  std::mutex m_mutex;
+  // by host:port
+  std::map<std::string, Announcement> m_servers;
+  std::chrono::seconds m_maxAge;
+
+public:
+  // servers silent for longer than maxAge are forgotten
+  AnnouncementTable(std::chrono::seconds maxAge = std::chrono::seconds(30));
+
+  // false when the datagram isn't an announcement
+  bool Add(const std::string& host, const void* data, std::size_t size);
+  // the live servers, least loaded first
+  std::vector<Announcement> GetServers();
+  // the least loaded server with room; equally loaded ones are picked at
+  // random so clients reading the same announcements don't all pile onto
+  // one. False when none is known.
+  bool PickLeastLoaded(Announcement* announcement);
+};
+
+} // namespace FtTCP
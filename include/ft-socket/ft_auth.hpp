@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <future>
+
+namespace FtTCP {
+
+// outcome of a password check, completed later by a worker thread
+using AuthResult = std::future<bool>;
+
+AuthResult MakeAuthResult(bool accepted);
+
+// Compares a secret with a candidate without returning early on the first
+// mismatch. The running time depends on the candidate length only.
+bool ConstantTimeEquals(const void* secret, std::size_t secretSize,
+                        const void* candidate, std::size_t candidateSize);
+
+} // namespace FtTCP
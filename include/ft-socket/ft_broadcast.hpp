@@ -3,6 +3,7 @@
 #include <atomic>
 #include <chrono>
 #include <thread>
+#include "ft_announcement.hpp"
 #include "ft_socket.hpp"
 
 namespace FtTCP {
@@ -11,27 +12,56 @@ class Broadcast;
 
 using BroadcastPtr = std::shared_ptr<Broadcast>;
 
+// Announcements to a group instead of the whole segment: only hosts that
+// joined it process them, and routers may forward them.
+struct MulticastParameters {
+  // administratively scoped, stays inside the organization
+  std::string group = "239.255.30.55";
+  // router hops, 1 keeps announcements on the local segment
+  int ttl = 1;
+  // listeners on this host hear us too
+  bool loopback = true;
+};
+
 class Broadcast {
 private:
   SocketPtr m_socket;
   std::atomic_bool m_shutdown{false};
   std::string m_interfaceIP;
-  bool m_connected;
-  std::string m_appVersion;
-  uint32_t m_attemp;
+  std::atomic_bool m_connected;
+  AnnouncementPacket m_packet;
+  uint16_t m_connections{0};
+  uint16_t m_load{0};
+  // reset by UpdateLoad() on the caller's thread
+  std::atomic<uint32_t> m_attemp{0};
+  bool m_isMulticast{false};
+  MulticastParameters m_multicast;
   std::mutex m_updateMutex;
   std::thread m_workerThread;
   static constexpr std::chrono::seconds m_attempTimeout{5};
   static constexpr std::chrono::milliseconds m_throtleTime{300};
   static constexpr uint32_t m_maxAttempCount{11};
+  // after the attempts, keeps AnnouncementTable entries (30 s) alive
+  static constexpr std::chrono::seconds m_heartbeatTimeout{10};
   static constexpr uint16_t m_port{3055};
 public:
-  Broadcast(const std::string& app_version);
+  // servicePort and maxConnections go into every announcement
+  Broadcast(const std::string& app_version, uint16_t servicePort = 0,
+            uint16_t maxConnections = 0);
   bool Start();
   void Stop();
+  // interface_ip: the directed broadcast target, in multicast mode the
+  // outbound interface (empty for the kernel's choice)
   bool Renew(bool connected, std::string interface_ip = std::string(""));
+  // announce to a group from the next Renew() on
+  void SetMulticast(const MulticastParameters& multicast);
+  // patches the announcement; a change restarts the announcing attempts
+  // so clients hear about it
+  void UpdateLoad(uint16_t connections, uint16_t load);
 
-  static BroadcastPtr CreateBroadcast(const std::string& appVersion);
+  static BroadcastPtr CreateBroadcast(const std::string& appVersion,
+                                      uint16_t servicePort = 0,
+                                      uint16_t maxConnections = 0);
 private:
   void Run();
   bool SendBroadcastPacket();
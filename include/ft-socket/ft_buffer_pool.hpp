@@ -0,0 +1,120 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace FtTCP {
+
+struct BufferPoolStats {
+  uint64_t acquired{0};
+  uint64_t released{0};
+  // served from the calling thread's cache, no lock taken
+  uint64_t threadCacheHits{0};
+  // served from the shared free lists
+  uint64_t sharedHits{0};
+  uint64_t systemAllocations{0};
+  uint64_t systemFrees{0};
+  uint64_t bytesInUse{0};
+  // idle blocks kept in the thread caches and the shared lists
+  uint64_t bytesCached{0};
+
+  std::string ToString() const;
+};
+
+// Size-class slab pool for socket buffers. Each thread keeps a small cache
+// per class; overflow and the caches of exiting threads go to shared free
+// lists, blocks above the biggest class come straight from the system.
+// Both caches are capped in bytes: at most MAX_THREAD_CACHED_BYTES per
+// thread and MAX_SHARED_CACHED_BYTES per class. Idle blocks belong to the
+// process, not to a server, so no MemoryBudget counts them; see
+// BufferPoolStats::bytesCached.
+class BufferPool {
+public:
+  static constexpr std::size_t CLASS_COUNT{5};
+  static constexpr std::array<std::size_t, CLASS_COUNT> CLASS_SIZES{
+    256, 1024, 4096, 16384, 65536};
+  static constexpr uint8_t NO_CLASS{0xFF};
+  static constexpr std::size_t MAX_THREAD_CACHED_BYTES{256 * 1024};
+  static constexpr std::size_t MAX_SHARED_CACHED_BYTES{2 * 1024 * 1024};
+
+private:
+
+  struct SharedList {
+    std::mutex mutex;
+    std::vector<std::byte*> blocks;
+  };
+
+  struct ThreadCache {
+    std::array<std::vector<std::byte*>, CLASS_COUNT> blocks;
+    std::size_t bytes{0};
+    ~ThreadCache();
+  };
+
+  std::array<SharedList, CLASS_COUNT> m_shared;
+  std::atomic<uint64_t> m_acquired{0};
+  std::atomic<uint64_t> m_released{0};
+  std::atomic<uint64_t> m_threadCacheHits{0};
+  std::atomic<uint64_t> m_sharedHits{0};
+  std::atomic<uint64_t> m_systemAllocations{0};
+  std::atomic<uint64_t> m_systemFrees{0};
+  std::atomic<uint64_t> m_bytesInUse{0};
+  std::atomic<uint64_t> m_bytesCached{0};
+
+  static ThreadCache& GetThreadCache();
+  void ReleaseShared(uint8_t sizeClass, std::byte* block);
+
+public:
+  static BufferPool& Instance();
+  static uint8_t SizeClass(std::size_t size);
+
+  std::byte* Acquire(std::size_t size, uint8_t* sizeClass,
+                     std::size_t* capacity);
+  void Release(std::byte* block, uint8_t sizeClass, std::size_t capacity);
+  BufferPoolStats GetStats() const;
+};
+
+// Move-only handle to a pooled block, replaces the per-chunk std::vector.
+class PooledBuffer {
+private:
+  std::byte* m_data{nullptr};
+  std::size_t m_size{0};
+  std::size_t m_capacity{0};
+  uint8_t m_sizeClass{BufferPool::NO_CLASS};
+
+  void Reset();
+
+public:
+  PooledBuffer() = default;
+  explicit PooledBuffer(std::size_t size);
+  PooledBuffer(const std::byte* first, const std::byte* last);
+  PooledBuffer(PooledBuffer&& other) noexcept;
+  PooledBuffer& operator=(PooledBuffer&& other) noexcept;
+  PooledBuffer(const PooledBuffer&) = delete;
+  PooledBuffer& operator=(const PooledBuffer&) = delete;
+  ~PooledBuffer();
+
+  std::byte* data() { return m_data; }
+  const std::byte* data() const { return m_data; }
+  std::size_t size() const { return m_size; }
+  std::size_t capacity() const { return m_capacity; }
+  bool empty() const { return 0 == m_size; }
+  std::byte& operator[](std::size_t index) { return m_data[index]; }
+  const std::byte& operator[](std::size_t index) const
+  {
+    return m_data[index];
+  }
+
+  // keeps the content, moves to a bigger block when needed
+  void reserve(std::size_t capacity);
+  void resize(std::size_t size);
+  // copies as much as fits in the spare capacity, returns the bytes taken
+  std::size_t append(const void* source, std::size_t size);
+  void assign(const std::byte* first, const std::byte* last);
+};
+
+} // namespace FtTCP
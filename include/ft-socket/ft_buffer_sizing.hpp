@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+
+namespace FtTCP {
+
+// Per connection buffer sizes, between a floor every idle client keeps
+// and a ceiling a bulk transfer grows to.
+struct BufferSizing {
+  std::size_t minReceive = 256;
+  std::size_t maxReceive = 64 * 1024;
+  std::size_t minSendChunk = 256;
+  std::size_t maxSendChunk = 64 * 1024;
+  // a receive buffer no read used half of for this long halves
+  std::chrono::milliseconds shrinkAfter{1000};
+  // receive buffers and send queues of all clients, 0 for no limit;
+  // idle blocks cached by the BufferPool are not counted
+  std::size_t memoryBudget = 0;
+};
+
+// Bytes held against a soft limit: buffers only grow while there is room,
+// concurrent growth may overshoot by a step. Data already queued is never
+// dropped; over the budget receive buffers drop to their floor at the next
+// read and new send chunks are cut at theirs.
+class MemoryBudget {
+private:
+  std::size_t m_limit;
+  std::atomic<std::size_t> m_used{0};
+
+public:
+  explicit MemoryBudget(std::size_t limit = 0);
+
+  void Add(std::size_t bytes);
+  void Remove(std::size_t bytes);
+  // whether bytes more fit, always without a limit
+  bool HasRoom(std::size_t bytes) const;
+  std::size_t GetUsed() const;
+  std::size_t GetLimit() const;
+};
+
+using MemoryBudgetPtr = std::shared_ptr<MemoryBudget>;
+
+// The receive size of one connection: doubles whenever a read fills the
+// buffer, halves once reads leave most of it unused for shrinkAfter.
+// Not thread safe, it belongs to the connection's I/O thread.
+class AdaptiveSize {
+private:
+  using Clock = std::chrono::steady_clock;
+
+  std::size_t m_size;
+  std::size_t m_min;
+  std::size_t m_max;
+  std::chrono::milliseconds m_shrinkAfter;
+  Clock::time_point m_lastBusy;
+
+public:
+  AdaptiveSize(std::size_t min, std::size_t max,
+               std::chrono::milliseconds shrinkAfter);
+
+  std::size_t Get() const;
+  // after a read of bytes into room; grows only when the budget has room
+  // for the difference, drops to the floor over the budget
+  void OnRead(std::size_t bytes, std::size_t room,
+              const MemoryBudget* budget);
+  // without a read, e.g. after a receive timeout
+  void OnIdle();
+};
+
+} // namespace FtTCP
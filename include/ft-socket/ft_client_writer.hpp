@@ -0,0 +1,45 @@
+#pragma once
+
+#include "ft_socket_queues.hpp"
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace FtTCP {
+
+// Builds a client's reply from fragments. The client is looked up once,
+// by Server::GetWriter(); Append() copies into a contiguous pooled buffer
+// and Commit() hands it to the send queue in one piece under one lock.
+// Not thread safe, keep one writer per handler thread. The writer keeps
+// the client's queue alive, a client that is gone just never sends.
+class ClientWriter {
+  friend class Server;
+
+private:
+  static constexpr std::size_t INITIAL_CAPACITY{1024};
+
+  std::shared_ptr<SocketSendQueue> m_queue;
+  // the server's, the server outlives its writers
+  const std::string* m_prompt{nullptr};
+  Buffer m_buffer;
+
+  ClientWriter(std::shared_ptr<SocketSendQueue> queue,
+               const std::string* prompt);
+
+public:
+  ClientWriter() = default;
+
+  // false for an unknown client
+  bool IsValid() const;
+  ClientWriter& Append(const void* data, std::size_t size);
+  ClientWriter& Append(std::string_view fragment);
+  ClientWriter& operator<<(std::string_view fragment);
+  ClientWriter& AppendPrompt();
+  // bytes appended since the last Commit()
+  std::size_t Size() const;
+  // queues everything appended so far as one message, false when invalid
+  bool Commit();
+};
+
+} // namespace FtTCP
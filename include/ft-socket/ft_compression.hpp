@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace FtTCP {
+
+struct CompressionParameters {
+  // offer MCCP2 output compression to telnet clients
+  bool enabled = false;
+  // 1 fastest .. 9 smallest
+  int level = 6;
+  // history of 2^windowBits bytes, 9..15
+  int windowBits = 12;
+  // 1..9, hash tables of 2^(memLevel + 9) bytes
+  int memLevel = 5;
+};
+
+// Streaming zlib compressor of one client's output. Its memory is bounded
+// by the parameters, about 2^(windowBits + 2) + 2^(memLevel + 9) bytes
+// (32 KB with the defaults, zlib's own defaults take 256 KB).
+class Deflater {
+private:
+  struct Stream;
+
+  std::unique_ptr<Stream> m_stream;
+  // reused for every call, grows to the largest output once
+  std::string m_output;
+  uint64_t m_bytesIn{0};
+  uint64_t m_bytesOut{0};
+  // input went in since the last flush
+  bool m_unflushed{false};
+
+public:
+  explicit Deflater(const CompressionParameters& params);
+  ~Deflater();
+
+  bool IsValid() const;
+  // the compressed bytes, valid until the next call; with flush the
+  // output ends on a byte boundary and the client can decode all of it
+  std::string_view Compress(const void* data, std::size_t size, bool flush);
+  bool HasUnflushed() const;
+  uint64_t BytesIn() const;
+  uint64_t BytesOut() const;
+
+  static bool IsAvailable();
+  static std::size_t MemoryFor(const CompressionParameters& params);
+};
+
+} // namespace FtTCP
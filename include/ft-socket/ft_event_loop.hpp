@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <unordered_map>
+
+namespace FtTCP {
+
+class EventLoop;
+
+using EventLoopPtr = std::shared_ptr<EventLoop>;
+using EventCallback = std::function<void(uint32_t events)>;
+using TimerCallback = std::function<void()>;
+using TimerId = uint64_t;
+
+// Single threaded epoll loop with one-shot timers. Everything except
+// Stop() is called from the thread running the loop.
+class EventLoop {
+private:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr int MAX_EVENTS{256};
+
+  struct Timer {
+    TimerId id;
+    TimerCallback callback;
+  };
+
+  int m_epoll{-1};
+  // wakes the loop from Stop()
+  int m_wakeup{-1};
+  std::atomic_bool m_stopping{false};
+  std::unordered_map<int, EventCallback> m_callbacks;
+  std::multimap<Clock::time_point, Timer> m_timers;
+  std::unordered_map<TimerId, std::multimap<Clock::time_point, Timer>::iterator>
+    m_timerIndex;
+  TimerId m_timerCounter{0};
+
+  int NextTimeout(std::chrono::milliseconds maxWait) const;
+  void RunTimers();
+
+public:
+  EventLoop();
+  ~EventLoop();
+
+  bool IsValid() const;
+
+  // EPOLL* flags, the callback stays registered until Remove()
+  bool Add(int fd, uint32_t events, EventCallback callback);
+  bool Modify(int fd, uint32_t events);
+  void Remove(int fd);
+
+  TimerId AddTimer(std::chrono::milliseconds delay, TimerCallback callback);
+  void CancelTimer(TimerId id);
+
+  // waits at most maxWait for events, runs their callbacks and the due
+  // timers; false once stopped
+  bool RunOnce(std::chrono::milliseconds maxWait);
+  void Run();
+  // thread safe
+  void Stop();
+
+  static EventLoopPtr CreateEventLoop();
+};
+
+} // namespace FtTCP
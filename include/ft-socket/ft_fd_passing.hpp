@@ -0,0 +1,34 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+namespace FtTCP {
+
+// Unix domain channel used to pass live descriptors between processes
+// (SCM_RIGHTS), e.g. the listener and clients during a binary upgrade.
+class DescriptorChannel {
+private:
+  int m_channel{-1};
+  std::string m_path;
+  bool m_ownsPath{false};
+
+public:
+  DescriptorChannel() = default;
+  DescriptorChannel(const DescriptorChannel&) = delete;
+  DescriptorChannel& operator=(const DescriptorChannel&) = delete;
+  ~DescriptorChannel();
+
+  // the receiving side listens and waits for one peer
+  bool Accept(const std::string& path, std::chrono::milliseconds timeout);
+  // the sending side retries until the receiver is listening
+  bool Connect(const std::string& path, std::chrono::milliseconds timeout);
+
+  // one descriptor (or -1 for none) travels with every record
+  bool Send(int fd, const void* data, size_t size);
+  bool Receive(int* fd, void* data, size_t size,
+               std::chrono::milliseconds timeout);
+};
+
+} // namespace FtTCP
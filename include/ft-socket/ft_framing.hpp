@@ -0,0 +1,62 @@
+#pragma once
+
+#include "ft_buffer_pool.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace FtTCP {
+
+enum FrameFormat {
+  // LEB128 length, 1 byte up to 127, 5 bytes at most
+  FrameVarint,
+  // big-endian uint32 length
+  FrameFixed32
+};
+
+// Reassembles length-prefixed messages from a byte stream. Data is received
+// straight into the reader's buffer and frames are handed out as views into
+// it, valid until the next Prepare().
+class FrameReader {
+public:
+  enum Status { FrameReady, NeedMore, Oversized, Malformed };
+
+  static constexpr std::size_t MAX_HEADER{5};
+
+private:
+  // receive at least this much per read, many small frames per syscall
+  static constexpr std::size_t RECEIVE_CHUNK{64 * 1024};
+
+  FrameFormat m_format;
+  std::size_t m_maxFrame;
+  std::size_t m_receiveChunk{RECEIVE_CHUNK};
+  PooledBuffer m_buffer;
+  // start of the first frame not handed out yet
+  std::size_t m_begin{0};
+  // header and payload of the incomplete frame, once its header is known
+  std::size_t m_pending{0};
+
+  // payload size and header length, false while the header is incomplete
+  bool ParseHeader(const std::byte* data, std::size_t size,
+                   uint64_t* payload, std::size_t* header) const;
+
+public:
+  FrameReader(FrameFormat format, std::size_t maxFrame);
+
+  // room for the next receive: drops the consumed frames and grows the
+  // buffer to hold the incomplete one
+  std::byte* Prepare(std::size_t* room);
+  void Commit(std::size_t received);
+  Status Next(std::string_view* frame);
+  // the room Prepare() makes, 64 KB by default; a drained buffer well
+  // above that is given back
+  void SetReceiveChunk(std::size_t chunk);
+  std::size_t GetCapacity() const;
+
+  // writes the prefix for a payload of size bytes, returns its length
+  static std::size_t EncodeHeader(FrameFormat format, uint32_t size,
+                                  std::byte* header);
+};
+
+} // namespace FtTCP
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace FtTCP {
+
+// Who may connect: CIDR rules plus a cap on live connections per source
+// address. IPv4 only, like the listeners; unix socket and transport peers
+// pass, trustedUids covers the former.
+struct AccessParameters {
+  // "10.0.0.0/8", "192.168.1.7"; the longest matching prefix decides, an
+  // allow and a deny of the same prefix leave it allowed
+  std::vector<std::string> allow;
+  std::vector<std::string> deny;
+  // for addresses no rule matches
+  bool allowByDefault = true;
+  // live connections per source address, 0 for no limit
+  unsigned short int maxPerAddress = 0;
+};
+
+// host byte order
+struct Cidr {
+  uint32_t prefix;
+  uint8_t length;
+};
+
+// "a.b.c.d" or "a.b.c.d/n", host bits are cleared
+bool ParseCidr(const std::string& text, Cidr* cidr);
+std::string Ipv4ToString(uint32_t ip);
+
+// Longest prefix match over allow/deny rules. The rules are kept in one
+// hash table per prefix length, probed longest first. Build() flattens
+// them into the ranges where the answer changes, a lookup is then one
+// binary search whatever the rule count. Read only once built, lookups
+// need no lock.
+class CidrTable {
+private:
+  std::array<std::unordered_map<uint32_t, bool>, 33> m_rules;
+  // bit n set: there are rules with a prefix of n bits
+  uint64_t m_lengths{0};
+  std::size_t m_size{0};
+  bool m_allowByDefault{true};
+  // from Build(): the answer for m_starts[i] up to the next start
+  std::vector<uint32_t> m_starts;
+  std::vector<bool> m_allowed;
+  bool m_built{false};
+
+  static uint32_t Mask(uint8_t length);
+  // the hash tables, without Build()
+  bool Probe(uint32_t ip) const;
+
+public:
+  explicit CidrTable(bool allowByDefault = true);
+
+  // an allow wins over a deny of the same prefix
+  void Add(const Cidr& cidr, bool allow);
+  // false for text ParseCidr() doesn't take
+  bool Add(const std::string& cidr, bool allow);
+  // after the last Add(), Add() drops back to probing until the next one
+  void Build();
+  bool IsAllowed(uint32_t ip) const;
+  std::size_t Size() const;
+};
+
+// Live connections per source address. Not thread safe.
+class AddressCounter {
+private:
+  std::unordered_map<uint32_t, uint32_t> m_counts;
+  uint32_t m_limit;
+
+public:
+  // 0 for no limit
+  explicit AddressCounter(uint32_t limit = 0, std::size_t expected = 0);
+
+  // counts the connection, false without room for it
+  bool TryAdd(uint32_t ip);
+  // counts it regardless of the limit, e.g. a connection taken over
+  void Add(uint32_t ip);
+  void Remove(uint32_t ip);
+  uint32_t Get(uint32_t ip) const;
+  // distinct addresses connected
+  std::size_t Size() const;
+};
+
+} // namespace FtTCP
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "ft_socket.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace FtTCP {
+
+class LoadGenerator;
+
+using LoadGeneratorPtr = std::shared_ptr<LoadGenerator>;
+
+struct LoadCommand {
+  std::string text;
+  unsigned int weight;
+};
+
+struct LoadParameters {
+  std::string host;
+  unsigned short int port;
+  // concurrent sessions kept open once the ramp-up is over
+  unsigned int sessions;
+  // new connections per second during the ramp-up
+  unsigned int connectRate;
+  std::chrono::seconds duration;
+  std::string password;
+  // commands sent by a session before it logs out and reconnects
+  unsigned int commandsPerSession;
+  std::vector<LoadCommand> script;
+  std::string passwordPrompt = "password: ";
+  // marker which terminates every server reply
+  std::string commandPrompt = "$ ";
+};
+
+struct LoadReport {
+  uint64_t connects{0};
+  uint64_t connectFailures{0};
+  uint64_t logins{0};
+  uint64_t commands{0};
+  uint64_t disconnects{0};
+  std::chrono::milliseconds elapsed{0};
+  double connectsPerSecond{0};
+  double commandsPerSecond{0};
+  std::chrono::microseconds latencyP50{0};
+  std::chrono::microseconds latencyP90{0};
+  std::chrono::microseconds latencyP99{0};
+  std::chrono::microseconds latencyMax{0};
+
+  std::string ToString() const;
+};
+
+// Drives many telnet sessions against a Server from a single epoll loop:
+// connect, answer the password prompt, run the command script and measure
+// the time from sending a command until the prompt comes back.
+class LoadGenerator {
+private:
+  enum SessionState { Connecting, AwaitPassword, AwaitPrompt, AwaitReply };
+
+  struct Session {
+    SocketPtr socket;
+    SessionState state{Connecting};
+    std::string input;
+    std::string output;
+    unsigned int commandsSent{0};
+    std::chrono::steady_clock::time_point sentAt;
+  };
+
+  static constexpr int MAX_EVENTS{256};
+  static constexpr std::size_t RECEIVE_BUFFER_SIZE{4096};
+  static constexpr std::chrono::milliseconds LOOP_TIMEOUT{10};
+
+  LoadParameters m_parameters;
+  AddressPtr m_address;
+  std::vector<Session> m_sessions;
+  std::vector<unsigned int> m_latencies;
+  std::vector<unsigned int> m_scriptWeights;
+  unsigned int m_scriptTotalWeight{0};
+  uint32_t m_random{0x2545F491};
+  LoadReport m_report;
+  int m_epoll{-1};
+
+  bool OpenSession(std::size_t index);
+  void CloseSession(std::size_t index);
+  void OnSessionEvent(std::size_t index, uint32_t events);
+  bool ProcessInput(Session& session);
+  void SendNextCommand(Session& session);
+  bool FlushOutput(Session& session);
+  const LoadCommand& PickCommand();
+
+public:
+  LoadGenerator(const LoadParameters& params);
+  ~LoadGenerator();
+
+  LoadReport Run();
+
+  static LoadGeneratorPtr CreateLoadGenerator(const LoadParameters& params);
+};
+
+} // namespace FtTCP
@@ -0,0 +1,143 @@
+#pragma once
+
+#include "ft_transport.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+namespace FtTCP {
+
+struct MemoryLinkParameters {
+  // bytes buffered per direction, rounded up to a power of two
+  std::size_t ringSize = 256 * 1024;
+  // one way delay of every write
+  std::chrono::microseconds latency{0};
+  // per direction, 0 for unlimited
+  uint64_t bytesPerSecond = 0;
+};
+
+// One direction of a memory connection: a lock-free ring with a single
+// writer and a single reader thread. Every write is stored as a record
+// stamped with the time it may be read, which is how latency and
+// bandwidth are simulated; the mutex is only taken to sleep and wake.
+class MemoryRing {
+private:
+  using Clock = std::chrono::steady_clock;
+
+  // readyAt nanoseconds and payload size
+  static constexpr std::size_t RECORD_HEADER{sizeof(int64_t) +
+                                             sizeof(uint32_t)};
+
+  std::unique_ptr<char[]> m_data;
+  std::size_t m_mask;
+  int64_t m_latency;
+  uint64_t m_bytesPerSecond;
+
+  // written by the writer, read by the reader
+  alignas(64) std::atomic<uint64_t> m_tail{0};
+  std::atomic<bool> m_writerClosed{false};
+  // writer only
+  int64_t m_linkFreeAt{0};
+
+  alignas(64) std::atomic<uint64_t> m_head{0};
+  std::atomic<bool> m_readerClosed{false};
+  // reader only: inside the current record
+  uint64_t m_readAt{0};
+  std::size_t m_recordLeft{0};
+  int64_t m_nextReadyAt{0};
+
+  alignas(64) std::atomic<int> m_waiters{0};
+  std::mutex m_mutex;
+  std::condition_variable m_signal;
+
+  void CopyIn(uint64_t at, const void* data, std::size_t size);
+  void CopyOut(uint64_t at, void* data, std::size_t size) const;
+  // the reader moves into the next record once it's due
+  bool NextRecord();
+  void Wake();
+  // dueAt: when the reader's next record is due, 0 for none
+  template<class Ready>
+  bool Wait(Ready ready, const int64_t* dueAt,
+            std::chrono::milliseconds timeout);
+
+public:
+  MemoryRing(const MemoryLinkParameters& link);
+
+  // writer side, bytes stored (may be fewer than size, 0 when full)
+  std::size_t Write(const void* data, std::size_t size);
+  bool WaitWritable(std::chrono::milliseconds timeout);
+  void CloseWriter();
+  bool IsReaderClosed() const;
+
+  // reader side, bytes copied from the records that are due
+  std::size_t Read(void* data, std::size_t size);
+  // also true once the writer closed and nothing is left
+  bool WaitReadable(std::chrono::milliseconds timeout);
+  void CloseReader();
+  // the writer closed and everything it wrote has been read
+  bool IsDrained() const;
+};
+
+// A connection end over two rings, blocking like a kernel socket: Receive
+// waits for data or the peer's close, Send for room in the ring.
+class MemorySocket : public Socket {
+private:
+  std::shared_ptr<MemoryRing> m_in;
+  std::shared_ptr<MemoryRing> m_out;
+
+protected:
+  bool NeedsUserspaceCopy() const override;
+
+public:
+  MemorySocket(std::shared_ptr<MemoryRing> in,
+               std::shared_ptr<MemoryRing> out);
+  ~MemorySocket() override;
+
+  bool IsInvalid() const override;
+  bool IsReadyForRead(std::chrono::milliseconds timeout) override;
+  bool IsReadyForWrite(std::chrono::milliseconds timeout) override;
+  SocketPtr Accept(std::chrono::milliseconds timeout) override;
+  size_t Receive(void* data, size_t bytes, uint32_t flags) override;
+  bool Send(void* data, size_t bytes, uint32_t flags,
+            size_t* bytesSent) override;
+  bool StartTls(TlsContextPtr context,
+                std::chrono::milliseconds timeout) override;
+  bool SetBusyPoll(int microseconds) override;
+  int GetIncomingCpu() const override;
+  bool ApplyOptions(const SocketOptions& options) override;
+  bool SetCork(bool cork) override;
+};
+
+// Connections inside the process, for benchmarks and tests: no ports, no
+// kernel, no scheduler in the data path unless a side has to sleep.
+class MemoryTransport : public Transport {
+public:
+  // the connections waiting for Accept(), shared with the listener
+  struct Backlog {
+    std::mutex mutex;
+    std::condition_variable signal;
+    std::deque<SocketPtr> pending;
+    bool listening{false};
+    int size{0};
+  };
+
+private:
+  MemoryLinkParameters m_link;
+  std::shared_ptr<Backlog> m_backlog;
+
+public:
+  MemoryTransport(const MemoryLinkParameters& link = {});
+
+  SocketPtr Listen(int backlog) override;
+  SocketPtr Connect() override;
+
+  static TransportPtr
+  CreateMemoryTransport(const MemoryLinkParameters& link = {});
+};
+
+} // namespace FtTCP
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "ft_thread.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace FtTCP {
+
+using ClientHandle = long unsigned int;
+
+// Receive data of all clients handed to one callback per batch, e.g. to
+// persist it with one write; replaces the per-chunk receive callback.
+struct BatchParameters {
+  bool enabled = false;
+  // a batch is delivered once it holds this many records or bytes...
+  std::size_t maxRecords = 1024;
+  std::size_t maxBytes = 1024 * 1024;
+  // ...or its first record waited this long
+  std::chrono::microseconds maxHold{2000};
+};
+
+// What one client sent, a chunk of telnet data or one frame; the view
+// stays valid until the batch callback returns.
+struct ReceiveRecord {
+  ClientHandle handle;
+  std::string_view data;
+};
+
+using ReceiveBatch = std::span<const ReceiveRecord>;
+
+// Collects records from the I/O threads and delivers them in batches, in
+// the order added, on its own thread. A full batch blocks the I/O threads
+// while the previous one is being delivered, so a slow callback pushes
+// back on the clients like a paused read.
+class ReceiveBatcher {
+public:
+  using Deliver = std::function<void(ReceiveBatch)>;
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Pending {
+    ClientHandle handle;
+    std::size_t offset;
+    std::size_t size;
+  };
+  // records point into bytes only once it stopped growing
+  struct Batch {
+    std::vector<char> bytes;
+    std::vector<Pending> pending;
+    std::vector<ReceiveRecord> records;
+  };
+
+  BatchParameters m_parameters;
+  Deliver m_deliver;
+  std::thread m_thread;
+  std::mutex m_mutex;
+  // the delivery thread waits for a batch, the I/O threads for room
+  std::condition_variable m_ready;
+  std::condition_variable m_room;
+  Batch m_filling;
+  Clock::time_point m_firstAdded;
+  // records added and delivered so far, for Flush()
+  uint64_t m_added{0};
+  uint64_t m_delivered{0};
+  bool m_flushing{false};
+  bool m_stopping{false};
+  uint64_t m_batches{0};
+
+  bool IsFull(std::size_t moreBytes) const;
+  void Run(ThreadPlacement placement);
+
+public:
+  ReceiveBatcher(const BatchParameters& parameters, Deliver deliver,
+                 const ThreadPlacement& placement = ThreadPlacement());
+  ~ReceiveBatcher();
+
+  // copies the data, waits while the batch is full
+  void Add(ClientHandle handle, const void* data, std::size_t size);
+  // returns once everything added so far was delivered
+  void Flush();
+  // delivers what is left and joins the thread
+  void Stop();
+  // batches and records delivered
+  void GetCounters(uint64_t* batches, uint64_t* records);
+};
+
+} // namespace FtTCP
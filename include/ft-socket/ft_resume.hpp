@@ -0,0 +1,75 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace FtTCP {
+
+using ClientHandle = long unsigned int;
+
+// Telnet sessions outliving their connection: after the password the client
+// gets a token, presenting it as "resume <token>" at the next password
+// prompt within ttl reattaches the session without the password or a
+// connect callback, with whatever was queued for it meanwhile.
+struct ResumeParameters {
+  bool enabled = false;
+  // how long a session waits for its client once the connection broke;
+  // its disconnect callback comes after it
+  std::chrono::seconds ttl{60};
+  // tokens held at once, connected sessions included
+  std::size_t maxSessions = 1024;
+};
+
+// Tokens of resumable sessions. A session is live until Park(), then it
+// expires after the ttl. Not thread safe.
+class ResumeTable {
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Entry {
+    ClientHandle handle;
+    bool parked;
+    Clock::time_point expires;
+  };
+
+  std::size_t m_capacity;
+  std::chrono::seconds m_ttl;
+  std::unordered_map<std::string, Entry> m_entries;
+  // parked tokens by expiry, the ttl is the same for all of them; stale
+  // ones are skipped when they come up
+  std::deque<std::pair<Clock::time_point, std::string>> m_parked;
+
+  std::size_t m_parkedCount{0};
+
+  static std::string NewToken();
+  // drops the front of m_parked while it names no parked session
+  void SkipStale();
+  // the entry stops being parked, the caller removes it
+  void Unpark(Entry& entry);
+
+public:
+  ResumeTable(std::size_t capacity, std::chrono::seconds ttl);
+
+  // a new token for the session, empty when every slot is taken by a live
+  // session; a full table drops the parked session closest to expiring,
+  // its handle goes to evicted
+  std::string Issue(ClientHandle handle, std::vector<ClientHandle>* evicted);
+  // the connection broke, the token is good for the ttl from now
+  bool Park(const std::string& token);
+  // the session of a token Take() would accept, the token stays
+  bool Find(const std::string& token, ClientHandle* handle) const;
+  // removes a token which is live or parked within the ttl
+  bool Take(const std::string& token, ClientHandle* handle);
+  void Remove(const std::string& token);
+  // removes the sessions parked for longer than the ttl
+  std::vector<ClientHandle> TakeExpired();
+  // every parked session, e.g. when the server stops
+  std::vector<ClientHandle> TakeParked();
+  std::size_t GetParked() const;
+};
+
+} // namespace FtTCP
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "ft_event_loop.hpp"
+#include "ft_socket.hpp"
+#include "ft_task.hpp"
+#include "ft_thread.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+namespace FtTCP {
+
+class Connection;
+class SessionServer;
+
+using ConnectionPtr = std::shared_ptr<Connection>;
+using SessionServerPtr = std::shared_ptr<SessionServer>;
+using SessionHandle = long unsigned int;
+// one coroutine per client, the connection closes when it returns
+using SessionFnType = std::function<Task<void>(Connection&)>;
+
+struct SessionParameters {
+  unsigned short int port;
+  unsigned short int maxConnections;
+  // ReadLine() gives up after this long without a line
+  std::chrono::seconds clientTimeOut;
+  int backlog = 64;
+  // the event loop thread
+  ThreadPlacement ioThreads = {"ft-loop", {}};
+};
+
+// A client of a SessionServer as seen from its session coroutine. The
+// awaitables complete on the server's event loop thread.
+class Connection {
+  friend class SessionServer;
+
+private:
+  enum Wait { None, Readable, Writable, Timer };
+
+  // longest line ReadLine() accepts
+  static constexpr std::size_t MAX_LINE{4096};
+  // Write() suspends while more than this waits for the socket
+  static constexpr std::size_t MAX_PENDING_OUTPUT{64 * 1024};
+  static constexpr std::size_t RECEIVE_CHUNK{1024};
+
+  SessionServer& m_server;
+  SocketPtr m_socket;
+  SessionHandle m_handle;
+  Task<void> m_session;
+  std::string m_input;
+  // bytes of m_input handed out by the last ReadLine()
+  std::size_t m_consumed{0};
+  std::string m_output;
+  std::size_t m_outputSent{0};
+  bool m_closed{false};
+  bool m_timedOut{false};
+  Wait m_wait{None};
+  std::coroutine_handle<> m_waiter;
+  TimerId m_timer{0};
+
+  void OnEvent(uint32_t events);
+  void ReadAvailable();
+  void Flush();
+  bool HasLine() const;
+  void Suspend(Wait wait, std::coroutine_handle<> waiter,
+               std::chrono::milliseconds timeout);
+
+public:
+  struct ReadLineAwaiter {
+    Connection& connection;
+
+    bool await_ready();
+    void await_suspend(std::coroutine_handle<> waiter);
+    // without '\n' and '\r', valid until the next ReadLine(); empty when
+    // the client is gone, timed out or sent a line over MAX_LINE
+    std::optional<std::string_view> await_resume();
+  };
+
+  struct WriteAwaiter {
+    Connection& connection;
+
+    bool await_ready();
+    void await_suspend(std::coroutine_handle<> waiter);
+    // false when the client is gone
+    bool await_resume();
+  };
+
+  struct SleepAwaiter {
+    Connection& connection;
+    std::chrono::milliseconds delay;
+
+    bool await_ready() { return delay.count() <= 0; }
+    void await_suspend(std::coroutine_handle<> waiter);
+    void await_resume() {}
+  };
+
+  Connection(SessionServer& server, SocketPtr socket, SessionHandle handle);
+  ~Connection();
+
+  ReadLineAwaiter ReadLine();
+  // queues the data, suspends only while the client is behind
+  WriteAwaiter Write(std::string_view data);
+  SleepAwaiter Sleep(std::chrono::milliseconds delay);
+  void Close();
+
+  bool IsOpen() const;
+  SessionHandle GetHandle() const;
+};
+
+// Coroutine counterpart of Server: all clients share one event loop
+// thread, each runs a session coroutine instead of a thread and callbacks.
+class SessionServer {
+  friend class Connection;
+
+private:
+  SessionParameters m_parameters;
+  SessionFnType m_session;
+  EventLoopPtr m_loop;
+  AddressPtr m_address;
+  SocketPtr m_listenerSocket;
+  std::thread m_loopThread;
+  std::unordered_map<int, ConnectionPtr> m_connections;
+  SessionHandle m_handlesCounter{0};
+  // m_connections belongs to the loop thread
+  std::atomic<std::size_t> m_connectionCount{0};
+
+  void Run();
+  void OnAccept();
+  void OnConnectionEvent(int fd, uint32_t events);
+  // continues the suspended session, closes the client once it returns
+  void Resume(Connection& connection);
+  void Finish(ConnectionPtr connection);
+
+public:
+  static constexpr char TAG[] = "SESSION";
+
+  SessionServer(const SessionParameters& params, SessionFnType session);
+  ~SessionServer();
+
+  // a stopped server isn't started again
+  bool Start();
+  // the running sessions are destroyed where they are suspended
+  void Stop();
+  std::size_t ConnectionCount() const;
+
+  static SessionServerPtr CreateSessionServer(const SessionParameters& params,
+                                              SessionFnType session);
+};
+
+} // namespace FtTCP
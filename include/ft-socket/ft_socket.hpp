@@ -1,9 +1,12 @@
 #pragma once
 
 #include "ft_socket_address.hpp"
+#include "ft_tls.hpp"
 
 #include <chrono>
+#include <cstdint>
 #include <queue>
+#include <vector>
 
 namespace FtTCP {
 class Socket;
@@ -17,34 +20,168 @@ static constexpr PlatformError SOCKET_ERROR = -1;
 
 static constexpr int TCP_NODELAY_US = 100;
 static constexpr int MAX_BACKLOG = 2;
+static constexpr std::chrono::milliseconds TLS_HANDSHAKE_TIMEOUT{5000};
+static constexpr size_t USERSPACE_COPY_CHUNK = 16 * 1024;
 
+// Per-connection tuning, applied to the accepted sockets. Negative values
+// and false keep the kernel defaults.
+struct SocketOptions {
+  // TCP_NODELAY: small writes leave at once instead of waiting for ACKs
+  bool noDelay = false;
+  // SO_SNDBUF / SO_RCVBUF in bytes, the kernel doubles them
+  int sendBuffer = -1;
+  int receiveBuffer = -1;
+  bool keepAlive = false;
+  // TCP_KEEPIDLE / TCP_KEEPINTVL in seconds, TCP_KEEPCNT probes
+  int keepAliveIdle = -1;
+  int keepAliveInterval = -1;
+  int keepAliveCount = -1;
+  // TCP_USER_TIMEOUT in milliseconds: sent data unacknowledged this long,
+  // or keepalive probes unanswered past it, close the connection
+  int userTimeout = -1;
+  // TCP_NOTSENT_LOWAT: the socket reports writable only below this many
+  // unsent bytes, the rest stays in the send queue
+  int notSentLowat = -1;
+  // merge the parts of a flush into full segments, MSG_MORE on all but the
+  // last part (TCP_CORK around the flush with TLS)
+  bool cork = false;
+
+  // consoles: replies and prompts go out at once, merged per flush
+  static SocketOptions Interactive();
+  // file and log streams: big buffers, little unsent data in the kernel
+  static SocketOptions Bulk();
+};
+
+// TCP_INFO and the send queue of a connection at one moment
+struct TcpInfo {
+  // smoothed round trip time and its variance
+  uint32_t rttMicroseconds{0};
+  uint32_t rttVarMicroseconds{0};
+  // retransmitted segments over the connection's life
+  uint32_t retransmits{0};
+  uint32_t unackedSegments{0};
+  uint32_t lostSegments{0};
+  uint32_t congestionWindow{0};
+  // since the peer last sent data
+  uint32_t lastReceiveMilliseconds{0};
+  // sent and waiting for an ACK, queued and not sent yet
+  uint64_t unackedBytes{0};
+  uint64_t unsentBytes{0};
+};
+
+// A kernel socket. The virtual members are what the server needs from a
+// connection (accept, read, write, readiness); other transports, e.g.
+// MemoryTransport, override them and have no descriptor.
 class Socket {
 private:
   PlatformSocket m_socket;
   AddressPtr m_address;
+  TlsContextPtr m_tlsContext;
+  ssl_st* m_ssl{nullptr};
+  bool m_kernelTlsSend{false};
+  bool m_wouldBlock{false};
+  // IPv4 peer of an accepted socket, host byte order
+  uint32_t m_peerIp{0};
+  uint16_t m_peerPort{0};
+  bool m_hasPeer{false};
+
+  void SetPeer(const sockaddr_storage& peer);
+  // connects to our unix address: ECONNREFUSED for a stale socket file,
+  // 0 when a server accepts on it, other errors as they come
+  PlatformError StaleSocketProbe() const;
+  // a stream step sends what fits now instead of waiting for the peer to
+  // read; true when the socket was blocking and has to be put back
+  bool EnterNonBlocking();
+
+protected:
   mutable std::queue<PlatformError> m_errors;
 
+  // SendFile and Splice go through Send(), the bytes must pass userspace
+  virtual bool NeedsUserspaceCopy() const;
+
 public:
   Socket(AddressPtr address);
   Socket(AddressPtr address, PlatformSocket sock);
   Socket(AddressPtr address, IPProto proto);
-  ~Socket();
+  virtual ~Socket();
 
-  bool IsInvalid() const;
+  virtual bool IsInvalid() const;
+  PlatformSocket GetHandle() const;
 
   std::string ErrorsToStr() const;
   void SetNonBlocking(bool nonBlocking);
   bool Connect();
+  bool FinishConnect();
   bool Bind();
-  bool Listen();
-  bool IsReadyForRead(std::chrono::milliseconds timeout);
-  bool IsReadyForWrite(std::chrono::milliseconds timeout);
-  SocketPtr Accept(std::chrono::milliseconds timeout);
-  size_t Receive(void* data, size_t bytes, uint32_t flags);
-  bool Send(void* data, size_t bytes, uint32_t flags, size_t* bytesSent);
+  bool Listen(int backlog = MAX_BACKLOG);
+  // gives up ownership, the descriptor is neither shut down nor closed
+  PlatformSocket Release();
+  virtual bool IsReadyForRead(std::chrono::milliseconds timeout);
+  virtual bool IsReadyForWrite(std::chrono::milliseconds timeout);
+  virtual SocketPtr Accept(std::chrono::milliseconds timeout);
+  // bytes received, 0 at the end of the stream, on errors and when
+  // WouldBlock()
+  virtual size_t Receive(void* data, size_t bytes, uint32_t flags);
+  // the last Receive() got nothing, yet the connection is fine: a TLS
+  // record isn't complete, or a non-blocking socket had no data
+  bool WouldBlock() const;
+  virtual bool Send(void* data, size_t bytes, uint32_t flags,
+                    size_t* bytesSent);
   bool SendDatagram(const void* data, size_t bytes);
+  // bytes received, 0 on error; *sender gets the peer's IPv4 address
+  size_t ReceiveDatagram(void* data, size_t bytes, std::string* sender);
+  // kernel to kernel copies, offset is advanced by the bytes sent
+  bool SendFile(int fd, off_t* offset, size_t bytes, size_t* bytesSent);
+  // streams from a pipe, *endOfStream is set once the writer closed it
+  bool Splice(int pipeFd, size_t bytes, size_t* bytesSent, bool* endOfStream);
+
+  virtual bool StartTls(TlsContextPtr context, std::chrono::milliseconds timeout =
+                                                 TLS_HANDSHAKE_TIMEOUT);
+  // low latency tuning: poll the device queue instead of sleeping
+  virtual bool SetBusyPoll(int microseconds);
+  // CPU which processed the socket's last packets, -1 when unknown
+  virtual int GetIncomingCpu() const;
+  // TCP only, false on unix sockets and other transports; leaves the error
+  // queue alone (errno tells why), so other threads may ask
+  bool GetTcpInfo(TcpInfo* info) const;
+  // SO_SNDBUF, autotuned by the kernel unless set; -1 when unknown
+  int GetSendBufferSize() const;
+  // false if any option was refused, the others are still set
+  virtual bool ApplyOptions(const SocketOptions& options);
+  // TCP only, false on unix sockets
+  virtual bool SetCork(bool cork);
+  // IPv4 multicast; interfaceIp picks the interface by its address, empty
+  // for the kernel's choice. Joining also stops the delivery of the
+  // groups other sockets joined (IP_MULTICAST_ALL).
+  bool JoinGroup(const std::string& group, const std::string& interfaceIp);
+  bool LeaveGroup(const std::string& group, const std::string& interfaceIp);
+  // router hops, 1 stays on the local segment
+  bool SetMulticastTtl(int ttl);
+  bool SetMulticastInterface(const std::string& interfaceIp);
+  // deliver our own datagrams to the group's members on this host
+  bool SetMulticastLoopback(bool loopback);
+  // unix sockets only: who connected, any pointer may be null
+  bool GetPeerCredentials(pid_t* pid, uid_t* uid, gid_t* gid) const;
+  // IPv4 peers only, as Accept() saw them; host byte order, port may be
+  // null
+  bool GetPeerIpv4(uint32_t* ip, uint16_t* port) const;
+  // asks the kernel, for sockets which weren't accepted here
+  bool LoadPeerAddress();
+
+  // AF_UNIX
+  bool IsLocal() const;
+  bool IsTls() const;
+  bool IsTlsResumed() const;
+  bool IsKernelTls() const;
 
   static SocketPtr CreateSocket(AddressPtr address);
   static SocketPtr CreateSocket(AddressPtr address, PlatformSocket sock);
+  // SIGPIPE to SIG_IGN unless the application installed a handler:
+  // sendfile(), splice() and kTLS record writes take no MSG_NOSIGNAL, a
+  // peer resetting mid-stream would otherwise kill the process
+  static void IgnoreBrokenPipe();
+  // index of the first readable handle, -1 on timeout or error
+  static int WaitForAnyReadable(const std::vector<PlatformSocket>& sockets,
+                                std::chrono::milliseconds timeout);
 };
 } // namespace FtTCP
@@ -4,13 +4,15 @@
 #include <memory>
 #include <netdb.h>
 #include <string>
+#include <sys/socket.h>
 
 namespace FtTCP {
 class Address;
 
 using AddressPtr = std::shared_ptr<Address>;
 
-enum IPProto { eTCP = IPPROTO_TCP, eUDP = IPPROTO_UDP };
+// eLocal: AF_UNIX stream sockets, which take protocol 0
+enum IPProto { eTCP = IPPROTO_TCP, eUDP = IPPROTO_UDP, eLocal = 0 };
 
 class Address {
 protected:
@@ -19,7 +21,9 @@ protected:
   std::string m_host;
   int m_port;
   std::string m_presentation;
-  sockaddr_in m_address;
+  // sockaddr_in or sockaddr_un
+  sockaddr_storage m_address;
+  socklen_t m_length;
 
   bool m_isValid;
   bool m_isListener;
@@ -28,22 +32,39 @@ protected:
   int m_sockType;
 
   void FillPresentation();
+  void FillLocal(bool isAbstract);
 
 public:
   Address(const char* host, const int port, IPProto proto = IPProto::eTCP);
   Address(const int port, const bool async, IPProto proto = IPProto::eTCP);
+  // AF_UNIX, the path without the leading NUL for the abstract namespace
+  Address(const std::string& path, const bool isListener,
+          const bool isAbstract);
   ~Address() = default;
 
   bool IsEmpty() const noexcept;
   bool IsValid() const noexcept;
   bool IsListener() const noexcept;
   std::string toString() const;
+  // IPv4 addresses only
   const sockaddr_in* GetAddress() const;
+  const sockaddr* GetSockAddr() const;
+  socklen_t GetLength() const;
+  int GetFamily() const;
+  bool IsLocal() const;
+  // an IPv4 group, 224.0.0.0/4
+  bool IsMulticast() const;
   IPProto GetProto() const;
   int GetSocketType() const;
 
   static AddressPtr CreateBroadcastAddress(const char* self_ip, const int port);
+  // datagrams to a group, invalid for anything but a multicast address
+  static AddressPtr CreateMulticastAddress(const char* group, const int port);
   static AddressPtr CreateClientAddress(const char* host, const int port);
   static AddressPtr CreateListenerAddress(const int port, const bool isAsync);
+  // a path, or "@name" in the abstract namespace (no file, gone with the
+  // last socket)
+  static AddressPtr CreateUnixAddress(const std::string& path,
+                                      const bool isListener);
 };
 } // namespace FtTCP
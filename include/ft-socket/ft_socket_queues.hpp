@@ -1,7 +1,12 @@
 #pragma once
 
+#include "ft_buffer_pool.hpp"
+#include "ft_buffer_sizing.hpp"
+#include "ft_compression.hpp"
 #include "ft_socket.hpp"
 
+#include <cstdint>
+#include <memory>
 #include <mutex>
 #include <vector>
 #include <queue>
@@ -9,19 +14,97 @@
 namespace FtTCP {
 
   using BufferElement = std::byte;
-  using Buffer = std::vector<BufferElement>;
+  using Buffer = PooledBuffer;
+
+// pipe segments without a known length run until the writer closes the pipe
+static constexpr size_t STREAM_TO_END = static_cast<size_t>(-1);
+
+// One entry of the send queue: either bytes copied from the caller or a
+// file/pipe segment the kernel streams to the socket (sendfile/splice).
+struct SendSegment {
+  enum Kind { Bytes, File, Pipe };
+
+  Kind kind{Bytes};
+  Buffer buffer;
+  // owned duplicate of the caller's descriptor
+  int fd{-1};
+  off_t offset{0};
+  size_t remaining{0};
+};
 
 class SocketSendQueue {
 private:
-  static constexpr size_t MAX_SEND_BUFFER{256};
-  std::deque<Buffer> m_queue;
+  static constexpr size_t MAX_STREAM_CHUNK{1024 * 1024};
+  static constexpr size_t COMPRESS_FILE_CHUNK{16 * 1024};
+  std::deque<SendSegment> m_queue;
   mutable std::mutex m_mutex;
   std::size_t m_sent{0};
+  // chunk sizing: the recent write size within the limits and the
+  // socket's send space
+  std::size_t m_minChunk{256};
+  std::size_t m_maxChunk{256};
+  std::size_t m_sendSpace{0};
+  std::size_t m_writeAverage{0};
+  // capacity of the queued chunks, counted against the budget
+  std::size_t m_held{0};
+  MemoryBudgetPtr m_budget;
+  // between Push() and the queue once compression started
+  std::unique_ptr<Deflater> m_deflater;
+  bool m_cork{false};
+
+  bool PushDescriptor(SendSegment::Kind kind, int fd, off_t offset,
+                      size_t length);
+  // closes the segment's descriptor, its buffer leaves the budget
+  void Release(SendSegment& segment);
+  void PopFront();
+  // callers hold m_mutex
+  void NoteWrite(size_t size);
+  size_t ChunkSize() const;
+  void Hold(const Buffer& buffer);
+  // callers hold m_mutex
+  void Append(const void* source, size_t size);
+  // through the deflater when there is one
+  void AppendData(const void* source, size_t size);
 
 public:
-  bool Send(SocketPtr socket);
+  ~SocketSendQueue();
+
+  // sends from the front segment, at most maxBytes of it; the socket is
+  // written without the lock, one thread sends at a time
+  bool Send(SocketPtr socket, size_t* bytesSent = nullptr,
+            size_t maxBytes = SIZE_MAX);
   void Push(const void* source, size_t size);
+  // takes the block as one segment, no copy unless compressed
+  void Push(Buffer&& buffer);
+  // both parts are queued back to back, e.g. a frame header and its payload
+  void Push(const void* prefix, size_t prefixSize, const void* source,
+            size_t size);
+  // a compressed queue reads the file and compresses it here
+  bool PushFile(int fd, off_t offset, size_t length);
+  // false on a compressed queue
+  bool PushPipe(int pipeFd, size_t length = STREAM_TO_END);
   bool IsEmpty();
+  // MSG_MORE while more parts are queued, they leave as full segments
+  void SetCork(bool cork);
+  // chunks grow with the writes up to maxChunk, the budget gets the bytes
+  // held; set before the first push
+  void SetSizing(size_t minChunk, size_t maxChunk, MemoryBudgetPtr budget);
+  // what the socket buffers, no chunk is bigger; 0 when not known
+  void SetSendSpace(size_t bytes);
+  // capacity of the queued chunks
+  size_t GetHeldBytes();
+
+  // queues marker as is, everything pushed afterwards is compressed
+  bool StartCompression(const void* marker, size_t size,
+                        const CompressionParameters& params);
+  bool IsCompressed();
+  // Push() left input inside the deflater, FlushCompression() has work
+  bool HasUnflushedCompression();
+  // sync flush of what Push() left inside the deflater, done before
+  // sending so a prompt reaches the client in the same iteration
+  void FlushCompression();
+  // uncompressed and compressed bytes so far, zeros without compression
+  void GetCompressionCounters(uint64_t* bytesIn, uint64_t* bytesOut);
 };
 
 } // namespace FtTCP
@@ -1,7 +1,19 @@
 #pragma once
 
+#include "ft_auth.hpp"
+#include "ft_client_writer.hpp"
+#include "ft_compression.hpp"
+#include "ft_framing.hpp"
+#include "ft_ip_filter.hpp"
+#include "ft_receive_batch.hpp"
+#include "ft_resume.hpp"
 #include "ft_socket.hpp"
 #include "ft_socket_queues.hpp"
+#include "ft_telnet.hpp"
+#include "ft_thread.hpp"
+#include "ft_token_bucket.hpp"
+#include "ft_transport.hpp"
+#include "ft_worker_pool.hpp"
 
 #include <atomic>
 #include <chrono>
@@ -11,6 +23,7 @@
 #include <mutex>
 #include <queue>
 #include <thread>
+#include <vector>
 
 namespace FtTCP {
 
@@ -28,12 +41,173 @@ enum ServerReason {
   ConnectionDeleted,
   ServerStarted,
   ServerStopSignal,
-  ServerStopped
+  ServerStopped,
+  ConnectionTlsFailed
 };
+// what happens to received data when a client's callback queue is full
+enum CallbackOverflow {
+  // the client isn't read until its queue drains, TCP pushes back
+  OverflowPause,
+  OverflowDrop,
+  OverflowDisconnect
+};
+// how a client's byte stream is cut into receive callbacks
+enum Protocol {
+  // password prompt first, then the data as it arrives
+  ProtocolTelnet,
+  // no prompt or password, one callback per length-prefixed message
+  ProtocolVarintFrames,
+  ProtocolFixed32Frames
+};
+
+// per second, 0 disables the limit; burst defaults to one second
+struct RateLimit {
+  double rate = 0;
+  double burst = 0;
+};
+
+// Limits pause the reads, delay the flushes or leave connections in the
+// backlog; no data is dropped.
+struct RateLimits {
+  // per client
+  RateLimit inboundBytes;
+  // per client, every received chunk counts as a command
+  RateLimit commands;
+  // per client
+  RateLimit outboundBytes;
+  // whole server
+  RateLimit accepts;
+};
+
+// One port of a server; the clients of all listeners share the server's
+// threads, limits, buffers and stats.
+struct ListenerParameters {
+  // for logs and the stats
+  std::string name;
+  unsigned short int port = 0;
+  // AF_UNIX path instead of the port, "@name" for the abstract namespace
+  std::string unixPath;
+  // connections come from here instead of a kernel listener
+  TransportPtr transport;
+  Protocol protocol = ProtocolTelnet;
+  // telnet clients are prompted for the password, false admits them
+  // straight away, e.g. a read-only monitoring port
+  bool password = true;
+  // clients of this listener, 0 for the server's maxConnections only
+  unsigned short int maxConnections = 0;
+};
+
 struct ServerParameters {
   unsigned short int port;
   unsigned short int maxConnections;
   std::chrono::seconds clientTimeOut;
+  // clients must complete a TLS handshake before the password prompt
+  TlsContextPtr tls = nullptr;
+  // wrong passwords before the client is disconnected
+  unsigned short int maxPasswordAttempts = 3;
+  // threads running synchronous password callbacks off the I/O threads
+  unsigned short int authWorkers = 2;
+  // connections queued by the kernel while the server restarts
+  int backlog = 64;
+  // listener and per-client I/O threads
+  ThreadPlacement ioThreads = {"ft-io", {}};
+  // threads running application callbacks off the I/O path
+  ThreadPlacement callbackThreads = {"ft-cb", {}};
+  // trades CPU for round-trip time: SO_BUSY_POLL, threads on the CPU the
+  // packets arrive at, and spinning on the socket before blocking
+  bool lowLatency = false;
+  int busyPollMicroseconds = 50;
+  std::chrono::microseconds spinBeforeBlock{200};
+  // connect, receive and disconnect callbacks run on this many pool
+  // threads, in order per client; 0 runs them on the client I/O thread
+  unsigned short int callbackWorkers = 0;
+  std::size_t callbackQueueSize = 4096;
+  std::size_t callbackQueuePerClient = 64;
+  CallbackOverflow callbackOverflow = OverflowPause;
+  RateLimits limits;
+  Protocol protocol = ProtocolTelnet;
+  // a longer frame disconnects the client
+  std::size_t maxFrameSize = 1024 * 1024;
+  // MCCP2, offered to telnet clients before the password prompt
+  CompressionParameters compression;
+  // applied to every accepted socket, e.g. SocketOptions::Interactive()
+  SocketOptions socketOptions;
+  // listen on this AF_UNIX path instead of the TCP port, "@name" for the
+  // abstract namespace
+  std::string unixPath;
+  // unix socket peers running as one of these users skip the password,
+  // the kernel reports their uid (SO_PEERCRED)
+  std::vector<uid_t> trustedUids;
+  // connections come from here instead of a kernel listener, e.g. a
+  // MemoryTransport for benchmarks; port and unixPath are unused
+  TransportPtr transport;
+  // receive buffers and send chunks adapt per client within these
+  BufferSizing buffers;
+  // several ports served by one server; empty for the single listener
+  // described by port, unixPath, transport and protocol
+  std::vector<ListenerParameters> listeners;
+  // telnet sessions survive a broken connection for a while
+  ResumeParameters resume;
+  // received data goes to the batch callback, when one is set, instead of
+  // the receive callback
+  BatchParameters batch;
+  // checked at accept, before a client is set up
+  AccessParameters access;
+};
+
+struct ServerStats {
+  // connected now, e.g. for Broadcast::UpdateLoad()
+  std::size_t clients{0};
+  // callback executor, zeros without callbackWorkers
+  std::size_t callbackQueueDepth{0};
+  std::size_t callbackMaxQueueDepth{0};
+  uint64_t callbacksExecuted{0};
+  uint64_t callbacksRejected{0};
+  uint64_t receivesDropped{0};
+  uint64_t clientsOverflowed{0};
+  // how often a limit engaged: a client (or the listener) went from
+  // running freely to waiting for tokens
+  uint64_t inboundLimited{0};
+  uint64_t commandsLimited{0};
+  uint64_t outboundLimited{0};
+  uint64_t acceptsLimited{0};
+  // connections closed right after accept: a deny rule matched, or their
+  // address had AccessParameters::maxPerAddress connected already
+  uint64_t accessDenied{0};
+  uint64_t addressLimited{0};
+  // MCCP2 clients and their output before and after deflate
+  uint64_t compressedClients{0};
+  uint64_t compressionBytesIn{0};
+  uint64_t compressionBytesOut{0};
+  // receive buffers and send queues of the connected clients
+  uint64_t bufferBytes{0};
+  uint64_t maxClientBufferBytes{0};
+  // BufferSizing::memoryBudget, 0 without one
+  uint64_t bufferBudget{0};
+  // connected clients per listener, in ServerParameters::listeners order
+  std::vector<std::size_t> listenerClients;
+  // sessions waiting for their client to come back, and the comebacks
+  uint64_t parkedSessions{0};
+  uint64_t sessionsResumed{0};
+  // batch callbacks and the records they delivered
+  uint64_t batches{0};
+  uint64_t batchRecords{0};
+
+  std::string ToString() const;
+};
+
+// One connected client, read from the kernel when asked for
+struct ClientStats {
+  ClientHandle handle{0};
+  std::size_t listener{0};
+  // IPv4 peer in host byte order, 0 for other peers
+  uint32_t peerIp{0};
+  uint64_t bufferBytes{0};
+  // false for unix sockets and other transports
+  bool hasTcpInfo{false};
+  TcpInfo tcp;
+
+  std::string ToString() const;
 };
 
 using OnStartListeningFnType = std::function<void(Server&)>;
@@ -41,10 +215,13 @@ using OnClientConnectFnType = std::function<void(Server&, ClientHandle)>;
 using OnClientDisconnectFnType = std::function<void(Server&, ClientHandle)>;
 using OnClientReceiveDataFnType =
   std::function<void(Server&, ClientHandle, const void*, const size_t)>;
+using OnReceiveBatchFnType = std::function<void(Server&, ReceiveBatch)>;
 using OnUpdateFnType =
   std::function<void(Server&, ServerReason, PlatformError)>;
 using OnPasswordEntered =
   std::function<bool(Server&, ClientHandle, const void*, const size_t)>;
+using OnPasswordEnteredAsync =
+  std::function<AuthResult(Server&, ClientHandle, std::string)>;
 
 class Server {
   enum Stage { Initializing, Listening, Shutingdown }; 
@@ -56,8 +233,10 @@ private:
     {
     }
     */
-    Client(const Server& svr, ClientHandle client, bool conn, SocketPtr sock): 
-      server(svr), socket(sock), clientHandle(client), connected(conn)
+    Client(const Server& svr, ClientHandle client, bool conn, SocketPtr sock,
+           std::size_t from):
+      server(svr), socket(sock), clientHandle(client), connected(conn),
+      listener(from)
     {
     }
 
@@ -66,19 +245,78 @@ private:
     SocketPtr socket;
     ClientHandle clientHandle;
     std::atomic_bool connected;
+    // index into m_listeners, the one which accepted the client
+    std::size_t listener;
+    bool authenticated{false};
     SocketSendQueue forSend;
+    // the session is parked while its password is checked
+    AuthResult pendingAuth;
+    unsigned short int passwordAttempts{0};
+    // callbacks of this client, with callbackWorkers only
+    StrandPtr strand;
+    TokenBucket inboundBytes;
+    TokenBucket commands;
+    TokenBucket outboundBytes;
+    // a limit is engaged, counted once per engagement
+    bool readLimited{false};
+    bool flushLimited{false};
+    // telnet commands are filtered out once the server offered MCCP2
+    bool telnetFiltered{false};
+    TelnetInput telnet;
+    // the I/O thread is done, its counters are in the server totals
+    bool finished{false};
+    // receive callbacks on the pool, a corked flush waits for them once
+    std::atomic<int> callbacksRunning{0};
+    bool flushDeferred{false};
+    // capacity of the receive buffer, counted against the budget
+    std::atomic<std::size_t> receiveBytes{0};
+    // what the client presents to resume the session, empty without one
+    std::string resumeToken;
+    // the connection broke rather than being closed, see ParkClient
+    std::atomic_bool lost{false};
+    // no connection, the session waits for its token
+    std::atomic_bool parked{false};
+    // a new connection took the token and waits for the park
+    bool claimed{false};
+    // reattached, RunClient doesn't announce it again
+    bool resumed{false};
+    // the connection went to the session it resumed
+    bool movedOut{false};
+    // IPv4 peers only, counted against AccessParameters::maxPerAddress
+    uint32_t peerIp{0};
+    bool peerCounted{false};
   };
 
   using ClientPtr = std::shared_ptr<Client>;
 
+  struct Listener {
+    ListenerParameters parameters;
+    SocketPtr socket;
+    // connected clients, against parameters.maxConnections
+    std::atomic<std::size_t> clients{0};
+  };
+
   static constexpr std::chrono::milliseconds START_SERVER{500};
   static constexpr std::chrono::milliseconds CLIENT_THROTTLE_TIME{5};
   static constexpr std::chrono::milliseconds LISTENER_THROTTLE_TIME{5};
-  static constexpr std::chrono::milliseconds ACCEPT_TIMEOUT{1000};
+  static constexpr std::chrono::milliseconds ACCEPT_TIMEOUT{100};
+  static constexpr std::chrono::milliseconds HANDOFF_TIMEOUT{5000};
+  // a client's queued output must be out before its descriptor is passed
+  static constexpr std::chrono::milliseconds HANDOFF_FLUSH_TIMEOUT{2000};
   static constexpr std::chrono::milliseconds NOWAIT{0};
-  static constexpr std::size_t RECEIVE_BUFFER_SIZE{256};
+  // bytes flushed per loop iteration, a big file doesn't starve the reads
+  static constexpr std::size_t MAX_FLUSH_PER_ITERATION{4 * 1024 * 1024};
   static constexpr std::string_view PASSWORD_PROMPT = "password: ";
   static constexpr std::string_view WRONG_PASSWORD_MESSAGE = "wrong password\n";
+  static constexpr std::string_view TOO_MANY_ATTEMPTS_MESSAGE =
+    "too many attempts\n";
+  static constexpr std::size_t AUTH_QUEUE_SIZE{1024};
+  static constexpr std::chrono::milliseconds CALLBACK_DRAIN_TIMEOUT{5000};
+  static constexpr std::string_view RESUME_COMMAND = "resume ";
+  static constexpr std::string_view RESUME_TOKEN_MESSAGE = "resume: ";
+  static constexpr std::string_view RESUMED_MESSAGE = "resumed\n";
+  // a still connected session is given this long to let go of its socket
+  static constexpr std::chrono::milliseconds RESUME_PARK_TIMEOUT{1000};
 
   std::thread m_listenerThread;
   // guard the updates of client and containers
@@ -87,8 +325,14 @@ private:
   std::mutex m_notifierMutex;
   std::atomic<Stage> m_stage;
   ServerParameters m_parameters;
-  SocketPtr m_listenerSocket;
+  // at least one, fixed after construction
+  std::vector<std::unique_ptr<Listener>> m_listeners;
+  // listener thread only, where the next accept round starts
+  std::size_t m_nextListener{0};
   std::map<ClientHandle, ClientPtr> m_clients;
+  // clients whose sockets stay open for another process, see HandOver
+  std::atomic_bool m_handingOver{false};
+  std::vector<ClientPtr> m_handedOver;
   mutable std::queue<ClientHandle> m_clientsForDelete;
   ClientHandle m_clientHandlesCounter{0};
   std::string m_commandPrompt = "@";
@@ -97,13 +341,89 @@ private:
   OnClientConnectFnType m_onConnect = nullptr;
   OnClientDisconnectFnType m_onDisconnect = nullptr;
   OnClientReceiveDataFnType m_onReceiveData = nullptr;
+  OnReceiveBatchFnType m_onReceiveBatch = nullptr;
   OnUpdateFnType m_onUpdate = nullptr;
   OnPasswordEntered m_onPasswordEntered = nullptr;
+  OnPasswordEnteredAsync m_onPasswordEnteredAsync = nullptr;
+  WorkerPoolPtr m_authPool;
+  WorkerPoolPtr m_callbackPool;
+  std::atomic<uint64_t> m_receivesDropped{0};
+  std::atomic<uint64_t> m_clientsOverflowed{0};
+  // listener thread only
+  TokenBucket m_accepts;
+  bool m_acceptLimited{false};
+  std::atomic<uint64_t> m_inboundLimited{0};
+  std::atomic<uint64_t> m_commandsLimited{0};
+  std::atomic<uint64_t> m_outboundLimited{0};
+  std::atomic<uint64_t> m_acceptsLimited{0};
+  // built once, read by the listener thread
+  CidrTable m_accessRules;
+  // guarded by m_listenerMutex
+  AddressCounter m_addressCounts;
+  std::atomic<uint64_t> m_accessDenied{0};
+  std::atomic<uint64_t> m_addressLimited{0};
+  // of the clients already gone, GetStats() adds the connected ones
+  std::atomic<uint64_t> m_compressedClients{0};
+  std::atomic<uint64_t> m_compressionBytesIn{0};
+  std::atomic<uint64_t> m_compressionBytesOut{0};
+  // every client's buffers count against it
+  MemoryBudgetPtr m_bufferBudget;
+  // with ResumeParameters::enabled, guarded by m_listenerMutex like the
+  // sessions evicted from it which the listener thread still has to end
+  std::unique_ptr<ResumeTable> m_resumeTable;
+  std::vector<ClientHandle> m_resumeEnded;
+  // with m_listenerMutex: a claimed session parked or finished
+  std::condition_variable m_sessionReleased;
+  std::atomic<uint64_t> m_sessionsResumed{0};
+  // with BatchParameters::enabled
+  std::unique_ptr<ReceiveBatcher> m_batcher;
 
   void Run();
   void RunClient(ClientPtr client);
-  bool ProcessClientPassword(const ClientHandle clientHandle, const void* data,
+  void PlaceClientThread(ClientPtr client);
+  // bytes the client may send now, up to room; 0 while a limit holds the
+  // reads
+  std::size_t ReadBudget(ClientPtr client, std::size_t room);
+  // records the receive buffer's capacity for the budget and the stats
+  void HoldReceiveBuffer(ClientPtr client, std::size_t capacity);
+  // bytes sent, the outbound limit may leave the queue untouched
+  std::size_t FlushClient(ClientPtr client);
+  // sends the whole queue, false when it isn't empty by the timeout
+  bool DrainClient(ClientPtr client, std::chrono::milliseconds timeout);
+  bool WaitForRead(ClientPtr client);
+  void NotifyConnect(ClientPtr client);
+  void NotifyDisconnect(ClientPtr client);
+  // on the batcher thread
+  void NotifyReceiveBatch(ReceiveBatch batch);
+  bool NotifyReceive(ClientPtr client, const void* data, const size_t size);
+  // false when the client has to be disconnected
+  bool DeliverFrames(ClientPtr client, FrameReader& frames);
+  // strips telnet commands, starts compression when the client agreed;
+  // returns the data left
+  std::size_t FilterTelnet(ClientPtr client, void* data, std::size_t size);
+  void ProcessClientPassword(ClientPtr client, const void* data,
                              const size_t size);
+  bool CompleteClientPassword(ClientPtr client);
+  // sends the client a token after its password, if resume is enabled
+  void IssueResumeToken(ClientPtr client);
+  // "resume <token>": hands the connection to the session and returns
+  // true, false for anything else
+  bool TryResume(ClientPtr client, const void* data, const size_t size);
+  // keeps a session whose connection broke for its token, true if parked
+  bool ParkClient(ClientPtr client);
+  // disconnects the sessions whose token expired or was evicted
+  void EndParkedSessions();
+  static AddressPtr ListenerAddress(const ListenerParameters& listener);
+  bool OpenListener(Listener& listener);
+  // a connection from any listener, waiting up to ACCEPT_TIMEOUT
+  SocketPtr AcceptNext(std::size_t* listener);
+  const ListenerParameters& ListenerOf(ClientPtr client) const;
+  // the connection counts of the client's listener and address, under
+  // m_listenerMutex
+  void HoldConnection(ClientPtr client);
+  void ReleaseConnection(ClientPtr client);
+  // a local peer running as one of the trusted users
+  bool IsTrustedPeer(ClientPtr client) const;
   bool DoInitializing();
   bool DoListening();
   void CleanupClients();
@@ -118,12 +438,41 @@ public:
                                 unsigned short int maxConnection);
 
   void Start();
+  // the listening socket stays open, connections wait in the backlog
+  // until the next Start()
   void Stop();
 
+  // Binary upgrade: stops this server and passes the listener and live
+  // clients to the process waiting in TakeOver() on the Unix socket path.
+  bool HandOver(const std::string& channelPath);
+  // called before Start() in the new process
+  bool TakeOver(const std::string& channelPath,
+                std::chrono::milliseconds timeout);
+
   void SetPrompt(const char* prompt);
 
   void SendToClient(ClientHandle clientHandle, const std::string_view& msg);
+  // one lookup for a whole reply, invalid for an unknown client
+  ClientWriter GetWriter(ClientHandle clientHandle);
+  // queued in order with the messages, transmitted with sendfile/splice;
+  // the server keeps its own duplicate of the descriptor. MCCP2 clients
+  // get files read and compressed by the caller, pipes are refused.
+  bool SendFileToClient(ClientHandle clientHandle, int fd, off_t offset,
+                        size_t length);
+  bool SendPipeToClient(ClientHandle clientHandle, int pipeFd,
+                        size_t length = STREAM_TO_END);
+  // framed protocols only, prefixes the payload with its length; false for
+  // an unknown client
+  bool SendFrame(ClientHandle clientHandle, const std::string_view& payload);
   void ShowPrompt(ClientHandle clientHandle);
+  ServerStats GetStats();
+  // a TCP_INFO snapshot per connected client, one getsockopt() each; the
+  // client loops never ask, dead peers are left to keepalive and
+  // SocketOptions::userTimeout
+  std::vector<ClientStats> GetClientStats();
+  // index into ServerParameters::listeners of the listener which accepted
+  // the client, 0 with the single default one; -1 for an unknown client
+  int GetClientListener(ClientHandle clientHandle);
   void CloseClient(ClientHandle clientHandle);  
 
   template<class T>
@@ -179,6 +528,22 @@ public:
     return true;
   }
 
+  // with BatchParameters::enabled: the data of all clients, a batch at a
+  // time on the batcher thread; a client's records come before its
+  // disconnect callback
+  template<class T>
+  bool SetOnReceiveBatchCallback(
+    T* const object, void (T::*const onReceiveBatch)(Server&, ReceiveBatch))
+  {
+    if (Stage::Initializing != m_stage)
+      return false;
+    using namespace std::placeholders;
+    std::lock_guard<std::mutex> lock(m_notifierMutex);
+    m_onReceiveBatch = static_cast<OnReceiveBatchFnType>(
+      std::bind(onReceiveBatch, object, _1, _2));
+    return true;
+  }
+
   template<class T>
   bool SetOnServerUpdate(T* const object,
                          void (T::*const onUpdate)(Server&, ServerReason,
@@ -206,6 +571,21 @@ public:
       std::bind(onPasswordEntered, object, _1, _2, _3, _4));
     return true;
   }
+
+  template<class T>
+  bool SetOnPasswordEnteredAsync(
+    T* const object,
+    AuthResult (T::*const onPasswordEntered)(Server&, ClientHandle,
+                                             std::string))
+  {
+    if (Stage::Initializing != m_stage)
+      return false;
+    using namespace std::placeholders;
+    std::lock_guard<std::mutex> lock(m_notifierMutex);
+    m_onPasswordEnteredAsync = static_cast<OnPasswordEnteredAsync>(
+      std::bind(onPasswordEntered, object, _1, _2, _3));
+    return true;
+  }
 };
 
 } // namespace FtTCP
\ No newline at end of file
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "ft_buffer_pool.hpp"
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+namespace FtTCP {
+
+template<typename T = void>
+class Task;
+
+namespace Detail {
+
+// Coroutine frames come from the BufferPool size classes, a session which
+// awaits in a loop doesn't touch malloc after its first few lines.
+struct PooledFrame {
+  static void* operator new(std::size_t size)
+  {
+    uint8_t sizeClass;
+    std::size_t capacity;
+    return BufferPool::Instance().Acquire(size, &sizeClass, &capacity);
+  }
+
+  static void operator delete(void* pointer, std::size_t size)
+  {
+    uint8_t sizeClass = BufferPool::SizeClass(size);
+    std::size_t capacity =
+      (BufferPool::NO_CLASS == sizeClass) ? size
+                                          : BufferPool::CLASS_SIZES[sizeClass];
+    BufferPool::Instance().Release(static_cast<std::byte*>(pointer), sizeClass,
+                                   capacity);
+  }
+};
+
+struct PromiseBase : PooledFrame {
+  // resumed when this task completes, the awaiting task or nothing
+  std::coroutine_handle<> continuation;
+  std::exception_ptr exception;
+
+  struct FinalAwaiter {
+    bool await_ready() noexcept { return false; }
+    template<typename Promise>
+    std::coroutine_handle<> await_suspend(
+      std::coroutine_handle<Promise> handle) noexcept
+    {
+      std::coroutine_handle<> next = handle.promise().continuation;
+      return next ? next : std::noop_coroutine();
+    }
+    void await_resume() noexcept {}
+  };
+
+  // lazy: nothing runs until the task is awaited or started
+  std::suspend_always initial_suspend() noexcept { return {}; }
+  FinalAwaiter final_suspend() noexcept { return {}; }
+  void unhandled_exception() { exception = std::current_exception(); }
+  void Rethrow()
+  {
+    if (exception)
+      std::rethrow_exception(exception);
+  }
+};
+
+template<typename T>
+struct TaskPromise : PromiseBase {
+  std::optional<T> value;
+
+  void return_value(T result) { value = std::move(result); }
+  T Result()
+  {
+    Rethrow();
+    return std::move(*value);
+  }
+};
+
+template<>
+struct TaskPromise<void> : PromiseBase {
+  void return_void() {}
+  void Result() { Rethrow(); }
+};
+
+} // namespace Detail
+
+// Lazily started coroutine returning T. Awaiting a task runs it and resumes
+// the caller when it finishes; the outermost task is started with Start()
+// and polled with IsDone() by whoever drives it.
+template<typename T>
+class [[nodiscard]] Task {
+public:
+  struct promise_type : Detail::TaskPromise<T> {
+    Task get_return_object()
+    {
+      return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+  };
+
+private:
+  std::coroutine_handle<promise_type> m_handle;
+
+  explicit Task(std::coroutine_handle<promise_type> handle) : m_handle(handle)
+  {
+  }
+
+public:
+  Task() = default;
+  Task(Task&& other) noexcept : m_handle(std::exchange(other.m_handle, {})) {}
+  Task& operator=(Task&& other) noexcept
+  {
+    if (this != &other) {
+      if (m_handle)
+        m_handle.destroy();
+      m_handle = std::exchange(other.m_handle, {});
+    }
+    return *this;
+  }
+  Task(const Task&) = delete;
+  Task& operator=(const Task&) = delete;
+  // a suspended frame is destroyed with the tasks it awaits
+  ~Task()
+  {
+    if (m_handle)
+      m_handle.destroy();
+  }
+
+  bool IsValid() const { return static_cast<bool>(m_handle); }
+  bool IsDone() const { return !m_handle || m_handle.done(); }
+  void Start() { m_handle.resume(); }
+
+  bool await_ready() const noexcept { return IsDone(); }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept
+  {
+    m_handle.promise().continuation = caller;
+    return m_handle;
+  }
+  T await_resume() { return m_handle.promise().Result(); }
+};
+
+} // namespace FtTCP
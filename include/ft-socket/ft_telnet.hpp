@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace FtTCP {
+
+namespace Telnet {
+static constexpr uint8_t IAC{255};
+static constexpr uint8_t DONT{254};
+static constexpr uint8_t DO{253};
+static constexpr uint8_t WONT{252};
+static constexpr uint8_t WILL{251};
+static constexpr uint8_t SB{250};
+static constexpr uint8_t SE{240};
+// MCCP2
+static constexpr uint8_t COMPRESS2{86};
+
+static constexpr char WILL_COMPRESS2[] = {char(IAC), char(WILL),
+                                          char(COMPRESS2)};
+// the last uncompressed bytes, the zlib stream starts right after
+static constexpr char START_COMPRESS2[] = {char(IAC), char(SB), char(COMPRESS2),
+                                           char(IAC), char(SE)};
+} // namespace Telnet
+
+// Removes telnet commands from the client's input and remembers the
+// answers to the options the server offered. Commands may be split
+// across reads.
+class TelnetInput {
+private:
+  enum State { Data, Command, Option, Subnegotiation, SubnegotiationIac };
+
+  State m_state{Data};
+  uint8_t m_command{0};
+  bool m_doCompress{false};
+
+public:
+  // filters in place, returns the bytes of data left
+  std::size_t Filter(void* data, std::size_t size);
+  // the client answered DO to WILL COMPRESS2, reset by the call
+  bool TakeDoCompress();
+};
+
+} // namespace FtTCP
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace FtTCP {
+
+// Where a group of threads runs and how it shows up in top/perf.
+struct ThreadPlacement {
+  // shown as "<name>-<suffix>", trimmed to the 15 chars Linux keeps
+  std::string name;
+  // allowed CPUs, empty leaves the choice to the scheduler
+  std::vector<int> cpus;
+
+  void Apply(const std::string& suffix) const;
+};
+
+bool SetCurrentThreadAffinity(const std::vector<int>& cpus);
+void SetCurrentThreadName(const std::string& name);
+
+} // namespace FtTCP
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+
+// OpenSSL stays out of the public headers
+struct ssl_st;
+struct ssl_ctx_st;
+struct ssl_session_st;
+struct bio_method_st;
+
+namespace FtTCP {
+
+class TlsContext;
+
+using TlsContextPtr = std::shared_ptr<TlsContext>;
+
+// How a client checks the server's certificate
+struct TlsVerifyParameters {
+  // false accepts any certificate, e.g. a self-signed test server
+  bool verifyPeer = true;
+  // PEM bundle and hashed certificate directory of the trusted CAs, the
+  // system's default store when both are empty
+  std::string caFile;
+  std::string caPath;
+  // must match a name in the certificate, also sent as SNI; empty skips
+  // the name check
+  std::string hostName;
+};
+
+// Shared TLS configuration for one side of the connection. Handshakes run in
+// userspace, afterwards the record layer is handed to the kernel (kTLS) when
+// the kernel and OpenSSL support it, so plain send/sendfile keep working.
+// Client contexts remember the last session ticket for resumption.
+class TlsContext {
+private:
+  ssl_ctx_st* m_context{nullptr};
+  bool m_isServer;
+  std::mutex m_sessionMutex;
+  ssl_session_st* m_session{nullptr};
+  std::string m_hostName;
+
+  static int OnNewSession(ssl_st* ssl, ssl_session_st* session);
+
+public:
+  TlsContext(bool isServer);
+  ~TlsContext();
+
+  bool IsValid() const;
+  bool IsServer() const;
+  ssl_ctx_st* GetContext() const;
+
+  bool LoadCertificate(const std::string& certFile, const std::string& keyFile);
+  // in-memory self-signed EC certificate for demos and benchmarks
+  bool GenerateSelfSigned(const std::string& commonName);
+
+  // client contexts only, false when the CAs can't be loaded
+  bool SetVerify(const TlsVerifyParameters& verify);
+  // the SNI name, empty for none
+  const std::string& GetHostName() const;
+
+  // client side session resumption
+  ssl_session_st* AcquireSession();
+  void StoreSession(ssl_session_st* session);
+  void ForgetSession();
+
+  static bool IsAvailable();
+  static TlsContextPtr CreateServerContext(const std::string& certFile,
+                                           const std::string& keyFile);
+  static TlsContextPtr CreateSelfSignedServerContext(
+    const std::string& commonName);
+  static TlsContextPtr CreateClientContext(
+    const TlsVerifyParameters& verify = TlsVerifyParameters());
+  // the socket BIO writing with MSG_NOSIGNAL; once kTLS sends, the stock
+  // BIO's writes take over and Socket::IgnoreBrokenPipe() covers them
+  static const bio_method_st* GetSocketMethod();
+};
+
+} // namespace FtTCP
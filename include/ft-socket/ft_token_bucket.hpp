@@ -0,0 +1,35 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+namespace FtTCP {
+
+// Refills at rate tokens per second up to burst; a rate of 0 never limits.
+// Not thread safe, each bucket belongs to one I/O thread.
+class TokenBucket {
+private:
+  using Clock = std::chrono::steady_clock;
+
+  double m_rate;
+  double m_burst;
+  double m_tokens;
+  Clock::time_point m_updated;
+
+  void Refill();
+
+public:
+  // burst defaults to one second worth of tokens
+  TokenBucket(double rate = 0, double burst = 0);
+
+  bool IsLimited() const;
+  // SIZE_MAX without a limit
+  std::size_t GetBurst() const;
+  // whole tokens available now, SIZE_MAX without a limit
+  std::size_t Available();
+  // may run into debt, e.g. a send bigger than what was available
+  void Take(double tokens);
+  bool TryTake(double tokens);
+};
+
+} // namespace FtTCP
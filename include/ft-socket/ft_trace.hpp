@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#ifdef FT_SOCKET_TRACE
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+#endif
+
+#ifdef FT_SOCKET_USDT
+#include <sys/sdt.h>
+#define FT_SOCKET_PROBE(probe, name, value)                                    \
+  DTRACE_PROBE2(ft_socket, probe, name, value)
+#else
+#define FT_SOCKET_PROBE(probe, name, value) ((void)0)
+#endif
+
+// Trace points on the hot paths of Server and Socket.
+//
+// With FT_SOCKET_TRACE every point lands in a ring of the thread which hit
+// it, stamped with the time stamp counter; DumpChromeJson() writes what
+// the rings hold for Perfetto or chrome://tracing.
+// With FT_SOCKET_USDT the points are also USDT probes, a nop until perf or
+// bpftrace attach:
+//   bpftrace -e 'usdt:./tcp-socket:ft_socket:span_end { @[str(arg0)] =
+//     count(); }'
+// Without either the macros expand to nothing, their arguments included.
+//
+//   FT_TRACE_SPAN(span, "flush", 0);    // times the enclosing scope
+//   FT_TRACE_VALUE(span, bytes);        // the value shown with the span
+//   FT_TRACE_INSTANT("accepted", handle);
+//
+// Names must be string literals, the rings keep only the pointer.
+namespace FtTCP {
+namespace Trace {
+
+// per thread, the oldest events are overwritten; 32 bytes each
+static constexpr std::size_t EVENTS_PER_THREAD{4096};
+// rings of finished threads kept for the dump, the oldest are dropped
+static constexpr std::size_t MAX_FINISHED_THREADS{64};
+
+// time stamp counter ticks, steady clock nanoseconds where there is none;
+// assumes an invariant TSC, synchronized across cores
+inline uint64_t Now()
+{
+#ifdef FT_SOCKET_TRACE
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+#endif
+#else
+  return 0;
+#endif
+}
+
+// into the calling thread's ring, end == start for an instant
+void Record(const char* name, uint64_t start, uint64_t end, uint64_t value);
+
+// false when the rings are compiled out
+bool IsEnabled();
+// Chrome trace event format; events being overwritten meanwhile are
+// left out, so the threads don't have to stop
+void WriteChromeJson(std::ostream& out);
+bool DumpChromeJson(const std::string& path);
+
+class Span {
+private:
+  const char* m_name;
+  uint64_t m_value;
+  uint64_t m_start;
+
+public:
+  Span(const char* name, uint64_t value) : m_name(name), m_value(value)
+  {
+    FT_SOCKET_PROBE(span_begin, name, value);
+    m_start = Now();
+  }
+  ~Span()
+  {
+#ifdef FT_SOCKET_TRACE
+    Record(m_name, m_start, Now(), m_value);
+#endif
+    FT_SOCKET_PROBE(span_end, m_name, m_value);
+  }
+  Span(const Span&) = delete;
+  Span& operator=(const Span&) = delete;
+
+  void SetValue(uint64_t value) { m_value = value; }
+};
+
+// used by neither branch when tracing and probes are both compiled out
+inline void Instant([[maybe_unused]] const char* name,
+                    [[maybe_unused]] uint64_t value)
+{
+#ifdef FT_SOCKET_TRACE
+  uint64_t now = Now();
+  Record(name, now, now, value);
+#endif
+  FT_SOCKET_PROBE(instant, name, value);
+}
+
+} // namespace Trace
+} // namespace FtTCP
+
+#if defined(FT_SOCKET_TRACE) || defined(FT_SOCKET_USDT)
+#define FT_TRACE_SPAN(span, name, value)                                       \
+  FtTCP::Trace::Span span(name, static_cast<uint64_t>(value))
+#define FT_TRACE_VALUE(span, value) span.SetValue(static_cast<uint64_t>(value))
+#define FT_TRACE_INSTANT(name, value)                                          \
+  FtTCP::Trace::Instant(name, static_cast<uint64_t>(value))
+#else
+#define FT_TRACE_SPAN(span, name, value) ((void)0)
+#define FT_TRACE_VALUE(span, value) ((void)0)
+#define FT_TRACE_INSTANT(name, value) ((void)0)
+#endif
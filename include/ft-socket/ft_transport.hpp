@@ -0,0 +1,26 @@
+#pragma once
+
+#include "ft_socket.hpp"
+
+#include <memory>
+
+namespace FtTCP {
+class Transport;
+
+using TransportPtr = std::shared_ptr<Transport>;
+
+// Where connections come from when they aren't kernel sockets on the
+// server's port. The server accepts on the socket Listen() returns, a
+// client gets its end of a new connection from Connect(); both ends are
+// driven through the Socket interface.
+class Transport {
+public:
+  virtual ~Transport() = default;
+
+  // nullptr when somebody listens already
+  virtual SocketPtr Listen(int backlog) = 0;
+  // nullptr when nobody listens or the backlog is full
+  virtual SocketPtr Connect() = 0;
+};
+
+} // namespace FtTCP
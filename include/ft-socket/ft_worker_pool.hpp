@@ -0,0 +1,96 @@
+#pragma once
+
+#include "ft_thread.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace FtTCP {
+
+class WorkerPool;
+class Strand;
+
+using WorkerPoolPtr = std::shared_ptr<WorkerPool>;
+using StrandPtr = std::shared_ptr<Strand>;
+using WorkerTask = std::function<void()>;
+
+struct WorkerPoolStats {
+  std::size_t queueDepth{0};
+  std::size_t maxQueueDepth{0};
+  uint64_t executed{0};
+  // Post() refused, queue full or stopping
+  uint64_t rejected{0};
+};
+
+// Fixed set of threads draining a bounded FIFO of tasks.
+class WorkerPool {
+private:
+  std::vector<std::thread> m_workers;
+  std::deque<WorkerTask> m_tasks;
+  std::mutex m_mutex;
+  std::condition_variable m_wakeup;
+  std::size_t m_maxQueue;
+  bool m_stopping{false};
+  std::size_t m_maxDepth{0};
+  uint64_t m_executed{0};
+  uint64_t m_rejected{0};
+
+  void Run();
+
+public:
+  WorkerPool(std::size_t threads, std::size_t maxQueue,
+             const ThreadPlacement& placement = ThreadPlacement());
+  ~WorkerPool();
+
+  // false when the queue is full or the pool is stopping
+  bool Post(WorkerTask task);
+  // joins the workers, tasks still queued are dropped
+  void Stop();
+  std::size_t QueueDepth();
+  WorkerPoolStats GetStats();
+
+  static WorkerPoolPtr CreateWorkerPool(
+    std::size_t threads, std::size_t maxQueue,
+    const ThreadPlacement& placement = ThreadPlacement());
+};
+
+// Runs its tasks one at a time, in the order posted, on the threads of a
+// WorkerPool; tasks of different strands run in parallel.
+class Strand : public std::enable_shared_from_this<Strand> {
+private:
+  // tasks run per pool slot before the strand yields to the others
+  static constexpr std::size_t MAX_BATCH{16};
+
+  WorkerPoolPtr m_pool;
+  std::size_t m_maxPending;
+  std::deque<WorkerTask> m_tasks;
+  std::mutex m_mutex;
+  std::condition_variable m_idle;
+  // a Drain() is queued in the pool or running
+  bool m_scheduled{false};
+
+  void Drain();
+
+public:
+  Strand(WorkerPoolPtr pool, std::size_t maxPending);
+
+  // false when maxPending tasks wait or the pool refuses the strand; a
+  // mandatory task ignores maxPending and runs on the calling thread when
+  // the pool is saturated
+  bool Post(WorkerTask task, bool mandatory = false);
+  std::size_t Pending();
+  bool IsFull();
+  // false when the tasks didn't finish in time
+  bool WaitIdle(std::chrono::milliseconds timeout);
+
+  static StrandPtr CreateStrand(WorkerPoolPtr pool, std::size_t maxPending);
+};
+
+} // namespace FtTCP
@@ -1,11 +1,18 @@
 #pragma once
 
+#include "ft-socket/ft_session_server.hpp"
 #include "ft-socket/ft_socket_server.hpp"
 
 class TelnetCallbacks {
 public:
   std::atomic_bool m_stopping{false};
   std::atomic_bool m_shutingdown{false};
+  // hand the server over to a freshly started copy of this binary
+  std::atomic_bool m_upgrading{false};
+  // the load generator runs thousands of sessions, keep the console quiet
+  bool m_verbose{true};
+  // clients of this listener may look but not stop, upgrade or read files
+  int m_readOnlyListener{-1};
 
   void OnStartListening(FtTCP::Server& server);
   void OnClientConnect(FtTCP::Server& server, FtTCP::ClientHandle clientHandle);
@@ -16,7 +23,12 @@ public:
                            const size_t size);
   void OnUpdate(FtTCP::Server& server, FtTCP::ServerReason reason,
                 FtTCP::PlatformError err);
+  void SendFile(FtTCP::Server& server, FtTCP::ClientHandle clientHandle,
+                const std::string& path);
   bool OnClientPasswordEntered(FtTCP::Server& server,
                                FtTCP::ClientHandle clientHandle,
                                const void* data, const size_t size);
+
+  // the same dialogue as a coroutine for SessionServer
+  FtTCP::Task<void> RunSession(FtTCP::Connection& connection);
 };
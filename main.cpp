@@ -4,12 +4,16 @@
 #include <cstdlib>
 #include <cstring>
 #include <list>
+#include <string>
+#include <vector>
 #include <atomic>
 #include <unistd.h>
 #include "ft-socket/ft_socket_address.hpp"
 #include "ft-socket/ft_socket.hpp"
 #include "ft-socket/ft_socket_server.hpp"
 #include "ft-socket/ft_broadcast.hpp"
+#include "ft-socket/ft_load_generator.hpp"
+#include "ft-socket/ft_session_server.hpp"
 #include "telnet_callbacks.hpp"
 
 using namespace FtTCP;
@@ -36,10 +40,54 @@ void TestClientSocket()
     std::cout << "Sent " << sended << " bytes" << std::endl;
 }
 
-void StartTelnet()
+static const char upgrade_channel[] = "/tmp/ft-socket-upgrade.sock";
+
+// the -telnet options of this process, "-takeover <path>" left out
+static std::vector<std::string> telnet_options;
+
+bool SpawnUpgrade()
+{
+    // the new binary waits in TakeOver() for our listener and clients; it
+    // gets our options, a TLS server must come back as one
+    std::vector<std::string> arguments{"tcp-socket", "-telnet"};
+    arguments.insert(arguments.end(), telnet_options.begin(), telnet_options.end());
+    arguments.push_back("-takeover");
+    arguments.push_back(upgrade_channel);
+    std::vector<char*> argv;
+    for (auto& argument : arguments)
+        argv.push_back(argument.data());
+    argv.push_back(nullptr);
+    pid_t pid = fork();
+    if (0 == pid)
+    {
+        execv("/proc/self/exe", argv.data());
+        _exit(1);
+    }
+    return pid > 0;
+}
+
+void StartTelnet(TlsContextPtr tls, const char* takeover, bool compress)
 {
     TelnetCallbacks callbacks;
-    ServerParameters params{10303, 2, std::chrono::seconds(60)};
+    ServerParameters params{10303, 4, std::chrono::seconds(60), tls};
+    params.compression.enabled = compress;
+    // operators on 10303, a password-less read-only monitoring port next
+    // to it; both share the server's threads and limits
+    ListenerParameters operators;
+    operators.name = "operators";
+    operators.port = 10303;
+    operators.maxConnections = 2;
+    ListenerParameters monitoring;
+    monitoring.name = "monitoring";
+    monitoring.port = 10305;
+    monitoring.password = false;
+    monitoring.maxConnections = 2;
+    params.listeners = {operators, monitoring};
+    callbacks.m_readOnlyListener = 1;
+    // "resume <token>" at the prompt brings a dropped operator back
+    params.resume.enabled = true;
+    // reply, body and prompt leave as one segment
+    params.socketOptions = SocketOptions::Interactive();
     Server server(params);
     server.SetOnStartListeningCallback(&callbacks, &TelnetCallbacks::OnStartListening);
     server.SetOnClientConnectCallback(&callbacks, &TelnetCallbacks::OnClientConnect);
@@ -48,19 +96,89 @@ void StartTelnet()
     server.SetOnServerUpdate(&callbacks, &TelnetCallbacks::OnUpdate);
     server.SetOnPasswordEntered(&callbacks, &TelnetCallbacks::OnClientPasswordEntered);
 
+    if (takeover && !server.TakeOver(takeover, std::chrono::seconds(10)))
+    {
+        std::cout << "Takeover failed, starting fresh" << std::endl;
+    }
+
     while (!callbacks.m_shutingdown)
     {
         server.Start();
         while (!callbacks.m_stopping)
         {
-            std::this_thread::sleep_for(std::chrono::seconds(1));
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        if (callbacks.m_upgrading)
+        {
+            if (SpawnUpgrade() && server.HandOver(upgrade_channel))
+                break;
+            std::cout << "Upgrade failed" << std::endl;
+            callbacks.m_upgrading = false;
         }
         server.Stop();
         callbacks.m_stopping = false;
     }
 }
 
-void TestBroadcast()
+void StartSessions()
+{
+    // the telnet dialogue as coroutines on one event loop thread
+    TelnetCallbacks callbacks;
+    SessionParameters params{10303, 100, std::chrono::seconds(60)};
+    SessionServer server(params, [&callbacks](Connection& connection) {
+        return callbacks.RunSession(connection);
+    });
+    if (!server.Start())
+        return;
+    while (!callbacks.m_stopping)
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    server.Stop();
+}
+
+void RunLoadGenerator(int argc, char *argv[])
+{
+    unsigned int sessions = (argc > 2) ? std::atoi(argv[2]) : 100;
+    unsigned int rate = (argc > 3) ? std::atoi(argv[3]) : 200;
+    unsigned int seconds = (argc > 4) ? std::atoi(argv[4]) : 10;
+    // callbacks on a worker pool instead of the client threads
+    unsigned int workers = (argc > 5) ? std::atoi(argv[5]) : 0;
+
+    // local server on loopback, with headroom for sessions which are still
+    // being cleaned up while their replacements connect
+    TelnetCallbacks callbacks;
+    callbacks.m_verbose = false;
+    unsigned short int maxConnections = static_cast<unsigned short int>(std::min(sessions * 2, 65535u));
+    ServerParameters params{10304, maxConnections, std::chrono::seconds(60)};
+    params.callbackWorkers = static_cast<unsigned short int>(workers);
+    Server server(params);
+    server.SetOnClientConnectCallback(&callbacks, &TelnetCallbacks::OnClientConnect);
+    server.SetOnReceiveDataCallback(&callbacks, &TelnetCallbacks::OnClientReceiveData);
+    server.SetOnServerUpdate(&callbacks, &TelnetCallbacks::OnUpdate);
+    server.SetOnPasswordEntered(&callbacks, &TelnetCallbacks::OnClientPasswordEntered);
+    server.Start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    LoadParameters load;
+    load.host = "127.0.0.1";
+    load.port = params.port;
+    load.sessions = sessions;
+    load.connectRate = rate;
+    load.duration = std::chrono::seconds(seconds);
+    load.password = "123";
+    load.commandsPerSession = 20;
+    load.script = {{"status", 8}, {"test out", 2}};
+    std::cout << "Load: " << sessions << " sessions, " << rate << " connects/s, "
+              << seconds << "s" << std::endl;
+    LoadGeneratorPtr generator = LoadGenerator::CreateLoadGenerator(load);
+    LoadReport report = generator->Run();
+    std::cout << report.ToString() << std::endl;
+
+    std::cout << server.GetStats().ToString() << std::endl;
+    server.Stop();
+    std::cout << BufferPool::Instance().GetStats().ToString() << std::endl;
+}
+
+void TestBroadcast(bool multicast)
 {
 #if 0
     const std::string packet = "Datagramm v.100.200.300\0";
@@ -79,7 +197,10 @@ void TestBroadcast()
         sleep(1);
     }
 #endif
-    FtTCP::BroadcastPtr br = FtTCP::Broadcast::CreateBroadcast(std::string("Application Version"));
+    // announces the telnet demo's port and connection limit
+    FtTCP::BroadcastPtr br = FtTCP::Broadcast::CreateBroadcast(std::string("Application Version"), 10303, 2);
+    if (multicast)
+        br->SetMulticast(MulticastParameters());
     br->Start();
     int counter = 0;
     bool local_shutdown = false;
@@ -100,6 +221,11 @@ void TestBroadcast()
         {
             break;
         }
+        else if (0 == counter % 20)
+        {
+            // a made up load, changes are announced again
+            br->UpdateLoad(counter / 20 % 3, counter * 10 % 1000);
+        }
         counter++;
     }
     std::cout << "Broadcast: stopping" << std::endl;
@@ -107,6 +233,43 @@ void TestBroadcast()
     std::cout << "Broadcast: all done" << std::endl;
 }
 
+void RunDiscovery(bool multicast)
+{
+    // listens to the announcements of -broadcast and picks a server
+    SocketPtr sock = Socket::CreateSocket(std::make_shared<Address>(3055, false, eUDP));
+    if (!sock->Bind())
+    {
+        std::cout << "Discovery: can't bind: " << sock->ErrorsToStr() << std::endl;
+        return;
+    }
+    // on lo, as -broadcast -multicast sends there
+    if (multicast && !sock->JoinGroup(MulticastParameters().group, "127.0.0.1"))
+    {
+        std::cout << "Discovery: can't join: " << sock->ErrorsToStr() << std::endl;
+        return;
+    }
+    AnnouncementTable table;
+    auto start = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - start < std::chrono::seconds(30))
+    {
+        if (!sock->IsReadyForRead(std::chrono::milliseconds(500)))
+            continue;
+        char packet[512];
+        std::string sender;
+        size_t size = sock->ReceiveDatagram(packet, sizeof(packet), &sender);
+        if (!table.Add(sender, packet, size))
+            continue;
+        Announcement best;
+        if (table.PickLeastLoaded(&best))
+        {
+            std::cout << "Discovery: " << table.GetServers().size() << " server(s), connect to "
+                      << best.host << ":" << best.port << " (" << best.connections << "/"
+                      << best.maxConnections << ", load " << best.load << ", "
+                      << best.appVersion << ")" << std::endl;
+        }
+    }
+}
+
 int main(int argc, char *argv[])
 {
     std::list<AddressPtr> addresses{
@@ -129,12 +292,59 @@ int main(int argc, char *argv[])
         std::string arg1 = argv[1];
         if (0 == arg1.compare("-telnet"))
         {
-            StartTelnet();
+            // -telnet [-tls [cert.pem key.pem]] [-mccp] [-takeover <path>]
+            TlsContextPtr tls;
+            const char* takeover = nullptr;
+            bool compress = false;
+            for (int i = 2; i < argc; i++)
+            {
+                std::string option = argv[i];
+                // -tls: self-signed without the files
+                if (0 == option.compare("-tls"))
+                {
+                    telnet_options.push_back(option);
+                    if (i + 2 < argc && '-' != argv[i + 1][0])
+                    {
+                        tls = TlsContext::CreateServerContext(argv[i + 1], argv[i + 2]);
+                        telnet_options.push_back(argv[i + 1]);
+                        telnet_options.push_back(argv[i + 2]);
+                        i += 2;
+                    }
+                    else
+                    {
+                        tls = TlsContext::CreateSelfSignedServerContext("localhost");
+                    }
+                    if (!tls)
+                    {
+                        std::cout << "TLS is not available" << std::endl;
+                        return 1;
+                    }
+                }
+                // -takeover <path>: started by "upgrade" in the old process
+                else if (0 == option.compare("-takeover") && i + 1 < argc)
+                {
+                    takeover = argv[++i];
+                }
+                // -mccp: offer MCCP2 output compression
+                else if (0 == option.compare("-mccp"))
+                {
+                    telnet_options.push_back(option);
+                    compress = true;
+                }
+            }
+            StartTelnet(tls, takeover, compress);
             return 0;
         }
         else if (0 == arg1.compare("-broadcast"))
         {
-            TestBroadcast();
+            // -broadcast -multicast: announce to the group on lo instead
+            TestBroadcast(argc > 2 && 0 == std::string(argv[2]).compare("-multicast"));
+            return 0;
+        }
+        else if (0 == arg1.compare("-discover"))
+        {
+            // -discover -multicast: join the announcement group
+            RunDiscovery(argc > 2 && 0 == std::string(argv[2]).compare("-multicast"));
             return 0;
         }
         else if (0 == arg1.compare("-client"))
@@ -142,7 +352,17 @@ int main(int argc, char *argv[])
             TestClientSocket();
             return 0;
         }
+        else if (0 == arg1.compare("-sessions"))
+        {
+            StartSessions();
+            return 0;
+        }
+        else if (0 == arg1.compare("-load"))
+        {
+            RunLoadGenerator(argc, argv);
+            return 0;
+        }
     }
-    TestBroadcast();
+    TestBroadcast(false);
     return 0;
 }
\ No newline at end of file
@@ -1,9 +1,14 @@
 #include "telnet_callbacks.hpp"
 
+#include "ft-socket/ft_trace.hpp"
+
 #include <cstdlib>
 #include <cstring>
+#include <fcntl.h>
 #include <iomanip>
 #include <iostream>
+#include <sys/stat.h>
+#include <unistd.h>
 
 static constexpr std::string_view prompt = "user@system:$ ";
 static constexpr std::string_view responce = "Ok\n";
@@ -19,6 +24,23 @@ static char stop_msg[] = "Server stopped.\n";
 static char shutdown_cmd[] = "shutdown";
 static char shutdown_msg[] = "Server shuting down.\n";
 
+static char upgrade_cmd[] = "upgrade";
+static char upgrade_msg[] = "Server upgrading.\n";
+
+static char trace_cmd[] = "trace";
+static char trace_path[] = "ft-socket-trace.json";
+static constexpr std::string_view trace_msg =
+  "Trace written to ft-socket-trace.json.\n";
+static constexpr std::string_view trace_off_msg =
+  "Built without FT_SOCKET_TRACE.\n";
+
+static char stats_cmd[] = "stats";
+
+static constexpr std::string_view read_only_msg = "Read only.\n";
+
+static char cat_cmd[] = "cat ";
+static constexpr std::string_view cat_error_msg = "can't open file\n";
+
 static char testout_cmd[] = "test out";
 static char testout[] =
   "Big text\n"
@@ -85,7 +107,7 @@ static char testout[] =
 static std::string reason_names[] = {
   "InitiallBindFail",   "InitiallListenFail", "ConnectionAccepted",
   "ConnectionRejected", "ConnectionDeleted",  "ServerStarted",
-  "ServerStopSignal",   "ServerStopped"};
+  "ServerStopSignal",   "ServerStopped",      "ConnectionTlsFailed"};
 
 static constexpr std::string_view client_password = "123";
 
@@ -97,7 +119,8 @@ void TelnetCallbacks::OnStartListening(FtTCP::Server& server)
 void TelnetCallbacks::OnClientConnect(FtTCP::Server& server,
                                       FtTCP::ClientHandle clientHandle)
 {
-  std::cout << "Client connected: " << clientHandle << std::endl;
+  if (m_verbose)
+    std::cout << "Client connected: " << clientHandle << std::endl;
   std::string_view sw = prompt;
   server.SendToClient(clientHandle, sw);
 }
@@ -105,22 +128,35 @@ void TelnetCallbacks::OnClientConnect(FtTCP::Server& server,
 void TelnetCallbacks::OnClientDisconnect(FtTCP::Server& server,
                                          FtTCP::ClientHandle clientHandle)
 {
-  std::cout << "Client diconnected: " << clientHandle << std::endl;
+  if (m_verbose)
+    std::cout << "Client diconnected: " << clientHandle << std::endl;
 }
 
 void TelnetCallbacks::OnClientReceiveData(FtTCP::Server& server,
                                           FtTCP::ClientHandle clientHandle,
                                           const void* data, const size_t size)
 {
-  char* strdata = (char*)data;
-  strdata[size] = 0;
-  std::cout << "Client: " << clientHandle << " received: " << strdata
-            << std::endl;
+  // the data lives in the server's pooled receive buffer, read only
+  std::string_view strdata(static_cast<const char*>(data), size);
+  if (m_verbose)
+    std::cout << "Client: " << clientHandle << " received: " << strdata
+              << std::endl;
   server.SendToClient(clientHandle, responce);
-  if (0 == memcmp(data, close_cmd, std::min(size, strlen(close_cmd)))) {
+  if (0 == memcmp(data, stats_cmd, std::min(size, strlen(stats_cmd)))) {
+    server.SendToClient(clientHandle, server.GetStats().ToString() + "\n");
+    for (const auto& client : server.GetClientStats())
+      server.SendToClient(clientHandle, client.ToString() + "\n");
+    server.SendToClient(clientHandle, prompt);
+  }
+  else if (0 == memcmp(data, close_cmd, std::min(size, strlen(close_cmd)))) {
     server.SendToClient(clientHandle, close_msg);
     server.CloseClient(clientHandle);
   }
+  else if (m_readOnlyListener >= 0 &&
+           server.GetClientListener(clientHandle) == m_readOnlyListener) {
+    server.SendToClient(clientHandle, read_only_msg);
+    server.SendToClient(clientHandle, prompt);
+  }
   else if (0 == memcmp(data, stop_cmd, std::min(size, strlen(stop_cmd)))) {
     server.SendToClient(clientHandle, stop_msg);
     m_stopping = true;
@@ -131,6 +167,29 @@ void TelnetCallbacks::OnClientReceiveData(FtTCP::Server& server,
     m_stopping = true;
     m_shutingdown = true;
   }
+  else if (0 ==
+           memcmp(data, upgrade_cmd, std::min(size, strlen(upgrade_cmd)))) {
+    server.SendToClient(clientHandle, upgrade_msg);
+    m_upgrading = true;
+    m_stopping = true;
+  }
+  else if (0 == memcmp(data, trace_cmd, std::min(size, strlen(trace_cmd)))) {
+    if (!FtTCP::Trace::IsEnabled())
+      server.SendToClient(clientHandle, trace_off_msg);
+    else if (FtTCP::Trace::DumpChromeJson(trace_path))
+      server.SendToClient(clientHandle, trace_msg);
+    else
+      server.SendToClient(clientHandle, cat_error_msg);
+    server.SendToClient(clientHandle, prompt);
+  }
+  else if (size > strlen(cat_cmd) &&
+           0 == memcmp(data, cat_cmd, strlen(cat_cmd))) {
+    std::string path(strdata.substr(strlen(cat_cmd)));
+    while (path.length() && path.back() < 32)
+      path.pop_back();
+    SendFile(server, clientHandle, path);
+    server.SendToClient(clientHandle, prompt);
+  }
   else if (0 ==
            memcmp(data, testout_cmd, std::min(size, strlen(shutdown_cmd)))) {
     server.SendToClient(clientHandle, testout);
@@ -141,11 +200,26 @@ void TelnetCallbacks::OnClientReceiveData(FtTCP::Server& server,
   }
 }
 
+void TelnetCallbacks::SendFile(FtTCP::Server& server,
+                               FtTCP::ClientHandle clientHandle,
+                               const std::string& path)
+{
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  struct stat info;
+  if (-1 == fd || -1 == fstat(fd, &info) ||
+      !server.SendFileToClient(clientHandle, fd, 0, info.st_size)) {
+    server.SendToClient(clientHandle, cat_error_msg);
+  }
+  if (-1 != fd)
+    close(fd);
+}
+
 void TelnetCallbacks::OnUpdate(
   FtTCP::Server& server, FtTCP::ServerReason reason, FtTCP::PlatformError err)
 {
-  std::cout << "Server updated: " << reason_names[reason]
-            << " error: " << strerror(err) << std::endl;
+  if (m_verbose || err)
+    std::cout << "Server updated: " << reason_names[reason]
+              << " error: " << strerror(err) << std::endl;
   if (98 == err) // connection already used
     m_stopping = true;
 }
@@ -159,5 +233,57 @@ bool TelnetCallbacks::OnClientPasswordEntered(
   {
     psw.pop_back();
   }
-  return (0 == client_password.compare(psw.c_str()));
+  return FtTCP::ConstantTimeEquals(client_password.data(),
+                                   client_password.size(), psw.data(),
+                                   psw.size());
+}
+
+FtTCP::Task<void> TelnetCallbacks::RunSession(FtTCP::Connection& connection)
+{
+  static constexpr std::string_view password_prompt = "password: ";
+  static constexpr std::string_view wrong_password = "wrong password\n";
+  static constexpr int max_attempts = 3;
+
+  bool authenticated = false;
+  for (int attempt = 0; !authenticated && attempt < max_attempts; attempt++) {
+    co_await connection.Write(password_prompt);
+    auto line = co_await connection.ReadLine();
+    if (!line)
+      co_return;
+    authenticated = FtTCP::ConstantTimeEquals(
+      client_password.data(), client_password.size(), line->data(),
+      line->size());
+    if (!authenticated) {
+      // slows down guessing without holding a thread
+      co_await connection.Sleep(std::chrono::milliseconds(500));
+      co_await connection.Write(wrong_password);
+    }
+  }
+  if (!authenticated)
+    co_return;
+
+  if (m_verbose)
+    std::cout << "Session started: " << connection.GetHandle() << std::endl;
+  co_await connection.Write(prompt);
+  while (auto line = co_await connection.ReadLine()) {
+    if (m_verbose)
+      std::cout << "Session: " << connection.GetHandle()
+                << " received: " << *line << std::endl;
+    co_await connection.Write(responce);
+    if (*line == close_cmd) {
+      co_await connection.Write(close_msg);
+      break;
+    }
+    if (*line == stop_cmd) {
+      co_await connection.Write(stop_msg);
+      m_stopping = true;
+    }
+    else if (*line == testout_cmd) {
+      co_await connection.Write(testout);
+    }
+    if (!co_await connection.Write(prompt))
+      break;
+  }
+  if (m_verbose)
+    std::cout << "Session finished: " << connection.GetHandle() << std::endl;
 }
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdio>
+
+namespace FtTest {
+
+// loopback port of the server tests, away from the demo and bench ones
+static constexpr unsigned short int TEST_PORT{10500};
+
+// failed checks so far, a group fails when it adds to them
+inline int failures{0};
+
+// keeps going after a failure, so one run reports every broken case
+#define FT_CHECK(condition)                                              \
+  do {                                                                   \
+    if (!(condition)) {                                                  \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+      FtTest::failures++;                                                \
+    }                                                                    \
+  } while (0)
+
+void RunAccess();
+void RunResume();
+void RunFraming();
+void RunTelnet();
+void RunTokenBucket();
+void RunAnnouncement();
+void RunStreamReset();
+void RunDescriptorChannel();
+void RunBufferPool();
+
+} // namespace FtTest
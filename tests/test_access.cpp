@@ -0,0 +1,134 @@
+#include "test.hpp"
+
+#include "ft-socket/ft_ip_filter.hpp"
+
+using namespace FtTCP;
+
+namespace FtTest {
+
+static uint32_t Ip(const char* text)
+{
+  Cidr cidr{0, 0};
+  ParseCidr(text, &cidr);
+  return cidr.prefix;
+}
+
+// the hash table probes and the ranges Build() flattens them into must
+// give the same answer
+static bool Allowed(const CidrTable& table, const char* ip)
+{
+  CidrTable built = table;
+  built.Build();
+  bool probed = table.IsAllowed(Ip(ip));
+  FT_CHECK(probed == built.IsAllowed(Ip(ip)));
+  return probed;
+}
+
+static void TestParse()
+{
+  Cidr cidr{0, 0};
+  FT_CHECK(ParseCidr("10.1.2.3/8", &cidr));
+  FT_CHECK(Ip("10.0.0.0") == cidr.prefix && 8 == cidr.length);
+  FT_CHECK(ParseCidr("192.168.1.7", &cidr));
+  FT_CHECK(Ip("192.168.1.7") == cidr.prefix && 32 == cidr.length);
+  FT_CHECK(ParseCidr("255.255.255.255/0", &cidr));
+  FT_CHECK(0 == cidr.prefix && 0 == cidr.length);
+
+  for (const char* malformed :
+       {"", "10.0.0.0/", "10.0.0.0/33", "10.0.0.0/-1", "10.0.0.0/8x",
+        "10.0.0/8", "256.0.0.0", "::1", "example.org/8"})
+    FT_CHECK(!ParseCidr(malformed, &cidr));
+
+  CidrTable table;
+  FT_CHECK(!table.Add(std::string("10.0.0.0/40"), false));
+  FT_CHECK(0 == table.Size());
+  FT_CHECK(Allowed(table, "10.0.0.1"));
+}
+
+static void TestEdges()
+{
+  // /0 covers everything, a /32 carves one host out of it
+  CidrTable all;
+  all.Add(std::string("0.0.0.0/0"), false);
+  FT_CHECK(!Allowed(all, "0.0.0.0"));
+  FT_CHECK(!Allowed(all, "127.0.0.1"));
+  FT_CHECK(!Allowed(all, "255.255.255.255"));
+  all.Add(std::string("127.0.0.1/32"), true);
+  FT_CHECK(Allowed(all, "127.0.0.1"));
+  FT_CHECK(!Allowed(all, "127.0.0.0"));
+  FT_CHECK(!Allowed(all, "127.0.0.2"));
+
+  // a /32 at either end of the address space
+  CidrTable ends(false);
+  ends.Add(std::string("0.0.0.0/32"), true);
+  ends.Add(std::string("255.255.255.255/32"), true);
+  FT_CHECK(Allowed(ends, "0.0.0.0"));
+  FT_CHECK(!Allowed(ends, "0.0.0.1"));
+  FT_CHECK(!Allowed(ends, "255.255.255.254"));
+  FT_CHECK(Allowed(ends, "255.255.255.255"));
+  FT_CHECK(2 == ends.Size());
+}
+
+static void TestPrecedence()
+{
+  // the same prefix both ways leaves it allowed, whatever the order
+  CidrTable denyFirst(false);
+  denyFirst.Add(std::string("10.0.0.0/8"), false);
+  denyFirst.Add(std::string("10.0.0.0/8"), true);
+  FT_CHECK(Allowed(denyFirst, "10.20.30.40"));
+  FT_CHECK(1 == denyFirst.Size());
+
+  CidrTable allowFirst(false);
+  allowFirst.Add(std::string("10.0.0.0/8"), true);
+  allowFirst.Add(std::string("10.255.0.0/8"), false);
+  FT_CHECK(Allowed(allowFirst, "10.20.30.40"));
+  FT_CHECK(1 == allowFirst.Size());
+
+  // the longest prefix decides
+  CidrTable nested;
+  nested.Add(std::string("10.0.0.0/8"), false);
+  nested.Add(std::string("10.1.0.0/16"), true);
+  nested.Add(std::string("10.1.2.0/24"), false);
+  FT_CHECK(!Allowed(nested, "10.0.0.1"));
+  FT_CHECK(Allowed(nested, "10.1.0.1"));
+  FT_CHECK(!Allowed(nested, "10.1.2.3"));
+  FT_CHECK(Allowed(nested, "10.1.3.0"));
+  FT_CHECK(Allowed(nested, "11.0.0.0"));
+}
+
+static void TestCounter()
+{
+  AddressCounter counter(2);
+  uint32_t ip = Ip("192.168.1.7");
+  FT_CHECK(counter.TryAdd(ip));
+  FT_CHECK(counter.TryAdd(ip));
+  FT_CHECK(!counter.TryAdd(ip));
+  FT_CHECK(2 == counter.Get(ip));
+  FT_CHECK(counter.TryAdd(Ip("192.168.1.8")));
+  FT_CHECK(2 == counter.Size());
+
+  counter.Remove(ip);
+  FT_CHECK(counter.TryAdd(ip));
+  // a connection taken over is counted past the limit
+  counter.Add(ip);
+  FT_CHECK(3 == counter.Get(ip));
+  for (int i = 0; i < 4; i++)
+    counter.Remove(ip);
+  FT_CHECK(0 == counter.Get(ip));
+  FT_CHECK(1 == counter.Size());
+
+  AddressCounter unlimited;
+  for (int i = 0; i < 1000; i++)
+    FT_CHECK(unlimited.TryAdd(ip));
+  FT_CHECK(1000 == unlimited.Get(ip));
+}
+
+void RunAccess()
+{
+  TestParse();
+  TestEdges();
+  TestPrecedence();
+  TestCounter();
+}
+
+} // namespace FtTest
@@ -0,0 +1,123 @@
+#include "test.hpp"
+
+#include "ft-socket/ft_announcement.hpp"
+
+#include <cstdint>
+#include <vector>
+
+using namespace FtTCP;
+
+namespace FtTest {
+
+static std::vector<uint8_t> Bytes(const AnnouncementPacket& packet)
+{
+  const uint8_t* data = static_cast<const uint8_t*>(packet.Data());
+  return std::vector<uint8_t>(data, data + packet.Size());
+}
+
+static bool Parse(const std::vector<uint8_t>& bytes, Announcement* parsed)
+{
+  return AnnouncementPacket::Parse(bytes.data(), bytes.size(), parsed);
+}
+
+static void TestRoundTrip()
+{
+  AnnouncementPacket packet("1.2.3", 10303, 8);
+  packet.SetConnections(3);
+  packet.SetLoad(250);
+  Announcement parsed;
+  FT_CHECK(Parse(Bytes(packet), &parsed));
+  FT_CHECK(10303 == parsed.port);
+  FT_CHECK(3 == parsed.connections);
+  FT_CHECK(8 == parsed.maxConnections);
+  FT_CHECK(250 == parsed.load);
+  FT_CHECK("1.2.3" == parsed.appVersion);
+  FT_CHECK(!AnnouncementPacket::Parse(packet.Data(), packet.Size(), nullptr));
+}
+
+static void TestTruncated()
+{
+  std::vector<uint8_t> bytes = Bytes(AnnouncementPacket("1.2.3", 10303, 8));
+  Announcement parsed;
+  // short of the header or of the version it declares
+  for (std::size_t size = 0; size < bytes.size(); size++)
+    FT_CHECK(!AnnouncementPacket::Parse(bytes.data(), size, &parsed));
+
+  std::vector<uint8_t> magic = bytes;
+  magic[3] = 'X';
+  FT_CHECK(!Parse(magic, &parsed));
+  std::vector<uint8_t> format = bytes;
+  format[4] = 0;
+  FT_CHECK(!Parse(format, &parsed));
+  std::vector<uint8_t> header = bytes;
+  header[5] = AnnouncementPacket::HEADER_SIZE - 1;
+  FT_CHECK(!Parse(header, &parsed));
+}
+
+static void TestOversized()
+{
+  // the version is cut to what its length byte holds
+  std::string longVersion(AnnouncementPacket::MAX_APP_VERSION + 100, 'v');
+  AnnouncementPacket packet(longVersion, 1, 1);
+  Announcement parsed;
+  FT_CHECK(Parse(Bytes(packet), &parsed));
+  FT_CHECK(AnnouncementPacket::MAX_APP_VERSION == parsed.appVersion.size());
+
+  // trailing bytes past the version are ignored
+  std::vector<uint8_t> trailing = Bytes(AnnouncementPacket("1.0", 2, 3));
+  trailing.resize(trailing.size() + 64, 0xEE);
+  FT_CHECK(Parse(trailing, &parsed));
+  FT_CHECK("1.0" == parsed.appVersion && 2 == parsed.port);
+
+  // a newer format with a longer header, the unknown fields are skipped
+  std::vector<uint8_t> newer = Bytes(AnnouncementPacket("2.0", 4, 5));
+  newer[4] = AnnouncementPacket::FORMAT + 1;
+  newer[5] = AnnouncementPacket::HEADER_SIZE + 4;
+  newer.insert(newer.begin() + AnnouncementPacket::HEADER_SIZE, 4, 0xAA);
+  FT_CHECK(Parse(newer, &parsed));
+  FT_CHECK("2.0" == parsed.appVersion && 4 == parsed.port &&
+           5 == parsed.maxConnections);
+}
+
+static void TestTable()
+{
+  AnnouncementTable table;
+  const uint8_t garbage[] = {'F', 'T', 'A', 'N', 1};
+  FT_CHECK(!table.Add("10.0.0.1", garbage, sizeof(garbage)));
+
+  AnnouncementPacket busy("1.0", 10303, 4);
+  busy.SetConnections(3);
+  AnnouncementPacket idle("1.0", 10303, 4);
+  idle.SetConnections(1);
+  AnnouncementPacket full("1.0", 10303, 4);
+  full.SetConnections(4);
+  FT_CHECK(table.Add("10.0.0.1", busy.Data(), busy.Size()));
+  FT_CHECK(table.Add("10.0.0.2", idle.Data(), idle.Size()));
+  FT_CHECK(table.Add("10.0.0.3", full.Data(), full.Size()));
+  FT_CHECK(3 == table.GetServers().size());
+
+  Announcement picked;
+  FT_CHECK(table.PickLeastLoaded(&picked));
+  FT_CHECK("10.0.0.2" == picked.host);
+
+  // the latest announcement replaces the earlier one
+  idle.SetLoad(900);
+  FT_CHECK(table.Add("10.0.0.2", idle.Data(), idle.Size()));
+  FT_CHECK(table.PickLeastLoaded(&picked));
+  FT_CHECK("10.0.0.1" == picked.host);
+
+  AnnouncementTable forgetful(std::chrono::seconds(-1));
+  forgetful.Add("10.0.0.1", busy.Data(), busy.Size());
+  FT_CHECK(forgetful.GetServers().empty());
+  FT_CHECK(!forgetful.PickLeastLoaded(&picked));
+}
+
+void RunAnnouncement()
+{
+  TestRoundTrip();
+  TestTruncated();
+  TestOversized();
+  TestTable();
+}
+
+} // namespace FtTest
@@ -0,0 +1,54 @@
+#include "test.hpp"
+
+#include "ft-socket/ft_buffer_pool.hpp"
+
+#include <thread>
+#include <vector>
+
+using namespace FtTCP;
+
+namespace FtTest {
+
+// a burst of the biggest blocks released at once, the caches keep only
+// what their byte caps allow and free the rest
+static void TestBurst()
+{
+  static constexpr std::size_t BLOCKS{200};
+  static constexpr std::size_t BLOCK_SIZE{BufferPool::CLASS_SIZES.back()};
+  BufferPool& pool = BufferPool::Instance();
+  BufferPoolStats before = pool.GetStats();
+
+  std::thread worker([&pool]() {
+    std::vector<PooledBuffer> buffers;
+    for (std::size_t i = 0; i < BLOCKS; i++)
+      buffers.emplace_back(BLOCK_SIZE);
+    buffers.clear();
+
+    BufferPoolStats released = BufferPool::Instance().GetStats();
+    FT_CHECK(released.bytesCached <= BufferPool::MAX_THREAD_CACHED_BYTES +
+                                       BufferPool::MAX_SHARED_CACHED_BYTES);
+
+    // only what fits the thread's cap comes back without a lock
+    for (std::size_t i = 0; i < BLOCKS; i++)
+      buffers.emplace_back(BLOCK_SIZE);
+    BufferPoolStats taken = BufferPool::Instance().GetStats();
+    FT_CHECK(taken.threadCacheHits - released.threadCacheHits <=
+             BufferPool::MAX_THREAD_CACHED_BYTES / BLOCK_SIZE);
+    FT_CHECK(taken.threadCacheHits > released.threadCacheHits);
+  });
+  worker.join();
+
+  // the exiting thread's cache went to the shared list, still capped
+  BufferPoolStats after = pool.GetStats();
+  FT_CHECK(after.bytesCached <= BufferPool::CLASS_COUNT *
+                                  BufferPool::MAX_SHARED_CACHED_BYTES);
+  FT_CHECK(after.systemFrees > before.systemFrees);
+  FT_CHECK(after.bytesInUse == before.bytesInUse);
+}
+
+void RunBufferPool()
+{
+  TestBurst();
+}
+
+} // namespace FtTest
@@ -0,0 +1,78 @@
+#include "test.hpp"
+
+#include "ft-socket/ft_fd_passing.hpp"
+
+#include <poll.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace FtTCP;
+
+namespace FtTest {
+
+static constexpr std::chrono::milliseconds CHANNEL_TIMEOUT{2000};
+static const char CHANNEL_PATH[] = "/tmp/ft-socket-test-channel.sock";
+
+struct Record {
+  uint64_t first;
+  uint64_t second;
+};
+
+// one record of size bytes carrying a pipe's write end, the read end goes
+// to the caller
+static void Exchange(size_t size, bool* received, int* readEnd)
+{
+  int pipeFds[2];
+  FT_CHECK(0 == pipe(pipeFds));
+  *readEnd = pipeFds[0];
+  DescriptorChannel receiver;
+  std::thread sender([&]() {
+    DescriptorChannel channel;
+    Record record{1, 2};
+    FT_CHECK(channel.Connect(CHANNEL_PATH, CHANNEL_TIMEOUT));
+    FT_CHECK(channel.Send(pipeFds[1], &record, size));
+    close(pipeFds[1]);
+  });
+  FT_CHECK(receiver.Accept(CHANNEL_PATH, CHANNEL_TIMEOUT));
+  sender.join();
+  Record record{};
+  int fd = -1;
+  *received = receiver.Receive(&fd, &record, sizeof(record), CHANNEL_TIMEOUT);
+  if (*received) {
+    FT_CHECK(-1 != fd && 1 == record.first && 2 == record.second);
+    close(fd);
+  }
+  else {
+    FT_CHECK(-1 == fd);
+  }
+}
+
+// every write end closed: the read end sees the hang-up at once
+static bool IsWriterClosed(int readEnd)
+{
+  pollfd event{readEnd, POLLIN, 0};
+  return 1 == poll(&event, 1, 0) && (event.revents & POLLHUP);
+}
+
+static void TestReceive()
+{
+  bool received = false;
+  int readEnd = -1;
+  Exchange(sizeof(Record), &received, &readEnd);
+  FT_CHECK(received);
+  FT_CHECK(IsWriterClosed(readEnd));
+  close(readEnd);
+
+  // cut short: the descriptor that came along is closed, not leaked
+  Exchange(sizeof(Record) / 2, &received, &readEnd);
+  FT_CHECK(!received);
+  FT_CHECK(IsWriterClosed(readEnd));
+  close(readEnd);
+}
+
+void RunDescriptorChannel()
+{
+  TestReceive();
+}
+
+} // namespace FtTest
@@ -0,0 +1,102 @@
+#include "test.hpp"
+
+#include "ft-socket/ft_framing.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace FtTCP;
+
+namespace FtTest {
+
+static std::string Encode(FrameFormat format, const std::string& payload)
+{
+  std::byte header[FrameReader::MAX_HEADER];
+  std::size_t length = FrameReader::EncodeHeader(
+    format, static_cast<uint32_t>(payload.size()), header);
+  return std::string(reinterpret_cast<const char*>(header), length) + payload;
+}
+
+// the stream arrives piece bytes per receive, frames are copied out as
+// their views only last until the next Prepare()
+static FrameReader::Status Read(FrameReader& reader, const std::string& stream,
+                                std::size_t piece,
+                                std::vector<std::string>* frames)
+{
+  FrameReader::Status status = FrameReader::NeedMore;
+  for (std::size_t offset = 0; offset < stream.size();) {
+    std::size_t room = 0;
+    std::byte* buffer = reader.Prepare(&room);
+    std::size_t size = std::min({piece, room, stream.size() - offset});
+    std::memcpy(buffer, stream.data() + offset, size);
+    reader.Commit(size);
+    offset += size;
+    std::string_view frame;
+    while (FrameReader::FrameReady == (status = reader.Next(&frame)))
+      frames->emplace_back(frame);
+    if (FrameReader::NeedMore != status)
+      break;
+  }
+  return status;
+}
+
+static void TestSplit(FrameFormat format)
+{
+  const std::vector<std::string> payloads = {
+    "", "hello", std::string(127, 'a'), std::string(300, 'b'),
+    std::string(70000, 'c')};
+  std::string stream;
+  for (const auto& payload : payloads)
+    stream += Encode(format, payload);
+  for (std::size_t piece : {std::size_t(1), std::size_t(3), std::size_t(4096),
+                            stream.size()}) {
+    FrameReader reader(format, 1 << 20);
+    // small chunks so the reader has to grow for the big frame
+    reader.SetReceiveChunk(64);
+    std::vector<std::string> frames;
+    FT_CHECK(FrameReader::NeedMore == Read(reader, stream, piece, &frames));
+    FT_CHECK(payloads == frames);
+  }
+}
+
+static void TestLimits()
+{
+  // maxFrame itself passes, one byte more doesn't
+  for (FrameFormat format : {FrameVarint, FrameFixed32}) {
+    std::vector<std::string> frames;
+    FrameReader fits(format, 200);
+    FT_CHECK(FrameReader::NeedMore ==
+             Read(fits, Encode(format, std::string(200, 'x')), 7, &frames));
+    FT_CHECK(1 == frames.size());
+    FrameReader over(format, 200);
+    FT_CHECK(FrameReader::Oversized ==
+             Read(over, Encode(format, std::string(201, 'x')), 7, &frames));
+    FT_CHECK(1 == frames.size());
+  }
+
+  // a varint still open after MAX_HEADER bytes, waited on until then
+  std::vector<std::string> frames;
+  FrameReader open(FrameVarint, 1 << 20);
+  FT_CHECK(FrameReader::NeedMore ==
+           Read(open, std::string(4, '\x80'), 1, &frames));
+  FT_CHECK(FrameReader::Malformed ==
+           Read(open, std::string(1, '\x80'), 1, &frames));
+  FT_CHECK(frames.empty());
+
+  std::byte header[FrameReader::MAX_HEADER];
+  FT_CHECK(1 == FrameReader::EncodeHeader(FrameVarint, 127, header));
+  FT_CHECK(2 == FrameReader::EncodeHeader(FrameVarint, 128, header));
+  FT_CHECK(5 == FrameReader::EncodeHeader(FrameVarint, UINT32_MAX, header));
+  FT_CHECK(4 == FrameReader::EncodeHeader(FrameFixed32, 0, header));
+}
+
+void RunFraming()
+{
+  TestSplit(FrameVarint);
+  TestSplit(FrameFixed32);
+  TestLimits();
+}
+
+} // namespace FtTest
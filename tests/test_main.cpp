@@ -0,0 +1,58 @@
+#include "test.hpp"
+
+#include <cstring>
+
+struct TestEntry {
+  const char* option;
+  const char* description;
+  void (*run)();
+};
+
+static const TestEntry tests[] = {
+  {"-access", "CIDR rules and per address connection caps",
+   FtTest::RunAccess},
+  {"-resume", "session tokens: parking, expiry, eviction, listeners",
+   FtTest::RunResume},
+  {"-framing", "length-prefixed frames split across reads, bad headers",
+   FtTest::RunFraming},
+  {"-telnet", "telnet commands split across reads, the MCCP2 answer",
+   FtTest::RunTelnet},
+  {"-bucket", "token bucket refill, burst cap and debt",
+   FtTest::RunTokenBucket},
+  {"-announcement", "discovery packets: truncated, oversized, newer formats",
+   FtTest::RunAnnouncement},
+  {"-reset", "a client resetting during a file stream",
+   FtTest::RunStreamReset},
+  {"-channel", "descriptors passed for a handoff, short records",
+   FtTest::RunDescriptorChannel},
+  {"-pool", "buffer pool caches capped in bytes", FtTest::RunBufferPool},
+};
+
+static bool RunTest(const TestEntry& test)
+{
+  int before = FtTest::failures;
+  test.run();
+  bool passed = before == FtTest::failures;
+  printf("%s %s: %s\n", passed ? "PASS" : "FAIL", test.option,
+         test.description);
+  return passed;
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2 || 0 == strcmp(argv[1], "-all")) {
+    bool passed = true;
+    for (const auto& test : tests)
+      passed = RunTest(test) && passed;
+    return passed ? 0 : 1;
+  }
+  for (const auto& test : tests) {
+    if (0 == strcmp(argv[1], test.option))
+      return RunTest(test) ? 0 : 1;
+  }
+  printf("usage: %s [-all", argv[0]);
+  for (const auto& test : tests)
+    printf(" | %s", test.option);
+  printf("]\n");
+  return 1;
+}
@@ -0,0 +1,209 @@
+#include "test.hpp"
+
+#include "ft-socket/ft_resume.hpp"
+#include "ft-socket/ft_socket_server.hpp"
+
+#include <algorithm>
+#include <sys/socket.h>
+#include <thread>
+
+using namespace FtTCP;
+
+namespace FtTest {
+
+static constexpr std::chrono::seconds TTL{60};
+
+static void TestTokens()
+{
+  ResumeTable table(4, TTL);
+  std::vector<ClientHandle> evicted;
+  std::string first = table.Issue(1, &evicted);
+  std::string second = table.Issue(2, &evicted);
+  FT_CHECK(32 == first.size());
+  FT_CHECK(std::all_of(first.begin(), first.end(), [](char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+  }));
+  FT_CHECK(first != second);
+
+  // live, then gone once taken; looking it up leaves it
+  ClientHandle handle = 0;
+  FT_CHECK(table.Find(first, &handle));
+  FT_CHECK(1 == handle);
+  FT_CHECK(!table.Find("not a token", &handle));
+  FT_CHECK(table.Take(first, &handle));
+  FT_CHECK(1 == handle);
+  FT_CHECK(!table.Take(first, &handle));
+  FT_CHECK(!table.Take("not a token", &handle));
+  FT_CHECK(!table.Park(first));
+
+  // parked within the ttl
+  FT_CHECK(table.Park(second));
+  FT_CHECK(!table.Park(second));
+  FT_CHECK(1 == table.GetParked());
+  FT_CHECK(table.Take(second, &handle));
+  FT_CHECK(2 == handle);
+  FT_CHECK(0 == table.GetParked());
+  FT_CHECK(evicted.empty());
+}
+
+static void TestCapacity()
+{
+  std::vector<ClientHandle> evicted;
+  // live sessions are never evicted
+  ResumeTable live(2, TTL);
+  live.Issue(1, &evicted);
+  std::string second = live.Issue(2, &evicted);
+  FT_CHECK(live.Issue(3, &evicted).empty());
+  FT_CHECK(evicted.empty());
+
+  // a parked one makes room
+  FT_CHECK(live.Park(second));
+  FT_CHECK(!live.Issue(3, &evicted).empty());
+  FT_CHECK(1 == evicted.size() && 2 == evicted[0]);
+  FT_CHECK(0 == live.GetParked());
+
+  // the one parked first goes first, skipping tokens removed meanwhile
+  evicted.clear();
+  ResumeTable parked(3, TTL);
+  std::string a = parked.Issue(1, &evicted);
+  std::string b = parked.Issue(2, &evicted);
+  std::string c = parked.Issue(3, &evicted);
+  parked.Park(a);
+  parked.Park(b);
+  parked.Park(c);
+  parked.Remove(a);
+  FT_CHECK(2 == parked.GetParked());
+  parked.Issue(4, &evicted);
+  parked.Issue(5, &evicted);
+  FT_CHECK(1 == evicted.size() && 2 == evicted[0]);
+  FT_CHECK(1 == parked.GetParked());
+
+  // no capacity is still room for one
+  ResumeTable tiny(0, TTL);
+  FT_CHECK(!tiny.Issue(1, &evicted).empty());
+}
+
+static void TestExpiry()
+{
+  std::vector<ClientHandle> evicted;
+  // a zero ttl expires on parking
+  ResumeTable table(4, std::chrono::seconds(0));
+  std::string gone = table.Issue(1, &evicted);
+  std::string live = table.Issue(2, &evicted);
+  FT_CHECK(table.Park(gone));
+  ClientHandle handle = 0;
+  FT_CHECK(!table.Find(gone, &handle));
+  FT_CHECK(!table.Take(gone, &handle));
+  std::vector<ClientHandle> expired = table.TakeExpired();
+  FT_CHECK(1 == expired.size() && 1 == expired[0]);
+  FT_CHECK(table.TakeExpired().empty());
+  FT_CHECK(0 == table.GetParked());
+  FT_CHECK(table.Take(live, &handle));
+  FT_CHECK(2 == handle);
+
+  // only the parked ones when the server stops
+  ResumeTable stopping(4, TTL);
+  std::string parked = stopping.Issue(3, &evicted);
+  std::string connected = stopping.Issue(4, &evicted);
+  stopping.Park(parked);
+  std::vector<ClientHandle> taken = stopping.TakeParked();
+  FT_CHECK(1 == taken.size() && 3 == taken[0]);
+  FT_CHECK(0 == stopping.GetParked());
+  FT_CHECK(!stopping.Take(parked, &handle));
+  FT_CHECK(stopping.Take(connected, &handle));
+  FT_CHECK(evicted.empty());
+}
+
+struct ResumeRecorder {
+  bool OnPassword(Server&, ClientHandle, const void*, size_t) { return true; }
+};
+
+static SocketPtr Connect(unsigned short int port)
+{
+  for (int attempt = 0; attempt < 100; attempt++) {
+    SocketPtr client =
+      Socket::CreateSocket(Address::CreateClientAddress("127.0.0.1", port));
+    if (client->Connect() &&
+        client->IsReadyForWrite(std::chrono::milliseconds(100)) &&
+        client->FinishConnect())
+      return client;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return nullptr;
+}
+
+// what arrives until text does, or a second passes
+static std::string ReadUntil(SocketPtr client, const std::string& text)
+{
+  std::string received;
+  char buffer[1024];
+  while (std::string::npos == received.find(text) &&
+         client->IsReadyForRead(std::chrono::milliseconds(1000))) {
+    size_t size = client->Receive(buffer, sizeof(buffer), 0);
+    if (0 == size)
+      break;
+    received.append(buffer, size);
+  }
+  return received;
+}
+
+static void Write(SocketPtr client, const std::string& text)
+{
+  size_t sent = 0;
+  std::string line = text;
+  FT_CHECK(client->Send(line.data(), line.size(), MSG_NOSIGNAL, &sent));
+}
+
+// a session stays with the listener which accepted it
+static void TestListener()
+{
+  ServerParameters parameters{TEST_PORT, 4, std::chrono::seconds(60)};
+  ListenerParameters first;
+  first.port = TEST_PORT;
+  ListenerParameters second;
+  second.port = TEST_PORT + 1;
+  parameters.listeners = {first, second};
+  parameters.resume.enabled = true;
+  auto server = std::make_shared<Server>(parameters);
+  ResumeRecorder recorder;
+  server->SetOnPasswordEntered(&recorder, &ResumeRecorder::OnPassword);
+  server->Start();
+
+  SocketPtr original = Connect(TEST_PORT);
+  FT_CHECK(original);
+  if (!original) {
+    server->Stop();
+    return;
+  }
+  ReadUntil(original, "password: ");
+  Write(original, "x\r\n");
+  std::string greeting = ReadUntil(original, "\n");
+  std::size_t at = greeting.find("resume: ");
+  FT_CHECK(std::string::npos != at);
+  std::string token = greeting.substr(at + 8, 32);
+  original.reset();
+
+  SocketPtr other = Connect(TEST_PORT + 1);
+  ReadUntil(other, "password: ");
+  Write(other, "resume " + token + "\r\n");
+  std::string refused = ReadUntil(other, "wrong password");
+  FT_CHECK(std::string::npos != refused.find("wrong password"));
+
+  // the token is still good where the session came from
+  SocketPtr same = Connect(TEST_PORT);
+  ReadUntil(same, "password: ");
+  Write(same, "resume " + token + "\r\n");
+  std::string resumed = ReadUntil(same, "resumed");
+  FT_CHECK(std::string::npos != resumed.find("resumed"));
+  server->Stop();
+}
+
+void RunResume()
+{
+  TestTokens();
+  TestCapacity();
+  TestExpiry();
+  TestListener();
+}
+
+} // namespace FtTest
@@ -0,0 +1,129 @@
+#include "test.hpp"
+
+#include "ft-socket/ft_socket_server.hpp"
+
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace FtTCP;
+
+namespace FtTest {
+
+static constexpr off_t STREAM_FILE_SIZE{256 * 1024 * 1024};
+static constexpr std::chrono::seconds STREAM_TIMEOUT{5};
+
+struct StreamRecorder {
+  std::atomic<ClientHandle> client{0};
+  std::atomic_bool disconnected{false};
+
+  void OnConnect(Server&, ClientHandle handle) { client = handle; }
+  void OnDisconnect(Server&, ClientHandle) { disconnected = true; }
+  bool OnPassword(Server&, ClientHandle, const void*, size_t) { return true; }
+};
+
+template<class Condition>
+static bool WaitFor(Condition condition)
+{
+  auto until = std::chrono::steady_clock::now() + STREAM_TIMEOUT;
+  while (!condition()) {
+    if (std::chrono::steady_clock::now() >= until)
+      return false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  return true;
+}
+
+// the server binds from its own thread, retry until it listens
+static SocketPtr Connect()
+{
+  SocketPtr client;
+  WaitFor([&]() {
+    client =
+      Socket::CreateSocket(Address::CreateClientAddress("127.0.0.1", TEST_PORT));
+    return client->Connect() &&
+           client->IsReadyForWrite(std::chrono::milliseconds(100)) &&
+           client->FinishConnect();
+  });
+  return client;
+}
+
+static void OnBrokenPipe(int) {}
+
+static void TestHandlerKept()
+{
+  // an application's own handler stays
+  signal(SIGPIPE, OnBrokenPipe);
+  Socket::IgnoreBrokenPipe();
+  struct sigaction current;
+  sigaction(SIGPIPE, nullptr, &current);
+  FT_CHECK(OnBrokenPipe == current.sa_handler);
+  signal(SIGPIPE, SIG_DFL);
+}
+
+// sendfile() can't take MSG_NOSIGNAL: a reset mid-stream raises SIGPIPE,
+// the server must survive it
+static void TestReset()
+{
+  char path[] = "/tmp/ft-socket-test-XXXXXX";
+  int fd = mkstemp(path);
+  FT_CHECK(-1 != fd);
+  if (-1 == fd)
+    return;
+  unlink(path);
+  // sparse, reads as zeros
+  FT_CHECK(0 == ftruncate(fd, STREAM_FILE_SIZE));
+
+  ServerParameters parameters{TEST_PORT, 4, std::chrono::seconds(60)};
+  auto server = std::make_shared<Server>(parameters);
+  StreamRecorder recorder;
+  server->SetOnClientConnectCallback(&recorder, &StreamRecorder::OnConnect);
+  server->SetOnClientDisconnectCallback(&recorder,
+                                        &StreamRecorder::OnDisconnect);
+  server->SetOnPasswordEntered(&recorder, &StreamRecorder::OnPassword);
+  server->Start();
+  struct sigaction current;
+  sigaction(SIGPIPE, nullptr, &current);
+  FT_CHECK(SIG_IGN == current.sa_handler);
+
+  SocketPtr client = Connect();
+  char password[] = "x\n";
+  size_t sent = 0;
+  FT_CHECK(client && client->Send(password, sizeof(password) - 1,
+                                  MSG_NOSIGNAL, &sent));
+  FT_CHECK(WaitFor([&]() { return 0 != recorder.client; }));
+  FT_CHECK(server->SendFileToClient(recorder.client, fd, 0,
+                                    static_cast<size_t>(STREAM_FILE_SIZE)));
+  close(fd);
+
+  // some of the stream, then a reset instead of a close
+  char buffer[64 * 1024];
+  size_t received = 0;
+  while (received < sizeof(buffer) * 4 &&
+         client->IsReadyForRead(std::chrono::milliseconds(1000))) {
+    size_t got = client->Receive(buffer, sizeof(buffer), 0);
+    if (0 == got)
+      break;
+    received += got;
+  }
+  FT_CHECK(received >= sizeof(buffer) * 4);
+  linger reset{1, 0};
+  setsockopt(client->GetHandle(), SOL_SOCKET, SO_LINGER, &reset,
+             sizeof(reset));
+  client.reset();
+
+  FT_CHECK(WaitFor([&]() { return recorder.disconnected.load(); }));
+  server->Stop();
+}
+
+void RunStreamReset()
+{
+  signal(SIGPIPE, SIG_DFL);
+  TestHandlerKept();
+  TestReset();
+}
+
+} // namespace FtTest
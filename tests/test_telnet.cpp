@@ -0,0 +1,76 @@
+#include "test.hpp"
+
+#include "ft-socket/ft_telnet.hpp"
+
+#include <string>
+
+using namespace FtTCP;
+
+namespace FtTest {
+
+static const std::string IAC(1, char(Telnet::IAC));
+
+static std::string Command(uint8_t command, uint8_t option)
+{
+  return IAC + char(command) + char(option);
+}
+
+// the data left when the input is split at split, both halves filtered
+// by the same TelnetInput
+static std::string Filter(TelnetInput& input, std::string text,
+                          std::size_t split)
+{
+  std::string first = text.substr(0, split);
+  std::string second = text.substr(split);
+  first.resize(input.Filter(first.data(), first.size()));
+  second.resize(input.Filter(second.data(), second.size()));
+  return first + second;
+}
+
+static void TestSplit()
+{
+  // escaped 255, an option, a subnegotiation with an escaped 255 and an
+  // SE look-alike inside, a two byte command
+  const std::string stream =
+    "ab" + IAC + IAC + "c" + Command(Telnet::WILL, 31) + "d" + IAC +
+    char(Telnet::SB) + char(24) + '\0' + "x" + IAC + IAC + char(Telnet::SE) +
+    "term" + IAC + char(Telnet::SE) + "e" + IAC + char(241) + "f";
+  const std::string data = "ab" + IAC + "cdef";
+  for (std::size_t split = 0; split <= stream.size(); split++) {
+    TelnetInput input;
+    FT_CHECK(data == Filter(input, stream, split));
+    FT_CHECK(!input.TakeDoCompress());
+  }
+}
+
+static void TestCompress()
+{
+  const std::string doCompress = Command(Telnet::DO, Telnet::COMPRESS2);
+  for (std::size_t split = 0; split <= doCompress.size(); split++) {
+    TelnetInput input;
+    FT_CHECK(Filter(input, "x" + doCompress + "y", split + 1) == "xy");
+    FT_CHECK(input.TakeDoCompress());
+    // reset by the call
+    FT_CHECK(!input.TakeDoCompress());
+  }
+
+  // any other answer, or DO for another option, isn't a yes
+  for (const std::string& other :
+       {Command(Telnet::DONT, Telnet::COMPRESS2),
+        Command(Telnet::WILL, Telnet::COMPRESS2),
+        Command(Telnet::WONT, Telnet::COMPRESS2), Command(Telnet::DO, 85),
+        IAC + IAC + char(Telnet::DO) + char(Telnet::COMPRESS2)}) {
+    TelnetInput input;
+    std::string text = other;
+    input.Filter(text.data(), text.size());
+    FT_CHECK(!input.TakeDoCompress());
+  }
+}
+
+void RunTelnet()
+{
+  TestSplit();
+  TestCompress();
+}
+
+} // namespace FtTest
@@ -0,0 +1,66 @@
+#include "test.hpp"
+
+#include "ft-socket/ft_token_bucket.hpp"
+
+#include <cstdint>
+#include <thread>
+
+using namespace FtTCP;
+
+namespace FtTest {
+
+// the refill runs on the real clock: lower bounds only where a slow run
+// could add tokens, the burst caps them from above
+static void TestRefill()
+{
+  TokenBucket bucket(1000, 100);
+  FT_CHECK(100 == bucket.GetBurst());
+  FT_CHECK(100 == bucket.Available());
+  FT_CHECK(bucket.TryTake(100));
+  FT_CHECK(!bucket.TryTake(50));
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  std::size_t refilled = bucket.Available();
+  FT_CHECK(refilled >= 20 && refilled <= 100);
+
+  // never past the burst however long it waits
+  std::this_thread::sleep_for(std::chrono::milliseconds(150));
+  FT_CHECK(100 == bucket.Available());
+  FT_CHECK(bucket.TryTake(100));
+}
+
+static void TestDebt()
+{
+  // ten seconds worth taken at once, paid back before anything passes
+  TokenBucket bucket(1000, 100);
+  bucket.Take(10000);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  FT_CHECK(0 == bucket.Available());
+  FT_CHECK(!bucket.TryTake(1));
+}
+
+static void TestDefaults()
+{
+  TokenBucket unlimited;
+  FT_CHECK(!unlimited.IsLimited());
+  FT_CHECK(SIZE_MAX == unlimited.GetBurst());
+  FT_CHECK(SIZE_MAX == unlimited.Available());
+  unlimited.Take(1e9);
+  FT_CHECK(unlimited.TryTake(1e9));
+
+  // a second worth by default, never below one token
+  FT_CHECK(500 == TokenBucket(500).GetBurst());
+  TokenBucket slow(0.5);
+  FT_CHECK(1 == slow.GetBurst());
+  FT_CHECK(slow.TryTake(1));
+  FT_CHECK(!slow.TryTake(1));
+}
+
+void RunTokenBucket()
+{
+  TestRefill();
+  TestDebt();
+  TestDefaults();
+}
+
+} // namespace FtTest